@@ -23,12 +23,20 @@
  * Since each distance sensor uses the same I2C address, there is an IO Mux betwee the ESP32
  * and the sensors to select one device at a time.
  * ColumnManager objects manage each of the columns by controlling the valves based on the measured column elevations.
+ * Every column is described by one entry in the COLUMN_TABLE of ColumnConfig.h, the sensors, regulators, console
+ * and UI are all built by iterating over that table.
+ * A MovePlanner object decides when each column may start a move, since the columns share the feed and drain paths.
  * Each distance sensor can be calibrated for a more consistent reading of its column.  See calibration.h for static tables.
  * A 12V water pump is used to pipe from the holding tank to the feeder tank.
- * The upper tank has two water level sensors located at the 25 and 75 percent points.
+ * The upper tank has two water level sensors located at the 25 and 75 percent points, each debounced in time.
  * A TankManager object manages the pump control based on the two water level sensors.
+ * The pump can be soft started and stopped with PWM ramps to keep it quiet.
+ * The pump is held off while columns move.
+ * A PumpScheduler forecasts the column fills from the upcoming digit transitions and batches the tank refills.
  * A battery backed I2C real-time clock (RV8803) is used as the official timekeeper.
  * A ClockManager object manages the I2C real-time clock to read and set the time.
+ * A PowerManager object stops the range sensors, turns off the display and light sleeps the ESP32 once the
+ * columns have parked in the sleep window.  A key press or the end of the window resumes the clock.
  * The system monitors for a variety of potential failures which will stop any water flows.
  * All faults are collected into a single bit-encoded object with fault enums in faults.h.
  * All I/O is managed using an I2C IO expander (SX1509).
@@ -72,8 +80,12 @@
 #include "faults.h"
 #include "io_expander_config.h"
 #include "ClockManager.h"
+#include "ColumnConfig.h"
 #include "ColumnManager.h"
 #include "Console.h"
+#include "MovePlanner.h"
+#include "PowerManager.h"
+#include "PumpScheduler.h"
 #include "RangeUtil.h"
 #include "TankManager.h"
 #include "UIManager.h"
@@ -85,12 +97,8 @@
 //
 QWIICMUX i2c_mux;   /* Used to access multiple ToF sensors with same I2C address */
 SX1509 io_expander; /* Discrete I/O interface */
-VL53L1X range_sensor_hour_column;
-VL53L1X range_sensor_min_10s_column;
-VL53L1X range_sensor_min_1s_column;
-RangeUtil range_util_hour_column(&range_sensor_hour_column, 1);        // Sensor #1
-RangeUtil range_util_min_10s_column(&range_sensor_min_10s_column, 2);  // Sensor #2
-RangeUtil range_util_min_1s_column(&range_sensor_min_1s_column, 3);    // Sensor #3
+VL53L1X range_sensors[NUM_COLUMNS];  /* One ToF sensor per column, see COLUMN_TABLE for mux ports */
+RangeUtil *range_utils[NUM_COLUMNS]; /* Sensor #1 is the first column in COLUMN_TABLE */
 
 
 //
@@ -107,18 +115,61 @@ UIManager *ui_manager;
 // Tank and water column handlers
 //
 TankManager *tank_manager;
-ColumnManager *column_manager_hour;
-ColumnManager *column_manager_min_10s;
-ColumnManager *column_manager_min_1s;
+ColumnManager *column_managers[NUM_COLUMNS];
 
-const uint16_t MIN_WATER_COLUMN_ELEVATION = 50;
-const uint16_t MAX_WATER_COLUMN_ELEVATION = 305;
+//
+// Coordinates the column moves over the shared feed and drain paths
+//
+MovePlanner *move_planner;
+static_assert(NUM_COLUMNS <= MovePlanner::MAX_COLUMNS, "MovePlanner supports fewer columns than COLUMN_TABLE");
+
+//
+// Column transition times with the pump arbitration off [0] and on [1]
+//
+RunningStats arbitration_transition_stats[2];
+bool planner_transition_active = false;
+
+static constexpr uint32_t CONTROL_PERIOD_BIN_USEC = 2000;
+
+//
+// Column setpoints driven by the clock, recomputed only when the shown time or the sleep window changes
+//
+uint16_t clock_setpoints[NUM_COLUMNS];
+uint32_t clock_setpoint_updates = 0;
+
+//
+// Time between column control passes, to show the loop is not held up by the display
+//
+RunningStats control_period_stats;
+Histogram control_period_histogram(CONTROL_PERIOD_BIN_USEC);
+uint32_t control_pass_usec = 0;
+
+//
+// Plans the feed tank refills from the forecast column fills
+//
+PumpScheduler *pump_scheduler;
 
 //
 // Define time management elements.
 //
 ClockManager clock_manager;
 
+//
+// Host time sync waiting for its whole second.  The RTC is written from the loop so nothing is held up.
+//
+static constexpr uint32_t SYNC_MAX_AGE_MSEC = 2000;  // Furthest a SYNC SET device millis may be from its line
+static constexpr uint32_t SYNC_LATE_MAX_MSEC = 3;    // Loop later than this into the second waits for the next one
+static constexpr uint8_t SYNC_RETRIES_MAX = 5;       // Seconds waited for a loop pass on time before writing late
+bool sync_pending = false;
+uint8_t sync_retries = 0;
+uint32_t sync_target_sec = 0;
+uint32_t sync_deadline_msec = 0;
+
+//
+// Low power sleep during the sleep window
+//
+PowerManager *power_manager;
+
 // Status streamer
 bool stream_status = false;
 elapsedMillis stream_status_elapsed;
@@ -149,8 +200,18 @@ const char *FAULT_STRING[] = {
   "SX1509_IO_EXPANDER_INIT_FAIL",
   "TANK_FILL_TIMEOUT",
   "TANK_LEVEL_SENSE_FAIL",
-  "NVM_FAIL"
+  "NVM_FAIL",
+  "COLUMN_1_FLOW_FAIL",
+  "COLUMN_2_FLOW_FAIL",
+  "COLUMN_3_FLOW_FAIL",
+  "COLUMN_UNKNOWN_FLOW_FAIL",
+  "I2C_MUX_PORT_3_FAIL",
+  "I2C_MUX_PORT_4_FAIL",
+  "I2C_MUX_PORT_5_FAIL",
+  "I2C_MUX_PORT_6_FAIL",
+  "I2C_MUX_PORT_7_FAIL"
 };
+static_assert(sizeof(FAULT_STRING) / sizeof(FAULT_STRING[0]) == FAULT_MAX_INDEX, "FAULT_STRING must name every fault");
 
 
 
@@ -181,6 +242,13 @@ void setup() {
   // Real-time clock initialization.  Used to maintain time in battery backed clock outside of CPU.
   //
   clock_manager.Startup();
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    clock_setpoints[i] = SLEEP_WATER_COLUMN_ELEVATION;
+  }
+  clock_manager.Subscribe(&clock_setpoint_event,
+                          (column_table_uses_seconds(0) ? ClockManager::CLOCK_EVENT_SECOND : ClockManager::CLOCK_EVENT_MINUTE)
+                            | ClockManager::CLOCK_EVENT_SLEEP_ENTER | ClockManager::CLOCK_EVENT_SLEEP_EXIT,
+                          NULL);
 
   //
   // Initialize the command console via the main serial port for diagnostics, calibration, status checks, etc.
@@ -218,29 +286,20 @@ void setup() {
   //
   // I2C ranging device initialization. Time-of-flight sensors to measure distance in each column.
   // Each range sensor uses the same I2C address so a mux is needed to limit coms with only one
-  // sensor at a time.  Hour sensor is on mux port 0, etc.
+  // sensor at a time.  The mux port of each column is listed in COLUMN_TABLE.
   //
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    range_utils[i] = new RangeUtil(&range_sensors[i], i + 1);
+  }
   if (!FAULT_ACTIVE(FAULT_I2C_MUX_OFFLINE)) {
-    if (i2c_mux.setPort(0) == false) {
-      // Hour mux port failed
-      FAULT_SET(FAULT_I2C_MUX_PORT_0_FAIL);
-    } else {
-      // Initialize the Hour column range sensor on i2c mux port 0
-      range_util_hour_column.Startup();
-    }
-    if (i2c_mux.setPort(1) == false) {
-      // Minutes 10s mux port failed
-      FAULT_SET(FAULT_I2C_MUX_PORT_1_FAIL);
-    } else {
-      // Initialize the Minute 10s column range sensor on i2c mux port 1
-      range_util_min_10s_column.Startup();
-    }
-    if (i2c_mux.setPort(2) == false) {
-      // Minutes 1s mux port failed
-      FAULT_SET(FAULT_I2C_MUX_PORT_2_FAIL);
-    } else {
-      // Initialize the Minute 1s column range sensor on i2c mux port 2
-      range_util_min_1s_column.Startup();
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      if (i2c_mux.setPort(COLUMN_TABLE[i].mux_port) == false) {
+        // Column mux port failed
+        FAULT_SET(mux_port_fault(COLUMN_TABLE[i].mux_port));
+      } else {
+        // Initialize the column range sensor on its i2c mux port
+        range_utils[i]->Startup();
+      }
     }
   } else {
     Serial.print("Skipping range sensor inits due to missing I2C Mux...");
@@ -254,24 +313,17 @@ void setup() {
                                  SC1509_PIN_FEED_PUMP,
                                  SX1509_PIN_WATER_LOW,
                                  SC1509_PIN_WATER_HIGH);
-  column_manager_hour = new ColumnManager(1,
-                                          &io_expander,
-                                          SC1509_PIN_HOUR_FEED,
-                                          SC1509_PIN_HOUR_DRAIN,
-                                          MIN_WATER_COLUMN_ELEVATION,
-                                          MAX_WATER_COLUMN_ELEVATION);
-  column_manager_min_10s = new ColumnManager(2,
-                                             &io_expander,
-                                             SC1509_PIN_MIN_10s_FEED,
-                                             SC1509_PIN_MIN_10s_DRAIN,
-                                             MIN_WATER_COLUMN_ELEVATION,
-                                             MAX_WATER_COLUMN_ELEVATION);
-  column_manager_min_1s = new ColumnManager(3,
-                                            &io_expander,
-                                            SC1509_PIN_MIN_1s_FEED,
-                                            SC1509_PIN_MIN_1s_DRAIN,
-                                            MIN_WATER_COLUMN_ELEVATION,
-                                            MAX_WATER_COLUMN_ELEVATION);
+  tank_manager->Startup();
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    column_managers[i] = new ColumnManager(i + 1,
+                                           &io_expander,
+                                           COLUMN_TABLE[i].feed_pin,
+                                           COLUMN_TABLE[i].drain_pin,
+                                           MIN_WATER_COLUMN_ELEVATION,
+                                           MAX_WATER_COLUMN_ELEVATION);
+  }
+  move_planner = new MovePlanner(column_managers, NUM_COLUMNS);
+  pump_scheduler = new PumpScheduler(tank_manager, &clock_manager);
 
 
   //
@@ -279,16 +331,21 @@ void setup() {
   // It needs access to the sensors, regulators and clock.
   //
   ui_manager = new UIManager(&io_expander,
-                             &range_util_hour_column,
-                             &range_util_min_10s_column,
-                             &range_util_min_1s_column,
-                             column_manager_hour,
-                             column_manager_min_10s,
-                             column_manager_min_1s,
+                             range_utils,
+                             column_managers,
                              tank_manager,
                              &clock_manager);
   ui_manager->Startup();
 
+  //
+  // Create the sleep window power control.  It needs the sensors, the mux, the UI and the clock.
+  //
+  power_manager = new PowerManager(&clock_manager,
+                                   ui_manager,
+                                   &console,
+                                   range_utils,
+                                   &i2c_mux);
+
   //
   // Activate clock mode as the default
   //
@@ -307,6 +364,9 @@ void loop() {
   //
   console.Loop();
 
+  // Write a pending host time sync once its second starts
+  sync_time_update();
+
   //
   // Real-Time Clock read
   //
@@ -315,115 +375,106 @@ void loop() {
   // Process the user interface menu
   ui_manager->Update();
 
-
   //
-  // Compute the desired float marker elevations for the Hour, Min_10s and Min_1s columns.
-  // This is done by taking the time and splitting it into the relevant digits and scaling
-  // to a range sensor target.
-  // There are provisions to override the target setpoint in the console for tuning purposes.
+  // Sleep window power control.  While sleeping only the console, the RTC and the keys are serviced.
   //
-  uint16_t hour_setpoint;
-  if (ui_manager->Get_Hour_Column_Override_Setpoint_Enable()) {
-    // User the diagnostic override value for the hour column setpoint
-    hour_setpoint = ui_manager->Get_Hour_Column_Override_Setpoint();
-  } else if (clock_manager.Is_Sleep_Time()) {
-    // Use the sleep mode setpoint for the hour column setpoint
-    hour_setpoint = 300;
-  } else {
-    // Use the scaled clock time to drive the hour column setpoint
-    hour_setpoint = scale_hours_to_elevation(clock_manager.Get_Hour());
+  power_manager->Update();
+  if (power_manager->Is_Sleeping()) {
+    power_manager->Idle();
+    return;
   }
 
-  uint16_t min_10s_setpoint;
-  if (ui_manager->Get_Min_10s_Column_Override_Setpoint_Enable()) {
-    // User the diagnostic override value for the min 10s column setpoint
-    min_10s_setpoint = ui_manager->Get_Min_10s_Column_Override_Setpoint();
-  } else if (clock_manager.Is_Sleep_Time()) {
-    // Use the sleep mode setpoint for the min 10s column setpoint
-    min_10s_setpoint = 300;
-  } else {
-    // Use the scaled clock time to drive the min 10s column setpoint
-    min_10s_setpoint = scale_minutes_10s_to_elevation(clock_manager.Get_Minute());
-  }
 
-  uint16_t min_1s_setpoint;
-  if (ui_manager->Get_Min_1s_Column_Override_Setpoint_Enable()) {
-    // User the diagnostic override value for the min 1s column setpoint
-    min_1s_setpoint = ui_manager->Get_Min_1s_Column_Override_Setpoint();
-  } else if (clock_manager.Is_Sleep_Time()) {
-    // Use the sleep mode setpoint for the min 1s column setpoint
-    min_1s_setpoint = 300;
-  } else {
-    // Use the scaled clock time to drive the min 1s column setpoint
-    min_1s_setpoint = scale_minutes_1s_to_elevation(clock_manager.Get_Minute());
+  //
+  // Select the desired float marker elevation for every column.
+  // The clock driven setpoints are recomputed by clock_setpoint_event() when the time changes.
+  // There are provisions to override the target setpoint in the console for tuning purposes.
+  //
+  uint16_t setpoints[NUM_COLUMNS];
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    if (ui_manager->Get_Column_Override_Setpoint_Enable(i)) {
+      // User the diagnostic override value for the column setpoint
+      setpoints[i] = ui_manager->Get_Column_Override_Setpoint(i);
+    } else {
+      setpoints[i] = clock_setpoints[i];
+    }
   }
 
   //
   // Update sensor readings and linearize with calibration table
   //
-  i2c_mux.setPort(0);
-  range_util_hour_column.Update();
-  // Linearize this column raw reading
-  double raw_median_range = (double)range_util_hour_column.Get_Median_Reading();
-  double linearized_range = Interpolation::Linear(hour_range_cal_x_values,
-                                                  hour_range_cal_y_values,
-                                                  NUM_RANGE_CAL_BREAKS,
-                                                  raw_median_range,
-                                                  true);
-  range_util_hour_column.Set_Linearized_Median_Reading((uint16_t)linearized_range);
-  //Serial.print("  LINEARIZE ");
-  //Serial.print(raw_median_range);
-  //Serial.print(" to ");
-  //Serial.println(linearized_range);
-
-  i2c_mux.setPort(1);
-  range_util_min_10s_column.Update();
-  // Linearize this column raw reading
-  raw_median_range = (double)range_util_min_10s_column.Get_Median_Reading();
-  linearized_range = Interpolation::Linear(min_10s_range_cal_x_values,
-                                           min_10s_range_cal_y_values,
-                                           NUM_RANGE_CAL_BREAKS,
-                                           raw_median_range,
-                                           true);
-  range_util_min_10s_column.Set_Linearized_Median_Reading((uint16_t)linearized_range);
-  //Serial.print("  LINEARIZE ");
-  //Serial.print(raw_median_range);
-  //Serial.print(" to ");
-  //Serial.println(linearized_range);
-
-  i2c_mux.setPort(2);
-  range_util_min_1s_column.Update();
-  // Linearize this column raw reading
-  raw_median_range = (double)range_util_min_1s_column.Get_Median_Reading();
-  linearized_range = Interpolation::Linear(min_1s_range_cal_x_values,
-                                           min_1s_range_cal_y_values,
-                                           NUM_RANGE_CAL_BREAKS,
-                                           raw_median_range,
-                                           true);
-  range_util_min_1s_column.Set_Linearized_Median_Reading((uint16_t)linearized_range);
-  //Serial.print("  LINEARIZE ");
-  //Serial.print(raw_median_range);
-  //Serial.print(" to ");
-  //Serial.println(linearized_range);
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    i2c_mux.setPort(COLUMN_TABLE[i].mux_port);
+    range_utils[i]->Update();
+    // Linearize this column raw reading
+    double raw_median_range = (double)range_utils[i]->Get_Median_Reading();
+    double linearized_range = Interpolation::Linear(COLUMN_TABLE[i].range_cal_x_values,
+                                                    COLUMN_TABLE[i].range_cal_y_values,
+                                                    NUM_RANGE_CAL_BREAKS,
+                                                    raw_median_range,
+                                                    true);
+    range_utils[i]->Set_Linearized_Median_Reading((uint16_t)linearized_range);
+    //Serial.print("  LINEARIZE ");
+    //Serial.print(raw_median_range);
+    //Serial.print(" to ");
+    //Serial.println(linearized_range);
+  }
+
+  // Hold the regulators until every sensor has a fresh reading after a sleep
+  if (!power_manager->Is_Awake()) {
+    control_pass_usec = 0;
+    return;
+  }
+
+  // Measure the column control period, the gaps show any stall in the loop
+  uint32_t now_usec = micros();
+  if (control_pass_usec != 0) {
+    control_period_stats.Add(now_usec - control_pass_usec);
+    control_period_histogram.Add(now_usec - control_pass_usec);
+  }
+  control_pass_usec = now_usec;
 
   //
   // Process each water column regulator with the latest column elevation, setpoint and override requests.
   // Support overrides for turning the drain and fill valves on for maintenance.
   //
-  bool busy = column_manager_hour->Update(range_util_hour_column.Get_Linearized_Median_Reading(),
-                                          hour_setpoint);
+  bool busy = false;
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    busy |= column_managers[i]->Update(range_utils[i]->Get_Linearized_Median_Reading(),
+                                       setpoints[i]);
+  }
 
-  busy |= column_manager_min_10s->Update(range_util_min_10s_column.Get_Linearized_Median_Reading(),
-                                         min_10s_setpoint);
+  // Schedule which columns may start their next move
+  move_planner->Update();
 
-  busy |= column_manager_min_1s->Update(range_util_min_1s_column.Get_Linearized_Median_Reading(),
-                                        min_1s_setpoint);
+  // Measure the transition times with and without the pump arbitration
+  if (planner_transition_active && !move_planner->Is_Transition_Active()) {
+    arbitration_transition_stats[tank_manager->Is_Arbitration_Enabled() ? 1 : 0].Add(move_planner->Get_Last_Transition_Time_MSEC());
+  }
+  planner_transition_active = move_planner->Is_Transition_Active();
 
-  // Process the tank_manager manager
-  //if (!busy)
-  //{
+  //
+  // Process the tank_manager manager.
+  // The pump is deferred while columns are busy and the scheduler, run by the clock events, requests the planned top ups.
+  // A transition counts as busy from its first move to the last settle, the pump waits out the whole digit change.
+  //
+  bool transition_busy = busy || move_planner->Is_Transition_Active();
+  tank_manager->Set_Column_Demand(transition_busy);
+  uint32_t total_fill_mm = 0;
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    total_fill_mm += column_managers[i]->Get_Total_Fill_MM();
+  }
+  tank_manager->Set_Column_Fill_Total_MM(total_fill_mm);
   tank_manager->Update();
-  //}
+
+  // Any water still moving holds off the sleep
+  bool water_busy = transition_busy
+                    || ((tank_manager->Get_State() != TankManager::TANK_IDLE) && (tank_manager->Get_State() != TankManager::TANK_FILL_TIMEOUT_FAULT));
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    ColumnManager::COLUMN_STATE_TYPE_T state = column_managers[i]->Get_State();
+    water_busy |= (state != ColumnManager::COLUMN_IDLE) && (state != ColumnManager::COLUMN_ERROR_STATE);
+  }
+  power_manager->Set_Water_Busy(water_busy);
 
 
   //
@@ -443,9 +494,9 @@ void loop() {
   if (system_faults != 0x0000) {
     // Disable the regulators to prevent water/pump actuation with bad sensor inputs
     tank_manager->Set_Regulator_Enable(false);
-    column_manager_hour->Set_Regulator_Enable(false);
-    column_manager_min_10s->Set_Regulator_Enable(false);
-    column_manager_min_1s->Set_Regulator_Enable(false);
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      column_managers[i]->Set_Regulator_Enable(false);
+    }
   }
 
 
@@ -462,51 +513,236 @@ void loop() {
 
 
 //
+// Fault raised when the mux port of a column can not be selected.  Covers every port COLUMN_TABLE allows.
+//
+SYSTEM_FAULT_T mux_port_fault(uint8_t mux_port) {
+  switch (mux_port) {
+    case 0:
+      return FAULT_I2C_MUX_PORT_0_FAIL;
+    case 1:
+      return FAULT_I2C_MUX_PORT_1_FAIL;
+    case 2:
+      return FAULT_I2C_MUX_PORT_2_FAIL;
+    case 3:
+      return FAULT_I2C_MUX_PORT_3_FAIL;
+    case 4:
+      return FAULT_I2C_MUX_PORT_4_FAIL;
+    case 5:
+      return FAULT_I2C_MUX_PORT_5_FAIL;
+    case 6:
+      return FAULT_I2C_MUX_PORT_6_FAIL;
+    case 7:
+      return FAULT_I2C_MUX_PORT_7_FAIL;
+    default:
+      return FAULT_I2C_MUX_OFFLINE;
+  }
+}
+
+
 //
+// Clock event handler.  Computes the float marker elevation of every column by splitting the time into
+// the digit each column shows and scaling it to a range sensor target, or parks the columns while sleeping.
 //
-uint16_t scale_hours_to_elevation(uint16_t hours) {
-  if (hours > 12) {
-    hours = hours - 12;
+void clock_setpoint_event(uint8_t events, void *context) {
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    if (clock_manager.Is_Sleep_Time()) {
+      // Use the sleep mode setpoint for the column setpoint
+      clock_setpoints[i] = SLEEP_WATER_COLUMN_ELEVATION;
+    } else {
+      // Use the scaled clock time to drive the column setpoint
+      clock_setpoints[i] = scale_time_to_elevation(COLUMN_TABLE[i],
+                                                   clock_manager.Get_Hour(),
+                                                   clock_manager.Get_Minute(),
+                                                   clock_manager.Get_Second());
+    }
   }
+  clock_setpoint_updates++;
+}
 
-  // Scale 1-12 hours into hour_col_digit_elevations[NUM_HOUR_STEPS]
-  if ((hours >= 1) && (hours <= 12)) {
-    uint16_t elevation = hour_col_digit_elevations[hours - 1];
-    return elevation;
-  } else {
-    // Invalid time, set to safe value
-    return 150;
+
+//
+// Find the column addressed by a console unit number, 1 is the first column in COLUMN_TABLE.
+// Returns NULL when the unit is not a column.
+//
+ColumnManager *column_from_unit(String unit) {
+  int index = unit.toInt() - 1;
+  if ((unit.length() > 0) && (index >= 0) && (index < NUM_COLUMNS)) {
+    return column_managers[index];
   }
+  return NULL;
 }
 
 
 //
+// Schedule the RTC write of a host time sync.  The host time is carried forward to now with millis() and
+// the RTC is written by sync_time_update() right on the next whole second, since writing the seconds
+// restarts the RTC hundredths.  A device millis far from the arrival of the line is a stale or garbled
+// request and is refused.
+//
+void sync_time_set(String params, uint32_t line_rx_msec) {
+  char buffer[48];
+  params.toCharArray(buffer, sizeof(buffer));
+  char *next = buffer;
+  uint32_t epoch_sec = strtoul(next, &next, 10);
+  uint32_t epoch_msec = strtoul(next, &next, 10);
+  uint32_t device_msec = strtoul(next, &next, 10);
+  if ((epoch_sec == 0) || (epoch_msec >= 1000)) {
+    Serial.println("ERROR: Unsupported command!");
+    return;
+  }
+
+  int32_t age_msec = (int32_t)(line_rx_msec - device_msec);
+  if ((age_msec > (int32_t)SYNC_MAX_AGE_MSEC) || (age_msec < -(int32_t)SYNC_MAX_AGE_MSEC)) {
+    Serial.print("SYNC FAIL stale by ");
+    Serial.print(age_msec);
+    Serial.println(" msec");
+    return;
+  }
+
+  uint32_t now_msec = epoch_msec + (millis() - device_msec);
+  sync_target_sec = epoch_sec + (now_msec / 1000) + 1;
+  sync_deadline_msec = millis() + 1000 - (now_msec % 1000);
+  sync_retries = 0;
+  sync_pending = true;
+}
+
+
 //
+// Write a scheduled host time sync to the RTC once its second has started.  Writing the seconds restarts
+// the RTC hundredths, so the time is behind by however far the loop pass is into the second.  A pass
+// later than SYNC_LATE_MAX_MSEC waits for the next second instead, up to SYNC_RETRIES_MAX times.  A time
+// still written late is reported with SYNC LATE and is not used to measure the drift.
 //
-uint16_t scale_minutes_10s_to_elevation(uint16_t minutes) {
-  // Scale minutes 10s 0-5 into min_10s_col_digit_elevations[NUM_MIN_10S_STEPS]
-  if ((minutes >= 0) && (minutes <= 59)) {
-    uint16_t min_10s = minutes / 10;
-    uint16_t elevation = min_10s_col_digit_elevations[min_10s];
-    return elevation;
+void sync_time_update() {
+  if (!sync_pending) {
+    return;
+  }
+  uint32_t late_msec = millis() - sync_deadline_msec;
+  if ((int32_t)late_msec < 0) {
+    return;
+  }
+
+  // Whole seconds missed are carried in the time
+  uint32_t target_sec = sync_target_sec + late_msec / 1000;
+  uint32_t behind_msec = late_msec % 1000;
+  if ((behind_msec > SYNC_LATE_MAX_MSEC) && (sync_retries < SYNC_RETRIES_MAX)) {
+    sync_retries++;
+    sync_target_sec = target_sec + 1;
+    sync_deadline_msec += (late_msec / 1000 + 1) * 1000;
+    return;
+  }
+  sync_pending = false;
+
+  if (clock_manager.Set_Time_Epoch(target_sec, behind_msec <= SYNC_LATE_MAX_MSEC)) {
+    if (behind_msec > 0) {
+      Serial.print("SYNC LATE ");
+      Serial.print(behind_msec);
+      Serial.println(" msec");
+    }
+    Serial.print("SYNC DONE ");
+    Serial.println(target_sec);
   } else {
-    // Invalid time, set to safe value
-    return 150;
+    Serial.println("SYNC FAIL");
   }
 }
 
+
+//
+// Report the pump run history summary and the fill time warnings
+//
+void print_pump_history() {
+  tank_manager->Get_History()->Print_Summary(tank_manager->Get_Max_Fill_Time_MSEC());
+  Serial.print("   Fill time warning: ");
+  Serial.print(tank_manager->Is_Fill_Time_Warning() ? "ACTIVE" : "none");
+  Serial.print("  Long fills: ");
+  Serial.println(tank_manager->Get_Long_Fill_Count());
+}
+
+
 //
+// Report the debounce times and edge counts of a tank level switch
 //
+void print_level_filter(const char *name, DebouncedInput *filter) {
+  Serial.print("   ");
+  Serial.print(name);
+  Serial.print(" Switch: raw=");
+  Serial.print(filter->Get_Raw_State());
+  Serial.print(" wet ");
+  Serial.print(filter->Get_Assert_MSEC());
+  Serial.print("ms dry ");
+  Serial.print(filter->Get_Release_MSEC());
+  Serial.print("ms  Edges wet,dry: ");
+  Serial.print(filter->Get_Assert_Edges());
+  Serial.print(", ");
+  Serial.print(filter->Get_Release_Edges());
+  Serial.print("  Raw changes: ");
+  Serial.println(filter->Get_Raw_Changes());
+}
+
+
 //
-uint16_t scale_minutes_1s_to_elevation(uint16_t minutes) {
-  // Scale minutes 1s 0-9 into elevation steps in min_1s_col_digit_elevations[NUM_MIN_1S_STEPS]
-  if ((minutes >= 0) && (minutes <= 59)) {
-    uint16_t min_1s = minutes - ((minutes / 10) * 10);
-    uint16_t elevation = min_1s_col_digit_elevations[min_1s];
-    return elevation;
-  } else {
-    // Invalid time, set to safe value
-    return 150;
+// Report the transition times measured with the pump arbitration off and on
+//
+void print_arbitration_stats() {
+  Serial.print("   Arbitration: ");
+  Serial.println(tank_manager->Is_Arbitration_Enabled() ? "ON" : "OFF");
+  Serial.print("   Pump deferrals: ");
+  Serial.print(tank_manager->Get_Deferred_Count());
+  Serial.print("  Top ups: ");
+  Serial.println(tank_manager->Get_Top_Up_Count());
+  Serial.print("   Transition msec without policy: ");
+  arbitration_transition_stats[0].Print("ms");
+  Serial.println();
+  Serial.print("   Transition msec with policy:    ");
+  arbitration_transition_stats[1].Print("ms");
+  Serial.println();
+}
+
+
+//
+// Compare the planner strategies by simulating every top of the hour rollover,
+// these move every column at once and are the worst case transitions.
+//
+void run_planner_benchmark() {
+  uint16_t from_mm[NUM_COLUMNS];
+  uint16_t to_mm[NUM_COLUMNS];
+  uint32_t total_msec[MovePlanner::PLAN_STRATEGY_COUNT] = { 0 };
+  uint32_t worst_msec[MovePlanner::PLAN_STRATEGY_COUNT] = { 0 };
+
+  Serial.println("   Simulated rollover times in msec:");
+  Serial.print("   ROLLOVER");
+  for (uint8_t s = 0; s < MovePlanner::PLAN_STRATEGY_COUNT; s++) {
+    Serial.print(", ");
+    Serial.print(move_planner->Get_Strategy_Name((MovePlanner::PLAN_STRATEGY_T)s));
+  }
+  Serial.println();
+
+  for (uint16_t hour = 1; hour <= 12; hour++) {
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      from_mm[i] = scale_time_to_elevation(COLUMN_TABLE[i], hour, 59, 59);
+      to_mm[i] = scale_time_to_elevation(COLUMN_TABLE[i], hour + 1, 0, 0);
+    }
+
+    Serial.printf("   %2d:59->%2d:00", hour, (hour % 12) + 1);
+    for (uint8_t s = 0; s < MovePlanner::PLAN_STRATEGY_COUNT; s++) {
+      uint32_t msec = move_planner->Simulate_Transition(from_mm, to_mm, (MovePlanner::PLAN_STRATEGY_T)s);
+      total_msec[s] += msec;
+      if (msec > worst_msec[s]) {
+        worst_msec[s] = msec;
+      }
+      Serial.print(", ");
+      Serial.print(msec);
+    }
+    Serial.println();
+  }
+
+  for (uint8_t s = 0; s < MovePlanner::PLAN_STRATEGY_COUNT; s++) {
+    Serial.print("   ");
+    Serial.print(move_planner->Get_Strategy_Name((MovePlanner::PLAN_STRATEGY_T)s));
+    Serial.print(": mean=");
+    Serial.print(total_msec[s] / 12);
+    Serial.print(" worst=");
+    Serial.println(worst_msec[s]);
   }
 }
 
@@ -533,6 +769,10 @@ void print_tank_state(TankManager *tank_manager) {
       Serial.print("MANUAL_FILL");
       break;
 
+    case TankManager::TANK_FILL_DEFERRED:
+      Serial.print("FILL_DEFERRED");
+      break;
+
     case TankManager::TANK_FILL_TIMEOUT_FAULT:
       Serial.print("TANK_FILL_TIMEOUT");
       break;
@@ -613,6 +853,63 @@ void print_column_control_error_state(ColumnManager *column) {
 }
 
 
+//
+//
+//
+void print_column_flow_diagnostic(ColumnManager *column) {
+  switch (column->Get_Flow_Diagnostic()) {
+    case ColumnManager::FLOW_DIAG_OK:
+      Serial.print("OK");
+      break;
+    case ColumnManager::FLOW_DIAG_NO_FLOW:
+      Serial.print("NO_FLOW");
+      break;
+    case ColumnManager::FLOW_DIAG_REVERSE_FLOW:
+      Serial.print("REVERSE_FLOW");
+      break;
+    case ColumnManager::FLOW_DIAG_RUNAWAY:
+      Serial.print("RUNAWAY");
+      break;
+    default:
+      Serial.print("UNKNOWN");
+      break;
+  }
+  Serial.print(", last rate ");
+  Serial.print(column->Get_Observed_Rate_MM_Per_Sec());
+  Serial.print(" mm/s");
+}
+
+
+//
+//
+//
+void print_column_deadband_stats(ColumnManager *column) {
+  Serial.print("   Deadband: +/-");
+  Serial.print(column->Get_Setpoint_Deadband());
+  Serial.print(" mm (");
+  Serial.print(column->Get_Deadband_Min());
+  Serial.print("-");
+  Serial.print(column->Get_Deadband_Max());
+  Serial.print(")  Noise: ");
+  Serial.print(column->Get_Noise_Estimate_MM(), 2);
+  Serial.print(" mm  Coast: ");
+  Serial.print(column->Get_Coast_Estimate_MM(), 1);
+  Serial.println(" mm");
+  Serial.print("   Cycles Fill,Drain,Hunting: ");
+  Serial.print(column->Get_Fill_Cycles());
+  Serial.print(", ");
+  Serial.print(column->Get_Drain_Cycles());
+  Serial.print(", ");
+  Serial.println(column->Get_Hunting_Cycles());
+  Serial.print("   Settle time: ");
+  column->Get_Settle_Stats()->Print("ms");
+  Serial.println();
+  Serial.print("   Settle histogram msec: ");
+  column->Get_Settle_Histogram()->Print();
+  Serial.println();
+}
+
+
 //
 //
 //
@@ -666,49 +963,26 @@ void report_status_stream() {
   } else {
     Serial.print("TANK_HIGH=DRY, ");
   }
+  Serial.print("TANK_LEVEL=");
+  Serial.print(tank_manager->Get_Virtual_Level_Pct(), 1);
+  Serial.print("%, ");
 
   // Column Elevations and setpoints and errros
-  uint16_t elev_raw = range_util_hour_column.Get_Median_Reading();
-  uint16_t elev_lin = range_util_hour_column.Get_Linearized_Median_Reading();
-  uint16_t setpoint = column_manager_hour->Get_Target_Setpoint_MM();
-  int16_t error = setpoint - elev_lin;
-  Serial.print("(");
-  Serial.print(elev_raw);
-  Serial.print(", ");
-  Serial.print(elev_lin);
-  Serial.print(", ");
-  Serial.print(setpoint);
-  Serial.print(", ");
-  Serial.print(error);
-  Serial.print("), ");
-
-  elev_raw = range_util_min_10s_column.Get_Median_Reading();
-  elev_lin = range_util_min_10s_column.Get_Linearized_Median_Reading();
-  setpoint = column_manager_min_10s->Get_Target_Setpoint_MM();
-  error = setpoint - elev_lin;
-  Serial.print("(");
-  Serial.print(elev_raw);
-  Serial.print(", ");
-  Serial.print(elev_lin);
-  Serial.print(", ");
-  Serial.print(setpoint);
-  Serial.print(", ");
-  Serial.print(error);
-  Serial.print("), ");
-
-  elev_raw = range_util_min_1s_column.Get_Median_Reading();
-  elev_lin = range_util_min_1s_column.Get_Linearized_Median_Reading();
-  setpoint = column_manager_min_1s->Get_Target_Setpoint_MM();
-  error = setpoint - elev_lin;
-  Serial.print("(");
-  Serial.print(elev_raw);
-  Serial.print(", ");
-  Serial.print(elev_lin);
-  Serial.print(", ");
-  Serial.print(setpoint);
-  Serial.print(", ");
-  Serial.print(error);
-  Serial.print("), ");
+  for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+    uint16_t elev_raw = range_utils[i]->Get_Median_Reading();
+    uint16_t elev_lin = range_utils[i]->Get_Linearized_Median_Reading();
+    uint16_t setpoint = column_managers[i]->Get_Target_Setpoint_MM();
+    int16_t error = setpoint - elev_lin;
+    Serial.print("(");
+    Serial.print(elev_raw);
+    Serial.print(", ");
+    Serial.print(elev_lin);
+    Serial.print(", ");
+    Serial.print(setpoint);
+    Serial.print(", ");
+    Serial.print(error);
+    Serial.print("), ");
+  }
 
   Serial.println();
 }
@@ -737,18 +1011,46 @@ void console_rx_event(String command, String param1, String param2) {
     Serial.println("--------------------------------------------------------");
     Serial.println("   STATUS            - Report status block");
     Serial.println("   MODE x            - Set mode, x=CLOCK or STATIC or VALVE");
-    Serial.println("   FILL  x period    - Fill device x for period msec, 0=tank_manager,1=hr,2&3=min");
+    Serial.println("   FILL  x period    - Fill device x for period msec, 0=tank_manager,1..n=column");
     Serial.println("   DRAIN x period    - Drain column x for period msec");
-    Serial.println("   LOGON x           - Enable logging, 0=tank_manager,1=hr,2&3=min");
-    Serial.println("   LOGOFF x          - Disable logging, 0=tank_manager,1=hr,2&3=min");
+    Serial.println("   LOGON x           - Enable logging, 0=tank_manager,1..n=column,P=planner,S=scheduler");
+    Serial.println("   LOGOFF x          - Disable logging, 0=tank_manager,1..n=column,P=planner,S=scheduler");
     Serial.println("   STREAMON          - Enable periodic status streaming");
     Serial.println("   STREAMOFF         - Disable periodic status streaming");
-    Serial.println("   OVERRIDE x value  - Adjust setpoint for x to value, 1=hr,2&3=min");
-    Serial.println("   ENABLE x          - Enable regulator, 0=tank_manager,1=hr,2&3=min");
-    Serial.println("   DISABLE x         - Disable regulator, 0=tank_manager,1=hr,2&3=min");
+    Serial.println("   OVERRIDE x value  - Adjust setpoint for column x to value, 1..n=column");
+    Serial.println("   DEADBAND x min,max- Limit adaptive deadband of column x, 1..n=column");
+    Serial.println("   ENABLE x          - Enable regulator, 0=tank_manager,1..n=column");
+    Serial.println("   DISABLE x         - Disable regulator, 0=tank_manager,1..n=column");
+    Serial.println("   FLOWCLEAR x       - Clear the flow fault of column x, then ENABLE x to resume");
+    Serial.println("   PLAN x            - Set move planner, x=AUTO or SIMULTANEOUS or SEQUENTIAL or SHARED");
+    Serial.println("   PLAN STATS        - Report measured transition times and flow rates");
+    Serial.println("   PLAN BENCH        - Simulate each strategy on the hourly rollovers");
+    Serial.println("   PLAN RESET        - Clear the planner measurements");
+    Serial.println("   ARBITRATE x       - Pump vs column arbitration, x=ON or OFF or STATS or RESET");
+    Serial.println("   PUMP x            - Set pump drive, x=HARD or SOFT or STATS or RESET");
+    Serial.println("   PUMP RAMP u,d,s   - Soft ramp up u msec, down d msec from start duty s");
+    Serial.println("   PUMP x            - Pump run history, x=HISTORY or CLEAR");
+    Serial.println("   DEBOUNCE x w,d    - Level switch x=L or H must hold wet w msec, dry d msec");
+    Serial.println("   SCHED x           - Pump schedule, x=HOURLY or ROLLOVER or STATS or FORECAST");
     Serial.println("   TIME READ         - Report time in HH:MM:SS");
-    Serial.println("   TIME SET x        - Set time to epoch x");
+    Serial.println("   TIME SET x        - Set time to UTC epoch x");
+    Serial.println("   SYNC REQ t        - Time sync request, replies SYNC RSP t rx_ms tx_ms");
+    Serial.println("   SYNC SET s m d    - Set time to epoch s + m msec as of device millis d");
+    Serial.println("   DRIFT x           - RTC drift trim, x=ON or OFF or STATS or CLEAR");
+    Serial.println("   POWER x           - Sleep window power saving, x=ON or OFF or STATS or RESET");
+    Serial.println("   POWER LIGHT x     - ESP32 light sleep while sleeping, x=ON or OFF");
+    Serial.println("   DISPLAY x         - Display flush, x=FULL or TILES or TASK or LOOP or STATS or RESET or BENCH");
+    Serial.println("   DISPLAY x         - Redraw, x=ALWAYS or CHANGES");
+    Serial.println("   DISPLAY HEAP      - Report the free heap and the canvas palette use");
+    Serial.println("   DISPLAY ATLAS x   - Text and sprites from the glyph atlas, x=ON or OFF");
+    Serial.println("   LOOP x            - Column control period jitter, x=STATS or RESET");
+    Serial.println("   KEYS x            - Key events, x=STATS or RESET");
     Serial.println("   RESTART           - Reboot the controller");
+    Serial.print("   Columns:");
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      Serial.printf(" %d=%s", i + 1, COLUMN_TABLE[i].name);
+    }
+    Serial.println();
     Serial.println("--------------------------------------------------------");
   } else if (command == "STATUS") {
     /* Dump Status Block */
@@ -768,51 +1070,45 @@ void console_rx_event(String command, String param1, String param2) {
     Serial.print(tank_manager->Is_Feed_Tank_Above_High_Mark());
     Serial.print(", ");
     Serial.println(tank_manager->Is_Feed_Tank_Above_Low_Mark());
-
-    Serial.println("<<<<--Hour Column Status-->>>>");
-    Serial.print("   Column State: ");
-    print_column_state(column_manager_hour);
-    Serial.println();
-    Serial.print("   Column Regulator Enable: ");
-    Serial.println(column_manager_hour->Is_Column_Regulator_Enabled());
-    Serial.print("   Column Error State: ");
-    print_column_control_error_state(column_manager_hour);
-    Serial.println();
-    Serial.print("   Setpoint: ");
-    Serial.print(column_manager_hour->Get_Target_Setpoint_MM());
-    Serial.print("   Elevation: ");
-    Serial.print(column_manager_hour->Get_Elevation_Reading_MM());
-    Serial.println();
-
-    Serial.println("<<<<--Min 10s Column Status-->>>>");
-    Serial.print("   Column State: ");
-    print_column_state(column_manager_min_10s);
-    Serial.println();
-    Serial.print("   Column Regulator Enable: ");
-    Serial.println(column_manager_min_10s->Is_Column_Regulator_Enabled());
-    Serial.print("   Column Error State: ");
-    print_column_control_error_state(column_manager_min_10s);
-    Serial.println();
-    Serial.print("   Setpoint: ");
-    Serial.print(column_manager_min_10s->Get_Target_Setpoint_MM());
-    Serial.print("   Elevation: ");
-    Serial.print(column_manager_min_10s->Get_Elevation_Reading_MM());
-    Serial.println();
-
-    Serial.println("<<<<--Min 1s Column Status-->>>>");
-    Serial.print("   Column State: ");
-    print_column_state(column_manager_min_1s);
-    Serial.println();
-    Serial.print("   Column Regulator Enable: ");
-    Serial.println(column_manager_min_1s->Is_Column_Regulator_Enabled());
-    Serial.print("   Column Error State: ");
-    print_column_control_error_state(column_manager_min_1s);
-    Serial.println();
-    Serial.print("   Setpoint: ");
-    Serial.print(column_manager_min_1s->Get_Target_Setpoint_MM());
-    Serial.print("   Elevation: ");
-    Serial.print(column_manager_min_1s->Get_Elevation_Reading_MM());
-    Serial.println();
+    Serial.print("   Virtual Level: ");
+    Serial.print(tank_manager->Get_Virtual_Level_Pct(), 1);
+    Serial.print("%  Pump Rate: ");
+    Serial.print(tank_manager->Get_Pump_Rate_Pct_Per_Sec(), 2);
+    Serial.print(" %/s  Column Draw: ");
+    Serial.print(tank_manager->Get_Column_Pct_Per_MM(), 4);
+    Serial.println(" %/mm");
+    print_level_filter("Low", tank_manager->Get_Level_Filter(false));
+    print_level_filter("High", tank_manager->Get_Level_Filter(true));
+    Serial.print("   Pump starts: ");
+    Serial.println(tank_manager->Get_Pump_Start_Count());
+    pump_scheduler->Print_Stats();
+    print_arbitration_stats();
+    tank_manager->Print_Pump_Stats();
+    print_pump_history();
+
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      ColumnManager *column = column_managers[i];
+      Serial.print("<<<<--");
+      Serial.print(COLUMN_TABLE[i].name);
+      Serial.println(" Column Status-->>>>");
+      Serial.print("   Column State: ");
+      print_column_state(column);
+      Serial.println();
+      Serial.print("   Column Regulator Enable: ");
+      Serial.println(column->Is_Column_Regulator_Enabled());
+      Serial.print("   Column Error State: ");
+      print_column_control_error_state(column);
+      Serial.println();
+      Serial.print("   Setpoint: ");
+      Serial.print(column->Get_Target_Setpoint_MM());
+      Serial.print("   Elevation: ");
+      Serial.print(column->Get_Elevation_Reading_MM());
+      Serial.println();
+      Serial.print("   Flow Diagnostic: ");
+      print_column_flow_diagnostic(column);
+      Serial.println();
+      print_column_deadband_stats(column);
+    }
 
   } else if (command == "MODE") {
     /*
@@ -838,18 +1134,13 @@ void console_rx_event(String command, String param1, String param2) {
      */
     //unsigned long period = strtol(param2.c_str(), NULL, 10);
     uint32_t period = param2.toInt();
+    ColumnManager *column = column_from_unit(param1);
     if (param1 == "0") {
       Serial.println("  Manually filling feed tank_manager->..");
       tank_manager->Manual_Fill(period);
-    } else if (param1 == "1") {
-      Serial.println("  Manually filling hour column...");
-      column_manager_hour->Manual_Fill(period);
-    } else if (param1 == "2") {
-      Serial.println("  Manually filling min 10s column...");
-      column_manager_min_10s->Manual_Fill(period);
-    } else if (param1 == "3") {
-      Serial.println("  Manually filling min 1s column...");
-      column_manager_min_1s->Manual_Fill(period);
+    } else if (column != NULL) {
+      Serial.printf("  Manually filling %s column...\n", COLUMN_TABLE[param1.toInt() - 1].name);
+      column->Manual_Fill(period);
     } else {
       Serial.println("ERROR: Unsupported command!");
     }
@@ -859,15 +1150,10 @@ void console_rx_event(String command, String param1, String param2) {
      * Results in manual Drain of column 1 for 2 seconds.
      */
     unsigned long period = strtol(param2.c_str(), NULL, 10);
-    if (param1 == "1") {
-      column_manager_hour->Manual_Drain(period);
-      Serial.println("  Manually draining hour column...");
-    } else if (param1 == "2") {
-      column_manager_min_10s->Manual_Drain(period);
-      Serial.println("  Manually draining min 10s column...");
-    } else if (param1 == "3") {
-      column_manager_min_1s->Manual_Drain(period);
-      Serial.println("  Manually draining min 1s column...");
+    ColumnManager *column = column_from_unit(param1);
+    if (column != NULL) {
+      column->Manual_Drain(period);
+      Serial.printf("  Manually draining %s column...\n", COLUMN_TABLE[param1.toInt() - 1].name);
     } else {
       Serial.println("ERROR: Unsupported command!");
     }
@@ -876,32 +1162,21 @@ void console_rx_event(String command, String param1, String param2) {
      * Expecting "LOGON 1"
      * Results in enable of logging for element 1.
      */
-    int unit = param1.toInt();
+    ColumnManager *column = column_from_unit(param1);
     Serial.println("About to enable logging...");
 
-    if ((unit >= 0) && (unit <= 3)) {
-      Serial.println("Unit is valid!");
-      switch (unit) {
-        case 0:
-          tank_manager->Enable_Logging();
-          Serial.println("Enabled loggin on tank_manager->");
-          break;
-
-        case 1:
-          column_manager_hour->Enable_Logging();
-          Serial.println("Enabled loggin on Hour column.");
-          break;
-
-        case 2:
-          column_manager_min_10s->Enable_Logging();
-          Serial.println("Enabled loggin on Min 10s column.");
-          break;
-
-        case 3:
-          column_manager_min_1s->Enable_Logging();
-          Serial.println("Enabled loggin on Min 1s column.");
-          break;
-      }
+    if (param1 == "0") {
+      tank_manager->Enable_Logging();
+      Serial.println("Enabled loggin on tank_manager->");
+    } else if (column != NULL) {
+      column->Enable_Logging();
+      Serial.printf("Enabled loggin on %s column.\n", COLUMN_TABLE[param1.toInt() - 1].name);
+    } else if (param1 == "P") {
+      move_planner->Enable_Logging();
+      Serial.println("Enabled loggin on move planner.");
+    } else if (param1 == "S") {
+      pump_scheduler->Enable_Logging();
+      Serial.println("Enabled loggin on pump scheduler.");
     } else {
       Serial.println("Invalid unit field!");
     }
@@ -910,29 +1185,19 @@ void console_rx_event(String command, String param1, String param2) {
      * Expecting "LOGOFF 1"
      * Results in disable of logging for element 1.
      */
-    int unit = param1.toInt();
-    if ((unit >= 0) && (unit <= 3)) {
-      switch (unit) {
-        case 0:
-          tank_manager->Disable_Logging();
-          Serial.println("Disabled loggin on tank_manager->");
-          break;
-
-        case 1:
-          column_manager_hour->Disable_Logging();
-          Serial.println("Disabled loggin on Hour column.");
-          break;
-
-        case 2:
-          column_manager_min_10s->Disable_Logging();
-          Serial.println("Disabled loggin on Min 10s column.");
-          break;
-
-        case 3:
-          column_manager_min_1s->Disable_Logging();
-          Serial.println("Disabled loggin on Min 1s column.");
-          break;
-      }
+    ColumnManager *column = column_from_unit(param1);
+    if (param1 == "0") {
+      tank_manager->Disable_Logging();
+      Serial.println("Disabled loggin on tank_manager->");
+    } else if (column != NULL) {
+      column->Disable_Logging();
+      Serial.printf("Disabled loggin on %s column.\n", COLUMN_TABLE[param1.toInt() - 1].name);
+    } else if (param1 == "P") {
+      move_planner->Disable_Logging();
+      Serial.println("Disabled loggin on move planner.");
+    } else if (param1 == "S") {
+      pump_scheduler->Disable_Logging();
+      Serial.println("Disabled loggin on pump scheduler.");
     } else {
       Serial.println("Invalid unit field!");
     }
@@ -945,61 +1210,203 @@ void console_rx_event(String command, String param1, String param2) {
   } else if (command == "ENABLE") {
     /*
      * Expecting "ENABLE 1"
-     * Results in turning on the regulator for device 1 (0=Tank, 1=Hour, 2= Min10s, 3=Min1s)
+     * Results in turning on the regulator for device 1 (0=Tank, 1..n=column in COLUMN_TABLE)
      */
+    ColumnManager *column = column_from_unit(param1);
     if (param1 == "0") {
       Serial.println("  Enabling tank_manager regulator...");
       tank_manager->Set_Regulator_Enable(true);
-    } else if (param1 == "1") {
-      Serial.println("  Enabling Hour column regulator...");
-      column_manager_hour->Set_Regulator_Enable(true);
-    } else if (param1 == "2") {
-      Serial.println("  Enabling Minutes 10s column regulator...");
-      column_manager_min_10s->Set_Regulator_Enable(true);
-    } else if (param1 == "3") {
-      Serial.println("  Enabling Minutes 1s column regulator...");
-      column_manager_min_1s->Set_Regulator_Enable(true);
+    } else if (column != NULL) {
+      Serial.printf("  Enabling %s column regulator...\n", COLUMN_TABLE[param1.toInt() - 1].name);
+      column->Set_Regulator_Enable(true);
     } else {
       Serial.println("ERROR: Unsupported command!");
     }
   } else if (command == "DISABLE") {
     /*
      * Expecting "DISABLE 1"
-     * Results in turning off the regulator for device 1 (0=Tank, 1=Hour, 2= Min10s, 3=Min1s)
+     * Results in turning off the regulator for device 1 (0=Tank, 1..n=column in COLUMN_TABLE)
      */
+    ColumnManager *column = column_from_unit(param1);
     if (param1 == "0") {
       Serial.println("  Disabling tank_manager regulator...");
       tank_manager->Set_Regulator_Enable(false);
-    } else if (param1 == "1") {
-      Serial.println("  Disabling Hour column regulator...");
-      column_manager_hour->Set_Regulator_Enable(false);
-    } else if (param1 == "2") {
-      Serial.println("  Disabling Minutes 10s column regulator...");
-      column_manager_min_10s->Set_Regulator_Enable(false);
-    } else if (param1 == "3") {
-      Serial.println("  Disabling Minutes 1s column regulator...");
-      column_manager_min_1s->Set_Regulator_Enable(false);
+    } else if (column != NULL) {
+      Serial.printf("  Disabling %s column regulator...\n", COLUMN_TABLE[param1.toInt() - 1].name);
+      column->Set_Regulator_Enable(false);
     } else {
       Serial.println("ERROR: Unsupported command!");
     }
+  } else if (command == "FLOWCLEAR") {
+    /*
+     * Expecting "FLOWCLEAR 1"
+     * Results in clearing the latched flow fault of column 1 and restarting its flow monitor.
+     */
+    ColumnManager *column = column_from_unit(param1);
+    if (column == NULL) {
+      Serial.println("ERROR: Unsupported command!");
+    } else if (column->Clear_Flow_Fault()) {
+      Serial.printf("  Cleared %s column flow fault, ENABLE %s to resume.\n", COLUMN_TABLE[param1.toInt() - 1].name, param1.c_str());
+    } else {
+      Serial.printf("  No flow fault on %s column.\n", COLUMN_TABLE[param1.toInt() - 1].name);
+    }
   } else if (command == "OVERRIDE") {
     /*
      * Expecting "OVERRIDE 1 150"
      * Results in enabling setpoint override and making hour setpoint = 150..
      */
     uint32_t value = param2.toInt();
-    if (param1 == "1") {
-      Serial.print("  Setting setpoint for hour column to: ");
-      Serial.println(value);
-      ui_manager->Set_Hour_Column_Override_Setpoint(value);
-    } else if (param1 == "2") {
-      Serial.print("  Setting setpoint for min 10s column to: ");
+    if (column_from_unit(param1) != NULL) {
+      Serial.printf("  Setting setpoint for %s column to: ", COLUMN_TABLE[param1.toInt() - 1].name);
       Serial.println(value);
-      ui_manager->Set_Min_10s_Column_Override_Setpoint(value);
-    } else if (param1 == "3") {
-      Serial.print("  Setting setpoint for min 1s column to: ");
-      Serial.println(value);
-      ui_manager->Set_Min_1s_Column_Override_Setpoint(value);
+      ui_manager->Set_Column_Override_Setpoint(param1.toInt() - 1, value);
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "DEADBAND") {
+    /*
+     * Expecting "DEADBAND 1 2,8"
+     * Results in the hour column deadband adapting between 2 and 8 mm.
+     */
+    int split_point = param2.indexOf(',');
+    uint16_t min_mm = param2.substring(0, split_point).toInt();
+    uint16_t max_mm = (split_point > 0) ? param2.substring(split_point + 1).toInt() : min_mm;
+    ColumnManager *column = column_from_unit(param1);
+
+    if ((column != NULL) && (min_mm > 0)) {
+      column->Set_Deadband_Limits(min_mm, max_mm);
+      Serial.print("  Deadband limits set to ");
+      Serial.print(column->Get_Deadband_Min());
+      Serial.print("-");
+      Serial.println(column->Get_Deadband_Max());
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "PLAN") {
+    /*
+     * Expecting "PLAN AUTO" or "PLAN SHARED" or "PLAN STATS" or "PLAN BENCH"
+     * Results in a planner strategy change or a planner report.
+     */
+    if (param1 == "AUTO") {
+      Serial.println("  Planner picks the fastest simulated strategy for each transition.");
+      move_planner->Set_Auto_Strategy(true);
+    } else if (param1 == "SIMULTANEOUS") {
+      Serial.println("  Planner moves all columns at once.");
+      move_planner->Set_Strategy(MovePlanner::PLAN_SIMULTANEOUS);
+    } else if (param1 == "SEQUENTIAL") {
+      Serial.println("  Planner moves one column at a time.");
+      move_planner->Set_Strategy(MovePlanner::PLAN_SEQUENTIAL);
+    } else if (param1 == "SHARED") {
+      Serial.println("  Planner moves one column per feed and drain path.");
+      move_planner->Set_Strategy(MovePlanner::PLAN_SHARED_PATH);
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--Move Planner Status-->>>>");
+      move_planner->Print_Stats();
+    } else if (param1 == "BENCH") {
+      run_planner_benchmark();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing planner measurements.");
+      move_planner->Reset_Stats();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "ARBITRATE") {
+    /*
+     * Expecting "ARBITRATE ON" or "ARBITRATE STATS"
+     * Results in the pump deferring to column moves, or a report of transition times.
+     */
+    if (param1 == "ON") {
+      Serial.println("  Pump defers to column moves.");
+      tank_manager->Set_Arbitration_Enable(true);
+    } else if (param1 == "OFF") {
+      Serial.println("  Pump runs regardless of column moves.");
+      tank_manager->Set_Arbitration_Enable(false);
+    } else if (param1 == "STATS") {
+      print_arbitration_stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing arbitration measurements.");
+      arbitration_transition_stats[0].Reset();
+      arbitration_transition_stats[1].Reset();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "PUMP") {
+    /*
+     * Expecting "PUMP SOFT" or "PUMP RAMP 1500,500,80"
+     * Results in a pump drive change, a new ramp profile or a report of ramp and fill times.
+     */
+    if (param1 == "HARD") {
+      Serial.println("  Pump drive set to hard on/off.");
+      tank_manager->Set_Pump_Drive_Mode(TankManager::PUMP_DRIVE_HARD);
+    } else if (param1 == "SOFT") {
+      Serial.println("  Pump drive set to soft ramps.");
+      tank_manager->Set_Pump_Drive_Mode(TankManager::PUMP_DRIVE_SOFT);
+    } else if (param1 == "RAMP") {
+      int first_split = param2.indexOf(',');
+      int second_split = param2.indexOf(',', first_split + 1);
+      if ((first_split > 0) && (second_split > first_split)) {
+        tank_manager->Set_Pump_Ramp(param2.substring(0, first_split).toInt(),
+                                    param2.substring(first_split + 1, second_split).toInt(),
+                                    constrain(param2.substring(second_split + 1).toInt(), 0L, 255L));
+        Serial.print("  Pump ramp up,down msec: ");
+        Serial.print(tank_manager->Get_Pump_Ramp_Up_MSEC());
+        Serial.print(", ");
+        Serial.print(tank_manager->Get_Pump_Ramp_Down_MSEC());
+        Serial.print("  start duty: ");
+        Serial.println(tank_manager->Get_Pump_Ramp_Start_Duty());
+      } else {
+        Serial.println("ERROR: Unsupported command!");
+      }
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--Pump Drive Status-->>>>");
+      tank_manager->Print_Pump_Stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing pump measurements.");
+      tank_manager->Reset_Pump_Stats();
+    } else if (param1 == "HISTORY") {
+      Serial.println("<<<<--Pump Run History-->>>>");
+      print_pump_history();
+      tank_manager->Get_History()->Print_Records();
+    } else if (param1 == "CLEAR") {
+      Serial.println("  Clearing saved pump run history.");
+      tank_manager->Get_History()->Clear();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "DEBOUNCE") {
+    /*
+     * Expecting "DEBOUNCE H 750,1500"
+     * Results in the high level switch qualifying wet after 750 msec and dry after 1500 msec.
+     */
+    int split_point = param2.indexOf(',');
+    if (((param1 == "L") || (param1 == "H")) && (split_point > 0)) {
+      tank_manager->Set_Level_Debounce(param1 == "H",
+                                       param2.substring(0, split_point).toInt(),
+                                       param2.substring(split_point + 1).toInt());
+      Serial.println("  Level switch debounce updated.");
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+  } else if (command == "SCHED") {
+    /*
+     * Expecting "SCHED HOURLY" or "SCHED FORECAST"
+     * Results in a pump schedule change or a report of the forecast column fills.
+     */
+    if (param1 == "HOURLY") {
+      Serial.println("  Pump refills planned once per hour.");
+      pump_scheduler->Set_Mode(PumpScheduler::PUMP_SCHEDULE_HOURLY);
+    } else if (param1 == "ROLLOVER") {
+      Serial.println("  Pump tops up ahead of large rollovers.");
+      pump_scheduler->Set_Mode(PumpScheduler::PUMP_SCHEDULE_ROLLOVER);
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--Pump Scheduler Status-->>>>");
+      pump_scheduler->Print_Stats();
+    } else if (param1 == "FORECAST") {
+      Serial.println("   Forecast column fill mm per hour:");
+      for (uint8_t hour = 0; hour < 24; hour++) {
+        uint32_t fill_mm = pump_scheduler->Forecast_Fill_MM(hour, 0, 60);
+        Serial.printf("   %02d:00 %5lu mm %5.1f%%\n", hour, (unsigned long)fill_mm, fill_mm * tank_manager->Get_Column_Pct_Per_MM());
+      }
     } else {
       Serial.println("ERROR: Unsupported command!");
     }
@@ -1011,6 +1418,23 @@ void console_rx_event(String command, String param1, String param2) {
       Serial.print(clock_manager.Get_Minute());
       Serial.print(":");
       Serial.println(clock_manager.Get_Second());
+      Serial.print("   Zone: ");
+      Serial.print(clock_manager.Get_Time_Zone_Name());
+      Serial.print("  UTC offset: ");
+      Serial.print(clock_manager.Get_UTC_Offset_Minutes());
+      Serial.print(" min");
+      Serial.println(clock_manager.Is_DST() ? "  DST" : "");
+      Serial.print("   UTC epoch: ");
+      Serial.println(clock_manager.Get_UTC_Epoch());
+      Serial.print("   Clock events: ");
+      Serial.print(clock_manager.Get_Event_Count());
+      Serial.print("  Callbacks: ");
+      Serial.print(clock_manager.Get_Callback_Count());
+      Serial.print("  Setpoint updates: ");
+      Serial.println(clock_setpoint_updates);
+      Serial.print("   Last minute edge: ");
+      Serial.print(millis() - clock_manager.Get_Event_MSEC(ClockManager::CLOCK_EVENT_MINUTE));
+      Serial.println(" msec ago");
     } else if (param1 == "SET") {
       unsigned long epoch = strtol(param2.c_str(), NULL, 10);
       clock_manager.Set_Time_Epoch(epoch);
@@ -1018,6 +1442,194 @@ void console_rx_event(String command, String param1, String param2) {
       Serial.println("ERROR: Unsupported command!");
     }
 
+  } else if (command == "SYNC") {
+    /*
+     * Time sync exchange with a host, see tools/time_sync.
+     * Expecting "SYNC REQ 12345" and replies "SYNC RSP 12345 rx_ms tx_ms" with the device millis() the
+     * request line arrived and the reply left, so the host can measure the round trip and the offset.
+     * Expecting "SYNC SET 1700000000 250 4000123" as the epoch second and msec at device millis 4000123.
+     */
+    if (param1 == "REQ") {
+      uint32_t rx_msec = console.GetLineRxMsec();
+      Serial.print("SYNC RSP ");
+      Serial.print(param2);
+      Serial.print(" ");
+      Serial.print(rx_msec);
+      Serial.print(" ");
+      Serial.println(millis());
+    } else if (param1 == "SET") {
+      sync_time_set(param2, console.GetLineRxMsec());
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
+  } else if (command == "DRIFT") {
+    /*
+     * Expecting "DRIFT STATS" or "DRIFT OFF"
+     * Results in a report of the measured RTC drift or a change to the automatic offset trim.
+     */
+    RtcDriftTracker *drift = clock_manager.Get_Drift_Tracker();
+    if (param1 == "ON") {
+      Serial.println("  RTC offset trimmed from the time corrections.");
+      drift->Set_Auto_Trim(true);
+    } else if (param1 == "OFF") {
+      Serial.println("  RTC offset held.");
+      drift->Set_Auto_Trim(false);
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--RTC Drift Status-->>>>");
+      drift->Print_Stats();
+    } else if (param1 == "CLEAR") {
+      Serial.println("  Clearing RTC drift history and offset.");
+      drift->Clear();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
+  } else if (command == "POWER") {
+    /*
+     * Expecting "POWER STATS" or "POWER OFF" or "POWER LIGHT OFF"
+     * Results in a report of the sleep residency, estimated current and resume times or a change to the sleep mode.
+     */
+    if (param1 == "ON") {
+      Serial.println("  Sleeping in the sleep window.");
+      power_manager->Set_Enable(true);
+    } else if (param1 == "OFF") {
+      Serial.println("  Staying awake in the sleep window.");
+      power_manager->Set_Enable(false);
+    } else if (param1 == "LIGHT") {
+      if (param2 == "ON") {
+        Serial.println("  Light sleep enabled.");
+        power_manager->Set_Light_Sleep_Enable(true);
+      } else if (param2 == "OFF") {
+        Serial.println("  Light sleep disabled.");
+        power_manager->Set_Light_Sleep_Enable(false);
+      } else {
+        Serial.println("ERROR: Unsupported command!");
+      }
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--Power Status-->>>>");
+      power_manager->Print_Stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing the power measurements.");
+      power_manager->Reset_Stats();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
+  } else if (command == "DISPLAY") {
+    /*
+     * Expecting "DISPLAY STATS" or "DISPLAY FULL"
+     * Results in a report of the SPI bytes and CPU time per frame or a change to the flush mode.
+     */
+    DisplayFlushTask *flush_task = ui_manager->Get_Display_Flush_Task();
+    FrameFlusher *flusher = flush_task->Get_Frame_Flusher();
+    if (param1 == "FULL") {
+      Serial.println("  Pushing the whole frame.");
+      if (flush_task->Lock(100)) {
+        flusher->Set_Mode(FrameFlusher::FLUSH_MODE_FULL);
+        flush_task->Unlock();
+      }
+    } else if (param1 == "TILES") {
+      Serial.println("  Pushing the changed tiles.");
+      if (flush_task->Lock(100)) {
+        flusher->Set_Mode(FrameFlusher::FLUSH_MODE_TILES);
+        flush_task->Unlock();
+      }
+    } else if (param1 == "HEAP") {
+      PaletteCanvas *canvas = flush_task->Get_Back_Canvas();
+      Serial.print("  Free heap: ");
+      Serial.print(ESP.getFreeHeap());
+      Serial.print("  Canvas bytes: 2 x ");
+      Serial.print(canvas->Get_Bytes_Per_Line() * canvas->height());
+      Serial.print("  Palette colors: ");
+      Serial.print(canvas->Get_Palette_Count());
+      Serial.print("  misses: ");
+      Serial.println(canvas->Get_Palette_Misses());
+    } else if (param1 == "ATLAS") {
+      if (param2 == "ON") {
+        Serial.println("  Copying the text and sprites from the glyph atlas.");
+        ui_manager->Set_Glyph_Atlas_Enable(true);
+      } else if (param2 == "OFF") {
+        Serial.println("  Drawing the text and sprites with Adafruit GFX.");
+        ui_manager->Set_Glyph_Atlas_Enable(false);
+      } else {
+        Serial.println("ERROR: Unsupported command!");
+      }
+    } else if (param1 == "ALWAYS") {
+      Serial.println("  Redrawing on every UI update.");
+      ui_manager->Set_Render_Always(true);
+    } else if (param1 == "CHANGES") {
+      Serial.println("  Redrawing when the screen inputs change.");
+      ui_manager->Set_Render_Always(false);
+    } else if (param1 == "TASK") {
+      Serial.println("  Sending the frames from the display task.");
+      flush_task->Set_Async(true);
+    } else if (param1 == "LOOP") {
+      Serial.println("  Sending the frames from the loop.");
+      flush_task->Set_Async(false);
+    } else if (param1 == "STATS") {
+      Serial.println("<<<<--Display Flush Status-->>>>");
+      ui_manager->Print_Render_Stats();
+      ui_manager->Get_Trend_Plot()->Print_Stats();
+      ui_manager->Get_Clock_Face()->Print_Stats();
+      flush_task->Print_Stats();
+      flusher->Print_Stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing the display flush measurements.");
+      flush_task->Reset_Stats();
+      ui_manager->Reset_Render_Stats();
+      ui_manager->Get_Trend_Plot()->Reset_Stats();
+      ui_manager->Get_Clock_Face()->Reset_Stats();
+    } else if (param1 == "BENCH") {
+      Serial.println("  Timing 20 full frame pushes and palette expansions.");
+      if (flush_task->Lock(100)) {
+        flusher->Benchmark_Full(20);
+        flusher->Benchmark_Expand(20);
+        flush_task->Unlock();
+      }
+      flusher->Print_Stats();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
+  } else if (command == "LOOP") {
+    /*
+     * Expecting "LOOP STATS" or "LOOP RESET"
+     * Results in a report of the time between column control passes.
+     */
+    if (param1 == "STATS") {
+      Serial.println("<<<<--Loop Status-->>>>");
+      Serial.print("   Control period usec: ");
+      control_period_stats.Print("");
+      Serial.println();
+      Serial.print("   ");
+      control_period_histogram.Print();
+      Serial.println();
+      ui_manager->Get_Display_Flush_Task()->Print_Stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing the loop measurements.");
+      control_period_stats.Reset();
+      control_period_histogram.Reset();
+      control_pass_usec = 0;
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
+  } else if (command == "KEYS") {
+    /*
+     * Expecting "KEYS STATS" or "KEYS RESET"
+     * Results in a report of the key events and the event queue use.
+     */
+    if (param1 == "STATS") {
+      Serial.println("<<<<--Key Status-->>>>");
+      ui_manager->Get_Key_Pad()->Print_Stats();
+    } else if (param1 == "RESET") {
+      Serial.println("  Clearing the key measurements.");
+      ui_manager->Get_Key_Pad()->Reset_Stats();
+    } else {
+      Serial.println("ERROR: Unsupported command!");
+    }
+
   } else if (command == "RESTART") {
     ESP.restart();
   }
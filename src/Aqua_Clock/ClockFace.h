@@ -0,0 +1,170 @@
+/*
+ * Clock Face class for the Aqua Clock
+ *
+ * Draws the large time of the idle screen and the state symbols of the water columns from the glyph atlas.
+ * The numerals are anti-aliased and kept in their own palette canvas, a digit is only copied into it from
+ * the atlas when it changes, which is once a minute for the minutes and hardly ever for the rest.  Each
+ * frame copies the finished face into the UI canvas a line at a time, so the tile flusher only finds the
+ * changed digits to send.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef CLOCK_FACE_H
+#define CLOCK_FACE_H
+
+#include <Arduino.h>
+
+#include "ColumnManager.h"
+#include "GlyphAtlas.h"
+#include "PaletteCanvas.h"
+#include "Stats.h"
+
+
+class ClockFace {
+public:
+
+  // Column state symbols, in the order of ATLAS_STATE_ICONS
+  typedef enum {
+    STATE_ICON_SETTLED,
+    STATE_ICON_FILL,
+    STATE_ICON_DRAIN,
+    STATE_ICON_SETTLING,
+    STATE_ICON_ERROR,
+    STATE_ICON_COUNT
+  } STATE_ICON_T;
+
+  static constexpr uint8_t TIME_CELLS = 5;  // HH:MM
+  static constexpr int16_t TIME_WIDTH = 4 * ATLAS_NUMERAL_WIDTH + ATLAS_COLON_WIDTH;
+  static constexpr int16_t TIME_HEIGHT = ATLAS_NUMERAL_HEIGHT;
+  static constexpr int16_t ICON_SIZE = ATLAS_STATE_ICON_SIZE;
+
+  // State symbol colors, default palette colors
+  static constexpr uint16_t COLOR_BACKGROUND = 0x0000;  // Black
+  static constexpr uint16_t COLOR_SETTLED = 0x07FF;     // Cyan
+  static constexpr uint16_t COLOR_FILL = 0x07E0;        // Green
+  static constexpr uint16_t COLOR_DRAIN = 0xF800;       // Red
+  static constexpr uint16_t COLOR_SETTLING = 0xFFE0;    // Yellow
+  static constexpr uint16_t COLOR_MANUAL = 0xF81F;      // Magenta
+  static constexpr uint16_t COLOR_ERROR = 0xF800;       // Red
+
+  static_assert(STATE_ICON_COUNT == ATLAS_STATE_ICON_COUNT, "ClockFace state icons do not match the glyph atlas");
+
+private:
+
+  // Numerals drawn into the face, a space for a blank leading hour digit and 0 before the first draw
+  PaletteCanvas *_face;
+  char _shown[TIME_CELLS];
+
+  RunningStats _cells_drawn_stats;
+  RunningStats _draw_usec_stats;
+
+public:
+
+  ClockFace() {
+    _face = new PaletteCanvas(TIME_WIDTH, TIME_HEIGHT);
+    for (uint8_t i = 0; i < TIME_CELLS; i++) {
+      _shown[i] = 0;
+    }
+  }
+
+
+  //
+  // Bring the numerals up to a 24 hour time and copy them into the canvas with the upper left corner at x, y.
+  //
+  void Draw_Time(PaletteCanvas *canvas, int16_t x, int16_t y, uint8_t hour, uint8_t minute) {
+    uint32_t start_usec = micros();
+    char text[TIME_CELLS] = { (char)('0' + hour / 10), (char)('0' + hour % 10), ':', (char)('0' + minute / 10),
+                              (char)('0' + minute % 10) };
+    if (hour < 10) {
+      text[0] = ' ';
+    }
+
+    uint8_t drawn = 0;
+    int16_t cell_x = 0;
+    for (uint8_t i = 0; i < TIME_CELLS; i++) {
+      int16_t cell_width = (text[i] == ':') ? ATLAS_COLON_WIDTH : ATLAS_NUMERAL_WIDTH;
+      if (text[i] != _shown[i]) {
+        draw_cell(cell_x, cell_width, text[i]);
+        _shown[i] = text[i];
+        drawn++;
+      }
+      cell_x += cell_width;
+    }
+
+    canvas->Blit_Canvas(x, y, _face, 0, 0, TIME_WIDTH, TIME_HEIGHT);
+
+    _cells_drawn_stats.Add(drawn);
+    _draw_usec_stats.Add(micros() - start_usec);
+  }
+
+
+  //
+  // Draw the state symbol of a column with its upper left corner at x, y.
+  //
+  void Draw_Column_State(PaletteCanvas *canvas, int16_t x, int16_t y, ColumnManager::COLUMN_STATE_TYPE_T state) {
+    STATE_ICON_T icon = STATE_ICON_SETTLED;
+    uint16_t color = COLOR_SETTLED;
+    switch (state) {
+      case ColumnManager::COLUMN_FILL_ACTIVE:
+        icon = STATE_ICON_FILL;
+        color = COLOR_FILL;
+        break;
+      case ColumnManager::COLUMN_DRAIN_ACTIVE:
+        icon = STATE_ICON_DRAIN;
+        color = COLOR_DRAIN;
+        break;
+      case ColumnManager::COLUMN_FILL_SETTLE:
+      case ColumnManager::COLUMN_DRAIN_SETTLE:
+        icon = STATE_ICON_SETTLING;
+        color = COLOR_SETTLING;
+        break;
+      case ColumnManager::COLUMN_MANUAL_FILL:
+        icon = STATE_ICON_FILL;
+        color = COLOR_MANUAL;
+        break;
+      case ColumnManager::COLUMN_MANUAL_DRAIN:
+        icon = STATE_ICON_DRAIN;
+        color = COLOR_MANUAL;
+        break;
+      case ColumnManager::COLUMN_ERROR_STATE:
+        icon = STATE_ICON_ERROR;
+        color = COLOR_ERROR;
+        break;
+      default:
+        break;
+    }
+    canvas->Blit_Shades(x, y, ICON_SIZE, ICON_SIZE, ATLAS_STATE_ICONS[icon], color, COLOR_BACKGROUND);
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Face numerals drawn per frame: ");
+    _cells_drawn_stats.Print("");
+    Serial.println();
+    Serial.print("   Face usec per frame: ");
+    _draw_usec_stats.Print("");
+    Serial.println();
+  }
+
+
+  void Reset_Stats() {
+    _cells_drawn_stats.Reset();
+    _draw_usec_stats.Reset();
+  }
+
+
+protected:
+
+  void draw_cell(int16_t x, int16_t w, char c) {
+    if (c == ':') {
+      _face->Blit_Smooth(x, 0, w, TIME_HEIGHT, ATLAS_NUMERAL_COLON);
+    } else if ((c >= '0') && (c <= '9')) {
+      _face->Blit_Smooth(x, 0, w, TIME_HEIGHT, ATLAS_NUMERALS[c - '0']);
+    } else {
+      _face->fillRect(x, 0, w, TIME_HEIGHT, COLOR_BACKGROUND);
+    }
+  }
+};
+
+#endif
@@ -4,6 +4,13 @@
  * Manages the reading and setting of time for use by the rest of the system.
  * An I2C based offboard RV-8803 board from Sparkfun is used for battery backed RTC.
  * It also supports reporting if the clock is in a "sleep" windows.
+ * Changes of the second, minute, hour and sleep window are published to subscribers so the rest of the
+ * system only does time based work when the time actually changed.  The edge of each change is time
+ * stamped from the RTC hundredths so a rollover is placed to within 10 msec even though the RTC is polled.
+ * The RTC keeps UTC.  The time reported to the rest of the system is local time, converted with the
+ * compile time daylight saving tables of TimeZone.h, so the clock follows the daylight saving changes.
+ * Every time correction is handed to the RtcDriftTracker, which learns the crystal error and trims the
+ * RV-8803 calibration offset.
  *
  * @author Joe Mohos
  * Contact: jmohos@yahoo.com
@@ -17,11 +24,26 @@
 #include <SparkFun_RV8803.h>  //Get the library here:http://librarymanager/All#SparkFun_RV-8803
 
 #include "faults.h"
+#include "RtcDrift.h"
+#include "TimeZone.h"
 
 
 class ClockManager {
 public:
 
+  // Clock change events, combined as a bit mask when several change on the same read
+  typedef enum {
+    CLOCK_EVENT_SECOND = 0x01,
+    CLOCK_EVENT_MINUTE = 0x02,
+    CLOCK_EVENT_HOUR = 0x04,
+    CLOCK_EVENT_SLEEP_ENTER = 0x08,
+    CLOCK_EVENT_SLEEP_EXIT = 0x10,
+    CLOCK_EVENT_ALL = 0x1F
+  } CLOCK_EVENT_T;
+
+  // Define the callback format.  Called with the mask of the subscribed events that occurred.
+  typedef void (*ClockEventCallbackFunct)(uint8_t events, void *context);
+
 private:
   typedef enum {
     CLOCK_MANAGER_UNINITIALIZED,
@@ -33,14 +55,19 @@ private:
   CLOCK_MANAGER_STATE_T _clock_manager_state = CLOCK_MANAGER_UNINITIALIZED;
 
   static constexpr int RTC_UPDATE_PERIOD_MSEC = 1000;  // 1Hz
+  static constexpr int RTC_ROLLOVER_GUARD_MSEC = 5;
 
   RV8803 _rtc_offboard;  // Offboard RV8803 RTC handle
+  RtcDriftTracker _drift;
 
   elapsedMillis _time_since_last_update = RTC_UPDATE_PERIOD_MSEC + 1;
+  uint32_t _update_period_msec = RTC_UPDATE_PERIOD_MSEC;
 
   bool _online = false;
 
-  // Retrieved parameters from external RTC
+  // Local time derived from the UTC held by the external RTC
+  uint32_t _utc_epoch = 0;
+  int16_t _utc_offset_min = 0;
   uint8_t _rtc_seconds;
   uint8_t _rtc_minutes;
   uint8_t _rtc_hours;
@@ -59,6 +86,22 @@ private:
 
   bool _in_sleep = false;
 
+  // Event subscribers
+  static constexpr uint8_t MAX_CLOCK_SUBSCRIBERS = 6;
+  typedef struct {
+    ClockEventCallbackFunct callback;
+    void *context;
+    uint8_t event_mask;
+  } CLOCK_SUBSCRIBER_T;
+  CLOCK_SUBSCRIBER_T _subscribers[MAX_CLOCK_SUBSCRIBERS];
+  uint8_t _num_subscribers = 0;
+  bool _time_valid = false;
+  bool _force_events = false;
+  static constexpr uint8_t NUM_CLOCK_EVENTS = 5;
+  uint32_t _event_msec[NUM_CLOCK_EVENTS] = { 0, 0, 0, 0, 0 };
+  uint32_t _event_count = 0;
+  uint32_t _callback_count = 0;
+
 
 public:
   /* Constructor */
@@ -84,10 +127,14 @@ public:
     }
 
     // Operate the RTC in 24 hour mode, use GMT/UTC (no time zone offset).
+    // The local time zone is applied by TimeZone.h.
     _rtc_offboard.set24Hour();
     _rtc_offboard.setTimeZoneQuarterHours(0);
     Serial.println("RV-8803 offboard RTC online!");
 
+    // Restore the learned drift and calibration offset
+    _drift.Startup(&_rtc_offboard);
+
     // Initialization done, ready for use
     _clock_manager_state = CLOCK_MANAGER_WORKING;
     return true;
@@ -98,7 +145,7 @@ public:
   // Master Loop
   //
   void Update() {
-    if (_time_since_last_update >= RTC_UPDATE_PERIOD_MSEC) {
+    if (_time_since_last_update >= _update_period_msec) {
       _time_since_last_update = 0;
 
       if (_clock_manager_state == CLOCK_MANAGER_WORKING) {
@@ -107,23 +154,109 @@ public:
           Serial.println("ERROR: Failed to read offboard RTC time!");
           _clock_manager_state = CLOCK_MANAGER_TIMEOUT;
         } else {
-          // Capture the fresh RTC readings
-          _rtc_seconds = _rtc_offboard.getSeconds();
-          _rtc_minutes = _rtc_offboard.getMinutes();
-          _rtc_hours = _rtc_offboard.getHours();
-          _rtc_date = _rtc_offboard.getDate();
-          _rtc_weekday = _rtc_offboard.getWeekday();
-          _rtc_month = _rtc_offboard.getMonth();
-          _rtc_year = _rtc_offboard.getYear();
+          uint8_t prior_seconds = _rtc_seconds;
+          uint8_t prior_minutes = _rtc_minutes;
+          uint8_t prior_hours = _rtc_hours;
+          bool prior_sleep = _in_sleep;
+
+          // Capture the fresh RTC readings and shift them to local time
+          _utc_epoch = rtc_utc_epoch();
+          _utc_offset_min = tz_offset_minutes(_utc_epoch);
+          TIME_FIELDS_T local = tz_fields_from_epoch(_utc_epoch + (int32_t)_utc_offset_min * 60);
+          _rtc_seconds = local.second;
+          _rtc_minutes = local.minute;
+          _rtc_hours = local.hour;
+          _rtc_date = local.date;
+          _rtc_weekday = local.weekday;
+          _rtc_month = local.month;
+          _rtc_year = local.year;
 
           // Determine if we are in a sleep window or not
           _in_sleep = detect_sleep_window();
+
+          // Back date the edge to the RTC second boundary
+          uint32_t edge_msec = millis() - (uint32_t)_rtc_offboard.getHundredths() * 10;
+
+          uint8_t events = 0;
+          if (!_time_valid || _force_events) {
+            // First reading or the time was set, every subscriber needs to resync
+            events = CLOCK_EVENT_SECOND | CLOCK_EVENT_MINUTE | CLOCK_EVENT_HOUR
+                     | (_in_sleep ? CLOCK_EVENT_SLEEP_ENTER : CLOCK_EVENT_SLEEP_EXIT);
+            _time_valid = true;
+            _force_events = false;
+          } else {
+            if (_rtc_seconds != prior_seconds) {
+              events |= CLOCK_EVENT_SECOND;
+            }
+            if (_rtc_minutes != prior_minutes) {
+              events |= CLOCK_EVENT_MINUTE;
+            }
+            if (_rtc_hours != prior_hours) {
+              events |= CLOCK_EVENT_HOUR;
+            }
+            if (_in_sleep != prior_sleep) {
+              events |= _in_sleep ? CLOCK_EVENT_SLEEP_ENTER : CLOCK_EVENT_SLEEP_EXIT;
+            }
+          }
+          publish_events(events, edge_msec);
+
+          // Poll again right after the coming minute rollover instead of up to a second late
+          if (_rtc_seconds == 59) {
+            _update_period_msec = (100 - _rtc_offboard.getHundredths()) * 10 + RTC_ROLLOVER_GUARD_MSEC;
+          } else {
+            _update_period_msec = RTC_UPDATE_PERIOD_MSEC;
+          }
         }
       }
     }
   }
 
 
+  //
+  // Register a callback for a mask of CLOCK_EVENT_T events.  The context is handed back on every call.
+  // Returns false if the subscriber table is full.
+  //
+  bool Subscribe(ClockEventCallbackFunct callback, uint8_t event_mask, void *context) {
+    if ((callback == NULL) || (_num_subscribers >= MAX_CLOCK_SUBSCRIBERS)) {
+      return false;
+    }
+    _subscribers[_num_subscribers].callback = callback;
+    _subscribers[_num_subscribers].context = context;
+    _subscribers[_num_subscribers].event_mask = event_mask;
+    _num_subscribers++;
+
+    if (_time_valid) {
+      // Late subscribers get the current state right away
+      _force_events = true;
+      _time_since_last_update = _update_period_msec;
+    }
+    return true;
+  }
+
+
+  //
+  // millis() at the edge of the last occurrence of an event.
+  //
+  uint32_t Get_Event_MSEC(CLOCK_EVENT_T event) {
+    for (uint8_t i = 0; i < NUM_CLOCK_EVENTS; i++) {
+      if (event == (1 << i)) {
+        return _event_msec[i];
+      }
+    }
+    return 0;
+  }
+
+
+  uint32_t Get_Event_Count() {
+    return _event_count;
+  }
+
+
+  uint32_t Get_Callback_Count() {
+    return _callback_count;
+  }
+
+
   bool Is_Working() {
     return (_clock_manager_state == CLOCK_MANAGER_WORKING);
   }
@@ -170,48 +303,49 @@ public:
   }
 
 
+  RtcDriftTracker *Get_Drift_Tracker() {
+    return &_drift;
+  }
+
+
+  uint32_t Get_UTC_Epoch() {
+    return _utc_epoch;
+  }
+
+
+  // Local minus UTC, including daylight saving
+  int16_t Get_UTC_Offset_Minutes() {
+    return _utc_offset_min;
+  }
+
+
+  bool Is_DST() {
+    return _utc_offset_min != LOCAL_TIME_ZONE.std_offset_min;
+  }
+
+
+  const char *Get_Time_Zone_Name() {
+    return LOCAL_TIME_ZONE.name;
+  }
+
+
   //
-  // Set time and date using discrete values for all time fields.
+  // Set time and date using discrete values for all local time fields.  The weekday is derived from the date.
+  // A correction is measured against the RTC for drift, set measure false when the time was not
+  // taken from a reference clock, such as when only the date was edited.
   //
-  bool Set_Time(uint8_t sec, uint8_t min, uint8_t hour, uint8_t weekday, uint8_t date, uint8_t month, uint16_t year) {
-    if (_clock_manager_state == CLOCK_MANAGER_WORKING) {
-      if (_rtc_offboard.setTime(sec, min, hour, weekday, date, month, year) == false) {
-        // Failed to set time.
-        FAULT_SET(FAULT_RV8803_RTC_SET_TIME_FAULT);
-        _clock_manager_state = CLOCK_MANAGER_TIMEOUT;
-        Serial.println("ERROR: Failed to set RTC time!");
-        return false;
-      } else {
-        // Time set successfully
-        return true;
-      }
-    } else {
-      // Clock manager is offline
-      return false;
-    }
+  bool Set_Time(uint8_t sec, uint8_t min, uint8_t hour, uint8_t weekday, uint8_t date, uint8_t month, uint16_t year, bool measure = true) {
+    TIME_FIELDS_T local = { year, month, date, weekday, hour, min, sec };
+    return write_utc_epoch(tz_local_to_utc(tz_epoch_from_fields(local)), measure);
   }
 
 
   //
-  // Set all time values with a single epoch number.  Seconds since Jan 1, 1970.
-  // Must adjust for local time zone.
+  // Set all time values with a single UTC epoch number.  Seconds since Jan 1, 1970.
+  // Set measure false when the epoch is not accurate enough to measure the drift against.
   //
-  bool Set_Time_Epoch(unsigned long epoch) {
-    if (_clock_manager_state == CLOCK_MANAGER_WORKING) {
-      if (_rtc_offboard.setEpoch(epoch, false, 0) == false) {
-        // Failed to set time
-        FAULT_SET(FAULT_RV8803_RTC_SET_TIME_FAULT);
-        _clock_manager_state = CLOCK_MANAGER_TIMEOUT;
-        Serial.println("ERROR: Failed to set RTC time Epoch!");
-        return false;
-      } else {
-        // Time set successfully
-        return true;
-      }
-    } else {
-      // Clock manager is offline
-      return false;
-    }
+  bool Set_Time_Epoch(unsigned long epoch, bool measure = true) {
+    return write_utc_epoch(epoch, measure);
   }
 
 
@@ -222,6 +356,7 @@ public:
 
   void Set_Wake_Hour(uint8_t hour) {
     _wake_hour = hour;
+    recheck_sleep_window();
   }
 
 
@@ -232,6 +367,7 @@ public:
 
   void Set_Wake_Min(uint8_t min) {
     _wake_min = min;
+    recheck_sleep_window();
   }
 
 
@@ -242,6 +378,7 @@ public:
 
   void Set_Sleep_Hour(uint8_t hour) {
     _sleep_hour = hour;
+    recheck_sleep_window();
   }
 
 
@@ -252,12 +389,12 @@ public:
 
   void Set_Sleep_Min(uint8_t min) {
     _sleep_min = min;
+    recheck_sleep_window();
   }
 
-protected:
 
   //
-  // Detect if the current time is between the sleep and wake window.
+  // Detect if a time of day is between the sleep and wake window.  Used to forecast the clock behavior.
   // We must cover the wrap around condition.  All times are expressed in 24hr.
   // Example: wake at 07:00, sleep at 17:00
   //          At 06:59 sleep = true
@@ -267,12 +404,12 @@ protected:
   //          At 23:59 sleep = true
   //          At 00:00 sleep = true
   //
-  bool detect_sleep_window() {
+  bool Is_Sleep_Time_At(uint8_t hour, uint8_t minute, uint8_t second) {
     bool in_wake_window = false;
 
     // Create a unified representation for current time and the sleep/wake time in seconds
     // so we can compare them quickly.
-    uint32_t time_seconds = _rtc_hours * 3600 + _rtc_minutes * 60 + _rtc_seconds;
+    uint32_t time_seconds = hour * 3600 + minute * 60 + second;
     uint32_t wake_seconds = _wake_hour * 3600 + _wake_min * 60;
     uint32_t sleep_seconds = _sleep_hour * 3600 + _sleep_min * 60;
 
@@ -291,6 +428,124 @@ protected:
     // Return if we should be sleeping
     return (!in_wake_window);
   }
+
+
+protected:
+
+  //
+  // Detect if the current time is between the sleep and wake window.
+  //
+  bool detect_sleep_window() {
+    return Is_Sleep_Time_At(_rtc_hours, _rtc_minutes, _rtc_seconds);
+  }
+
+
+  //
+  // Fresh RTC reading as epoch seconds and hundredths.
+  //
+  bool read_rtc_epoch(uint32_t &epoch, uint8_t &hundredths) {
+    if (_rtc_offboard.updateTime() == false) {
+      return false;
+    }
+    epoch = rtc_utc_epoch();
+    hundredths = _rtc_offboard.getHundredths();
+    return true;
+  }
+
+
+  //
+  // UTC epoch of the last RTC read.
+  //
+  uint32_t rtc_utc_epoch() {
+    TIME_FIELDS_T utc = { _rtc_offboard.getYear(), _rtc_offboard.getMonth(), _rtc_offboard.getDate(),
+                          _rtc_offboard.getWeekday(), _rtc_offboard.getHours(), _rtc_offboard.getMinutes(),
+                          _rtc_offboard.getSeconds() };
+    return tz_epoch_from_fields(utc);
+  }
+
+
+  //
+  // Write a UTC time to the RTC.
+  //
+  bool write_utc_epoch(uint32_t epoch, bool measure) {
+    if (_clock_manager_state == CLOCK_MANAGER_WORKING) {
+      uint32_t rtc_epoch;
+      uint8_t rtc_hundredths;
+      bool before_valid = read_rtc_epoch(rtc_epoch, rtc_hundredths);
+      TIME_FIELDS_T utc = tz_fields_from_epoch(epoch);
+      if (_rtc_offboard.setTime(utc.second, utc.minute, utc.hour, utc.weekday, utc.date, utc.month, utc.year) == false) {
+        // Failed to set time.
+        FAULT_SET(FAULT_RV8803_RTC_SET_TIME_FAULT);
+        _clock_manager_state = CLOCK_MANAGER_TIMEOUT;
+        Serial.println("ERROR: Failed to set RTC time!");
+        return false;
+      } else {
+        // Time set successfully, resync the subscribers on the next read
+        _force_events = true;
+        _time_since_last_update = _update_period_msec;
+        record_correction(before_valid && measure, rtc_epoch, rtc_hundredths);
+        return true;
+      }
+    } else {
+      // Clock manager is offline
+      return false;
+    }
+  }
+
+
+  //
+  // Hand a completed time set to the drift tracker.  Writing the time restarts the RTC hundredths.
+  //
+  void record_correction(bool measure, uint32_t rtc_epoch, uint8_t rtc_hundredths) {
+    uint32_t true_epoch;
+    uint8_t true_hundredths;
+    if (!read_rtc_epoch(true_epoch, true_hundredths)) {
+      return;
+    }
+    if (measure) {
+      _drift.Record_Correction(rtc_epoch, rtc_hundredths, true_epoch, true_hundredths);
+    } else {
+      _drift.Restart_Reference(true_epoch);
+    }
+  }
+
+
+  //
+  // The sleep window moved, publish an entry or exit right away instead of on the next read.
+  //
+  void recheck_sleep_window() {
+    if (!_time_valid) {
+      return;
+    }
+    bool in_sleep = detect_sleep_window();
+    if (in_sleep != _in_sleep) {
+      _in_sleep = in_sleep;
+      publish_events(in_sleep ? CLOCK_EVENT_SLEEP_ENTER : CLOCK_EVENT_SLEEP_EXIT, millis());
+    }
+  }
+
+
+  //
+  // Stamp the events and call every subscriber interested in at least one of them.
+  //
+  void publish_events(uint8_t events, uint32_t edge_msec) {
+    if (events == 0) {
+      return;
+    }
+    for (uint8_t i = 0; i < NUM_CLOCK_EVENTS; i++) {
+      if (events & (1 << i)) {
+        _event_msec[i] = edge_msec;
+        _event_count++;
+      }
+    }
+    for (uint8_t i = 0; i < _num_subscribers; i++) {
+      uint8_t matched = events & _subscribers[i].event_mask;
+      if (matched) {
+        _callback_count++;
+        _subscribers[i].callback(matched, _subscribers[i].context);
+      }
+    }
+  }
 };
 
 #endif
@@ -0,0 +1,125 @@
+/*
+ * Aqua Clock column configuration
+ *
+ * Describes every water column of the clock in a single table.  Each entry captures the I2C mux port of
+ * the column range sensor, the IO expander feed and drain valve pins, which digit of the time the column
+ * shows and the calibration tables for the column.
+ * The main loop, console and UI iterate over this table so adding a column (seconds, 24 hour, etc.)
+ * only needs a new table entry plus its calibration arrays in calibration.h.
+ * The table is checked at compile time for sane mux ports, pins and digit tables.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef COLUMN_CONFIG_H
+#define COLUMN_CONFIG_H
+
+#include <Arduino.h>
+
+#include "calibration.h"
+#include "io_expander_config.h"
+
+
+// Which digit of the time a column displays
+typedef enum {
+  DIGIT_HOUR_12,    /* 1-12 */
+  DIGIT_HOUR_24,    /* 0-23 */
+  DIGIT_MINUTE_10S, /* 0-5 */
+  DIGIT_MINUTE_1S,  /* 0-9 */
+  DIGIT_SECOND_10S, /* 0-5 */
+  DIGIT_SECOND_1S   /* 0-9 */
+} DIGIT_MAPPING_T;
+
+
+typedef struct {
+  const char *name;
+  uint8_t mux_port;
+  uint8_t feed_pin;
+  uint8_t drain_pin;
+  DIGIT_MAPPING_T digit;
+  const uint16_t *digit_elevations;
+  uint8_t num_digit_steps;
+  double *range_cal_x_values;
+  double *range_cal_y_values;
+} COLUMN_DESCRIPTOR_T;
+
+
+// Master column table, left to right on the clock face
+constexpr COLUMN_DESCRIPTOR_T COLUMN_TABLE[] = {
+  // name       mux  feed pin                  drain pin                  digit             digit elevations              steps              range cal x                 range cal y
+  { "Hour",     0,   SC1509_PIN_HOUR_FEED,     SC1509_PIN_HOUR_DRAIN,     DIGIT_HOUR_12,    hour_col_digit_elevations,    NUM_HOUR_STEPS,    hour_range_cal_x_values,    hour_range_cal_y_values },
+  { "Min 10s",  1,   SC1509_PIN_MIN_10s_FEED,  SC1509_PIN_MIN_10s_DRAIN,  DIGIT_MINUTE_10S, min_10s_col_digit_elevations, NUM_MIN_10S_STEPS, min_10s_range_cal_x_values, min_10s_range_cal_y_values },
+  { "Min 1s",   2,   SC1509_PIN_MIN_1s_FEED,   SC1509_PIN_MIN_1s_DRAIN,   DIGIT_MINUTE_1S,  min_1s_col_digit_elevations,  NUM_MIN_1S_STEPS,  min_1s_range_cal_x_values,  min_1s_range_cal_y_values },
+};
+
+constexpr uint8_t NUM_COLUMNS = sizeof(COLUMN_TABLE) / sizeof(COLUMN_TABLE[0]);
+
+// Column elevation limits and the parking elevation used while sleeping
+const uint16_t MIN_WATER_COLUMN_ELEVATION = 50;
+const uint16_t MAX_WATER_COLUMN_ELEVATION = 305;
+const uint16_t SLEEP_WATER_COLUMN_ELEVATION = 300;
+
+
+// Number of distinct values a digit mapping can show
+constexpr uint8_t digit_count(DIGIT_MAPPING_T digit) {
+  return (digit == DIGIT_HOUR_12) ? 12 : (digit == DIGIT_HOUR_24) ? 24 : ((digit == DIGIT_MINUTE_10S) || (digit == DIGIT_SECOND_10S)) ? 6 : 10;
+}
+
+
+// Compile time checks of every table entry
+constexpr bool column_table_valid(uint8_t i) {
+  return (i >= NUM_COLUMNS)
+         || ((COLUMN_TABLE[i].mux_port < 8)
+             && (COLUMN_TABLE[i].feed_pin >= 8) && (COLUMN_TABLE[i].feed_pin < 16)
+             && (COLUMN_TABLE[i].drain_pin >= 8) && (COLUMN_TABLE[i].drain_pin < 16)
+             && (COLUMN_TABLE[i].feed_pin != COLUMN_TABLE[i].drain_pin)
+             && (COLUMN_TABLE[i].num_digit_steps == digit_count(COLUMN_TABLE[i].digit))
+             && column_table_valid(i + 1));
+}
+static_assert(NUM_COLUMNS > 0, "At least one column must be configured");
+static_assert(column_table_valid(0), "COLUMN_TABLE has an invalid mux port, valve pin or digit table size");
+
+// True if any column shows a seconds digit.  Those setpoints change every second instead of every minute.
+constexpr bool column_table_uses_seconds(uint8_t i) {
+  return (i >= NUM_COLUMNS) ? false
+                            : ((COLUMN_TABLE[i].digit == DIGIT_SECOND_10S) || (COLUMN_TABLE[i].digit == DIGIT_SECOND_1S)
+                               || column_table_uses_seconds(i + 1));
+}
+
+
+//
+// Index into a column digit elevation table for a time of day.  Hour is in 24 hour format.
+//
+inline uint8_t column_digit_index(DIGIT_MAPPING_T digit, uint8_t hour, uint8_t minute, uint8_t second) {
+  switch (digit) {
+    case DIGIT_HOUR_12:
+      // 1-12 o'clock use entries 0-11, midnight and noon show 12
+      return ((hour % 12) == 0) ? 11 : ((hour % 12) - 1);
+    case DIGIT_HOUR_24:
+      return hour % 24;
+    case DIGIT_MINUTE_10S:
+      return (minute % 60) / 10;
+    case DIGIT_MINUTE_1S:
+      return minute % 10;
+    case DIGIT_SECOND_10S:
+      return (second % 60) / 10;
+    case DIGIT_SECOND_1S:
+    default:
+      return second % 10;
+  }
+}
+
+
+//
+// Scale a time of day to the target elevation of a column.
+//
+inline uint16_t scale_time_to_elevation(const COLUMN_DESCRIPTOR_T &column, uint8_t hour, uint8_t minute, uint8_t second) {
+  uint8_t index = column_digit_index(column.digit, hour, minute, second);
+  if (index < column.num_digit_steps) {
+    return column.digit_elevations[index];
+  }
+  // Invalid time, set to safe value
+  return 150;
+}
+
+#endif
@@ -7,6 +7,12 @@
  * There is support for manual valve actuation used for filling, draining or calbrating the column.
  * Built in diagnostics monitor the regulation to look for unusual situations.  If a fault condition is
  * detected the column regulator is disabled and a fault is registered with the system.
+ * The level change is checked against the expected flow every half second while the valves are open and
+ * while they are closed.  This catches a stuck or clogged valve (no flow), a swapped feed and drain valve
+ * (reverse flow) and a valve that fails to close (runaway) within a couple of seconds.
+ * The deadband adapts to each column.  It is sized from a running estimate of the sensor noise while
+ * the column rests and from the coast (travel after the valves close) of recent moves, within limits.
+ * A settle ends as soon as the level stops moving for a few samples.  The dwell period is only an upper bound.
  *
  * @author Joe Mohos
  * Contact: jmohos@yahoo.com
@@ -17,7 +23,9 @@
 #include <Arduino.h>
 #include <elapsedMillis.h>
 
+#include "faults.h"
 #include "io_expander_config.h"
+#include "Stats.h"
 
 
 class ColumnManager {
@@ -39,6 +47,13 @@ public:
     CONTROL_ERROR_NEGATIVE
   } CONTROL_ERROR_STATE_TYPE_T;
 
+  typedef enum {
+    FLOW_DIAG_OK,
+    FLOW_DIAG_NO_FLOW,
+    FLOW_DIAG_REVERSE_FLOW,
+    FLOW_DIAG_RUNAWAY
+  } FLOW_DIAGNOSTIC_T;
+
 
 private:
   // IO Expander and pins to actuate
@@ -58,6 +73,50 @@ private:
   uint16_t _elevation_mm = 150;
   uint16_t _setpoint_deadband = 4; /* At setpoint if within +/- this value */
 
+  // Adaptive deadband sizing.  Noise is the average absolute change between resting samples and
+  // coast is the average travel after the valves close.  Both are exponentially weighted averages.
+  static constexpr uint32_t COLUMN_SAMPLE_PERIOD_MSEC = 100;
+  static constexpr float DEADBAND_NOISE_GAIN = 3.0;
+  static constexpr float DEADBAND_COAST_GAIN = 0.5;
+  static constexpr float DEADBAND_MARGIN_MM = 1.0;
+  static constexpr float NOISE_FILTER_WEIGHT = 0.02;
+  static constexpr float COAST_FILTER_WEIGHT = 0.2;
+  uint16_t _deadband_min = 2;
+  uint16_t _deadband_max = 10;
+  bool _adaptive_deadband_enable = true;
+  elapsedMillis _sample_elapsed;
+  uint16_t _prior_sample_mm = 0;
+  bool _prior_sample_valid = false;
+  float _noise_mm = 0.5;
+  float _coast_mm = 2.0;
+  uint16_t _settle_start_elevation = 150;
+
+  // Settle detection.  The level is still when its spread over the last few samples is below the
+  // velocity threshold plus an allowance for the sensor noise.
+  static constexpr uint8_t SETTLE_STILL_SAMPLES = 3;
+  static constexpr float SETTLE_VELOCITY_MM_PER_SEC = 5.0;
+  static constexpr float SETTLE_NOISE_GAIN = 2.0;
+  static constexpr uint32_t SETTLE_MIN_MSEC = 200;
+  static constexpr uint32_t SETTLE_HISTOGRAM_BIN_MSEC = 100;
+  uint16_t _settle_samples[SETTLE_STILL_SAMPLES];
+  uint8_t _settle_sample_count = 0;
+  bool _settle_still = false;
+  Histogram _settle_histogram = Histogram(SETTLE_HISTOGRAM_BIN_MSEC);
+  RunningStats _settle_stats;
+
+  // Correction cycle statistics
+  int8_t _last_move_direction = 0; /* -1 fill, +1 drain */
+  uint16_t _last_move_setpoint = 0;
+  uint32_t _fill_cycles = 0;
+  uint32_t _drain_cycles = 0;
+  uint32_t _hunting_cycles = 0; /* Move reversed without a setpoint change */
+
+  // Water drawn from the feed tank, measured as the level rise while the feed valve is open or coasting
+  bool _feed_valve_open = false;
+  float _total_fill_mm = 0;
+  uint16_t _fill_sample_mm = 0;
+  bool _fill_sample_valid = false;
+
   // Enables for operations
   bool _regulator_enable = false;
   bool _logging_enable = false;
@@ -76,9 +135,38 @@ private:
   bool _request_manual_fill = false;
   bool _request_manual_drain = false;
 
+  // Permission from the move planner to begin a new regulated fill or drain
+  bool _move_permit = true;
+
   // Result of controller comparison of setpoint and process variable
   CONTROL_ERROR_STATE_TYPE_T _control_error_state = CONTROL_ERROR_DEADBAND;
 
+  // Flow rate monitoring.  Level changes are measured over fixed windows and compared with the
+  // flow expected from the valve positions.  A fault needs several bad windows in a row.
+  typedef enum {
+    FLOW_PHASE_FILLING,
+    FLOW_PHASE_DRAINING,
+    FLOW_PHASE_CLOSED,
+    FLOW_PHASE_UNMONITORED
+  } FLOW_PHASE_T;
+
+  static constexpr uint32_t FLOW_CHECK_WINDOW_MSEC = 500;
+  static constexpr uint32_t FLOW_START_GRACE_MSEC = 750; /* Valve opening and water inertia */
+  static constexpr uint8_t FLOW_FAULT_WINDOWS = 3;
+  int16_t _min_flow_rate_mm_per_sec = 2;   /* Slower than this with a valve open is no flow */
+  int16_t _max_flow_rate_mm_per_sec = 60;  /* Faster than this is not a plausible gravity flow */
+  int16_t _reverse_flow_mm = 3;            /* Movement per window against the flow direction */
+
+  FLOW_PHASE_T _flow_phase = FLOW_PHASE_CLOSED;
+  elapsedMillis _flow_phase_elapsed;
+  elapsedMillis _flow_window_elapsed;
+  uint16_t _flow_window_start_elevation = 150;
+  int8_t _last_flow_direction = 0; /* -1 for fill (range reading falls), +1 for drain */
+  int16_t _observed_rate_mm_per_sec = 0;
+  FLOW_DIAGNOSTIC_T _flow_suspect = FLOW_DIAG_OK;
+  uint8_t _flow_suspect_windows = 0;
+  FLOW_DIAGNOSTIC_T _flow_diagnostic = FLOW_DIAG_OK;
+
 
 public:
   /* Constructor - capture resources and parameters linked to this object */
@@ -128,6 +216,82 @@ public:
     return _elevation_upper_limit;
   }
 
+  uint16_t Get_Setpoint_Deadband() {
+    return _setpoint_deadband;
+  }
+
+  // Bound the adaptive deadband.  Setting min equal to max gives a fixed deadband.
+  void Set_Deadband_Limits(uint16_t min_mm, uint16_t max_mm) {
+    if (min_mm > max_mm) {
+      min_mm = max_mm;
+    }
+    _deadband_min = min_mm;
+    _deadband_max = max_mm;
+    _setpoint_deadband = constrain(_setpoint_deadband, _deadband_min, _deadband_max);
+  }
+
+  uint16_t Get_Deadband_Min() {
+    return _deadband_min;
+  }
+
+  uint16_t Get_Deadband_Max() {
+    return _deadband_max;
+  }
+
+  void Set_Adaptive_Deadband_Enable(bool enable) {
+    _adaptive_deadband_enable = enable;
+  }
+
+  float Get_Noise_Estimate_MM() {
+    return _noise_mm;
+  }
+
+  float Get_Coast_Estimate_MM() {
+    return _coast_mm;
+  }
+
+  uint32_t Get_Fill_Cycles() {
+    return _fill_cycles;
+  }
+
+  uint32_t Get_Drain_Cycles() {
+    return _drain_cycles;
+  }
+
+  uint32_t Get_Hunting_Cycles() {
+    return _hunting_cycles;
+  }
+
+
+  //
+  // Running total of column rise in mm fed from the feed tank since startup.
+  //
+  uint32_t Get_Total_Fill_MM() {
+    return (uint32_t)_total_fill_mm;
+  }
+
+  Histogram *Get_Settle_Histogram() {
+    return &_settle_histogram;
+  }
+
+  RunningStats *Get_Settle_Stats() {
+    return &_settle_stats;
+  }
+
+  // Signed distance to the setpoint.  Positive needs a fill, negative needs a drain.
+  int16_t Get_Control_Error_MM() {
+    return (int16_t)_elevation_mm - (int16_t)_setpoint_mm;
+  }
+
+  // Gate the start of new regulated moves.  An active move is allowed to finish.
+  void Set_Move_Permit(bool permit) {
+    _move_permit = permit;
+  }
+
+  bool Is_Move_Permitted() {
+    return _move_permit;
+  }
+
   bool Set_Elevation_Reading_MM(uint16_t elevation_mm) {
     _elevation_mm = elevation_mm;
     return false;
@@ -149,6 +313,52 @@ public:
     return false;
   }
 
+  FLOW_DIAGNOSTIC_T Get_Flow_Diagnostic() {
+    return _flow_diagnostic;
+  }
+
+  //
+  // Clear a latched flow fault once the cause has been fixed.  The column returns to idle and the
+  // flow monitor restarts from the current elevation with no flow direction.  The regulator stays
+  // disabled until it is enabled again.  Returns false when there was no flow fault.
+  //
+  bool Clear_Flow_Fault() {
+    if (_flow_diagnostic == FLOW_DIAG_OK) {
+      return false;
+    }
+    _flow_diagnostic = FLOW_DIAG_OK;
+    _flow_suspect = FLOW_DIAG_OK;
+    _flow_suspect_windows = 0;
+    _flow_phase = FLOW_PHASE_UNMONITORED;
+    _last_flow_direction = 0;
+    _observed_rate_mm_per_sec = 0;
+    if (_state == COLUMN_ERROR_STATE) {
+      _state = COLUMN_IDLE;
+      _time_in_current_state = 0;
+    }
+
+    switch (_column_num) {
+      case 1:
+        FAULT_CLEAR(FAULT_COLUMN_1_FLOW_FAIL);
+        break;
+      case 2:
+        FAULT_CLEAR(FAULT_COLUMN_2_FLOW_FAIL);
+        break;
+      case 3:
+        FAULT_CLEAR(FAULT_COLUMN_3_FLOW_FAIL);
+        break;
+      default:
+        FAULT_CLEAR(FAULT_COLUMN_UNKNOWN_FLOW_FAIL);
+        break;
+    }
+    return true;
+  }
+
+  // Signed level change rate over the last check window.  Negative is rising water.
+  int16_t Get_Observed_Rate_MM_Per_Sec() {
+    return _observed_rate_mm_per_sec;
+  }
+
   void Enable_Logging() {
     _logging_enable = true;
   }
@@ -212,12 +422,13 @@ public:
       case COLUMN_IDLE:
         stop_flows();
 
-        if (_regulator_enable) {
+        if (_regulator_enable && _move_permit) {
           // Determine how to respond to control error state if we are out of deadband
           if (_control_error_state == CONTROL_ERROR_POSITIVE) {
             // Need to fill up the column to raise the level
             _state = COLUMN_FILL_ACTIVE;
             _time_in_current_state = 0;
+            record_move_start(-1);
 
             if (_logging_enable) {
               Serial.print("COLUMN ");
@@ -228,6 +439,7 @@ public:
             // Need to drain the column to lower the level
             _state = COLUMN_DRAIN_ACTIVE;
             _time_in_current_state = 0;
+            record_move_start(1);
 
             if (_logging_enable) {
               Serial.print("COLUMN ");
@@ -242,6 +454,7 @@ public:
         if (!_regulator_enable) {
           _state = COLUMN_DRAIN_SETTLE;
           _time_in_current_state = 0;
+          _settle_start_elevation = _elevation_mm;
         } else {
 
           // Are we still in the negative error range or have we hit deadband?
@@ -249,6 +462,7 @@ public:
             stop_flows();
             _state = COLUMN_DRAIN_SETTLE;
             _time_in_current_state = 0;
+            _settle_start_elevation = _elevation_mm;
 
             if (_logging_enable) {
               Serial.print("COLUMN ");
@@ -276,9 +490,10 @@ public:
 
       case COLUMN_DRAIN_SETTLE:
         stop_flows();
-        if (_time_in_current_state >= _drain_dwell_period) {
+        if (settle_complete(_drain_dwell_period)) {
           _state = COLUMN_IDLE;
           _time_in_current_state = 0;
+          record_settle_result();
 
           if (_logging_enable) {
             Serial.print("COLUMN ");
@@ -292,6 +507,7 @@ public:
         if (!_regulator_enable) {
           _state = COLUMN_FILL_SETTLE;
           _time_in_current_state = 0;
+          _settle_start_elevation = _elevation_mm;
         } else {
 
           // Are we still in the positive error range or have we hit deadband?
@@ -299,6 +515,7 @@ public:
             stop_flows();
             _state = COLUMN_FILL_SETTLE;
             _time_in_current_state = 0;
+            _settle_start_elevation = _elevation_mm;
 
             if (_logging_enable) {
               Serial.print("COLUMN ");
@@ -326,9 +543,10 @@ public:
 
       case COLUMN_FILL_SETTLE:
         stop_flows();
-        if (_time_in_current_state >= _fill_dwell_period) {
+        if (settle_complete(_fill_dwell_period)) {
           _state = COLUMN_IDLE;
           _time_in_current_state = 0;
+          record_settle_result();
 
           if (_logging_enable) {
             Serial.print("COLUMN ");
@@ -374,10 +592,278 @@ public:
         break;
     }
 
+    // Compare the observed level change with the flow expected from the valves
+    check_flow_rate();
+
+    // Track the sensor noise and resize the deadband
+    if (_sample_elapsed >= COLUMN_SAMPLE_PERIOD_MSEC) {
+      _sample_elapsed = 0;
+      update_adaptive_deadband();
+      update_settle_detection();
+      track_fill_volume();
+    }
+
     return busy;
   }
 
 protected:
+  //
+  // Settling ends once the level is still or the dwell period runs out.  Records the settle time.
+  //
+  bool settle_complete(uint32_t max_dwell_period) {
+    uint32_t settle_time = _time_in_current_state;
+
+    if ((settle_time >= max_dwell_period) || (_settle_still && (settle_time >= SETTLE_MIN_MSEC))) {
+      _settle_histogram.Add(settle_time);
+      _settle_stats.Add(settle_time);
+      return true;
+    }
+    return false;
+  }
+
+
+  //
+  // Keep the most recent samples while settling and decide if the level has stopped moving.
+  //
+  void update_settle_detection() {
+    if ((_state != COLUMN_FILL_SETTLE) && (_state != COLUMN_DRAIN_SETTLE)) {
+      _settle_sample_count = 0;
+      _settle_still = false;
+      return;
+    }
+
+    for (uint8_t i = SETTLE_STILL_SAMPLES - 1; i > 0; i--) {
+      _settle_samples[i] = _settle_samples[i - 1];
+    }
+    _settle_samples[0] = _elevation_mm;
+    if (_settle_sample_count < SETTLE_STILL_SAMPLES) {
+      _settle_sample_count++;
+      return;
+    }
+
+    uint16_t lowest = _settle_samples[0];
+    uint16_t highest = _settle_samples[0];
+    for (uint8_t i = 1; i < SETTLE_STILL_SAMPLES; i++) {
+      lowest = min(lowest, _settle_samples[i]);
+      highest = max(highest, _settle_samples[i]);
+    }
+
+    float span_sec = (float)((SETTLE_STILL_SAMPLES - 1) * COLUMN_SAMPLE_PERIOD_MSEC) / 1000.0;
+    float allowed_mm = SETTLE_VELOCITY_MM_PER_SEC * span_sec + SETTLE_NOISE_GAIN * _noise_mm;
+    _settle_still = ((float)(highest - lowest) <= allowed_mm);
+  }
+
+
+  //
+  // Accumulate the level rise while water flows in from the feed tank.  Filling lowers the range reading.
+  //
+  void track_fill_volume() {
+    if (_feed_valve_open || (_state == COLUMN_FILL_SETTLE)) {
+      if (_fill_sample_valid && (_elevation_mm < _fill_sample_mm)) {
+        _total_fill_mm += (float)(_fill_sample_mm - _elevation_mm);
+      }
+      _fill_sample_mm = _elevation_mm;
+      _fill_sample_valid = true;
+    } else {
+      _fill_sample_valid = false;
+    }
+  }
+
+
+  //
+  // Count each regulated move and detect hunting, a reversal with no setpoint change.
+  //
+  void record_move_start(int8_t direction) {
+    if (direction < 0) {
+      _fill_cycles++;
+    } else {
+      _drain_cycles++;
+    }
+
+    if ((_last_move_direction == -direction) && (_last_move_setpoint == _setpoint_mm)) {
+      _hunting_cycles++;
+    }
+    _last_move_direction = direction;
+    _last_move_setpoint = _setpoint_mm;
+  }
+
+
+  //
+  // Measure how far the level coasted in the move direction after the valves closed.
+  //
+  void record_settle_result() {
+    int16_t coast = ((int16_t)_elevation_mm - (int16_t)_settle_start_elevation) * _last_move_direction;
+    if (coast < 0) {
+      coast = 0;
+    }
+    _coast_mm += COAST_FILTER_WEIGHT * ((float)coast - _coast_mm);
+  }
+
+
+  //
+  // Estimate the sensor noise while the column rests at its setpoint and size the deadband to
+  // stay above the noise and to absorb the typical coast so a move does not trigger a reverse move.
+  //
+  void update_adaptive_deadband() {
+    if ((_state == COLUMN_IDLE) && (_control_error_state == CONTROL_ERROR_DEADBAND)) {
+      if (_prior_sample_valid) {
+        float change = abs((int16_t)_elevation_mm - (int16_t)_prior_sample_mm);
+        _noise_mm += NOISE_FILTER_WEIGHT * (change - _noise_mm);
+      }
+      _prior_sample_mm = _elevation_mm;
+      _prior_sample_valid = true;
+    } else {
+      _prior_sample_valid = false;
+    }
+
+    if (_adaptive_deadband_enable) {
+      float deadband = DEADBAND_NOISE_GAIN * _noise_mm + DEADBAND_COAST_GAIN * _coast_mm + DEADBAND_MARGIN_MM;
+      _setpoint_deadband = constrain((uint16_t)(deadband + 0.5), _deadband_min, _deadband_max);
+    }
+  }
+
+
+  //
+  // Monitor the rate of level change against the expected flow.
+  // Filling must lower the range reading, draining must raise it and with the valves closed
+  // the level must stop moving.  Manual actuation is not monitored since it is a service action.
+  //
+  void check_flow_rate() {
+    FLOW_PHASE_T phase;
+
+    switch (_state) {
+      case COLUMN_FILL_ACTIVE:
+        phase = FLOW_PHASE_FILLING;
+        break;
+      case COLUMN_DRAIN_ACTIVE:
+        phase = FLOW_PHASE_DRAINING;
+        break;
+      case COLUMN_IDLE:
+      case COLUMN_FILL_SETTLE:
+      case COLUMN_DRAIN_SETTLE:
+        phase = FLOW_PHASE_CLOSED;
+        break;
+      default:
+        phase = FLOW_PHASE_UNMONITORED;
+        break;
+    }
+
+    // Restart the measurements on each change in valve positions
+    if (phase != _flow_phase) {
+      if (phase == FLOW_PHASE_FILLING) {
+        _last_flow_direction = -1;
+      } else if (phase == FLOW_PHASE_DRAINING) {
+        _last_flow_direction = 1;
+      } else if (_state == COLUMN_MANUAL_FILL) {
+        _last_flow_direction = -1;
+      } else if (_state == COLUMN_MANUAL_DRAIN) {
+        _last_flow_direction = 1;
+      }
+      _flow_phase = phase;
+      _flow_phase_elapsed = 0;
+      _flow_window_elapsed = 0;
+      _flow_window_start_elevation = _elevation_mm;
+      _flow_suspect = FLOW_DIAG_OK;
+      _flow_suspect_windows = 0;
+      return;
+    }
+
+    if (_flow_window_elapsed < FLOW_CHECK_WINDOW_MSEC) {
+      return;
+    }
+
+    uint32_t window_msec = _flow_window_elapsed;
+    int16_t delta = (int16_t)_elevation_mm - (int16_t)_flow_window_start_elevation;
+    _observed_rate_mm_per_sec = (int16_t)(((int32_t)delta * 1000) / (int32_t)window_msec);
+    _flow_window_elapsed = 0;
+    _flow_window_start_elevation = _elevation_mm;
+
+    // Movement and rate in the direction of the most recent flow
+    int16_t progress_mm = delta * _last_flow_direction;
+    int16_t progress_rate = _observed_rate_mm_per_sec * _last_flow_direction;
+
+    FLOW_DIAGNOSTIC_T suspect = FLOW_DIAG_OK;
+    if (_flow_phase_elapsed >= FLOW_START_GRACE_MSEC) {
+      if ((_flow_phase == FLOW_PHASE_FILLING) || (_flow_phase == FLOW_PHASE_DRAINING)) {
+        if (progress_mm < -_reverse_flow_mm) {
+          suspect = FLOW_DIAG_REVERSE_FLOW;
+        } else if (progress_rate < _min_flow_rate_mm_per_sec) {
+          suspect = FLOW_DIAG_NO_FLOW;
+        } else if (progress_rate > _max_flow_rate_mm_per_sec) {
+          suspect = FLOW_DIAG_RUNAWAY;
+        }
+      } else if (_flow_phase == FLOW_PHASE_CLOSED) {
+        // Still moving the same way after the valves closed, a valve is stuck open
+        if ((_last_flow_direction != 0) && (progress_mm > _reverse_flow_mm)) {
+          suspect = FLOW_DIAG_RUNAWAY;
+        }
+      }
+    }
+
+    if (suspect == FLOW_DIAG_OK) {
+      _flow_suspect = FLOW_DIAG_OK;
+      _flow_suspect_windows = 0;
+      return;
+    }
+
+    if (suspect == _flow_suspect) {
+      _flow_suspect_windows++;
+    } else {
+      _flow_suspect = suspect;
+      _flow_suspect_windows = 1;
+    }
+
+    if (_flow_suspect_windows >= FLOW_FAULT_WINDOWS) {
+      raise_flow_fault(suspect);
+    }
+  }
+
+
+  //
+  // Shut the column down and register a flow fault for this column.
+  //
+  void raise_flow_fault(FLOW_DIAGNOSTIC_T diagnostic) {
+    stop_flows();
+    _flow_diagnostic = diagnostic;
+    _state = COLUMN_ERROR_STATE;
+    _time_in_current_state = 0;
+
+    Serial.print("ERROR: Column ");
+    Serial.print(_column_num);
+    switch (diagnostic) {
+      case FLOW_DIAG_NO_FLOW:
+        Serial.print(" no flow");
+        break;
+      case FLOW_DIAG_REVERSE_FLOW:
+        Serial.print(" reverse flow");
+        break;
+      case FLOW_DIAG_RUNAWAY:
+        Serial.print(" runaway flow");
+        break;
+      default:
+        break;
+    }
+    Serial.print(" detected at ");
+    Serial.print(_observed_rate_mm_per_sec);
+    Serial.println(" mm/s!");
+
+    switch (_column_num) {
+      case 1:
+        FAULT_SET(FAULT_COLUMN_1_FLOW_FAIL);
+        break;
+      case 2:
+        FAULT_SET(FAULT_COLUMN_2_FLOW_FAIL);
+        break;
+      case 3:
+        FAULT_SET(FAULT_COLUMN_3_FLOW_FAIL);
+        break;
+      default:
+        FAULT_SET(FAULT_COLUMN_UNKNOWN_FLOW_FAIL);
+        break;
+    }
+  }
+
+
   //
   // Evaluate if the control loop is outside or inside the control loop deadband.
   //
@@ -406,6 +892,7 @@ protected:
     if (_drain_valve_actuator_pin >= 0) {
       _io_expander->digitalWrite(_drain_valve_actuator_pin, LOW);
     }
+    _feed_valve_open = true;
   }
 
 
@@ -421,6 +908,7 @@ protected:
         _io_expander->digitalWrite(_drain_valve_actuator_pin, HIGH);
       }
     }
+    _feed_valve_open = false;
   }
 
 
@@ -436,6 +924,7 @@ protected:
         _io_expander->digitalWrite(_drain_valve_actuator_pin, LOW);
       }
     }
+    _feed_valve_open = false;
   }
 };
 
@@ -23,6 +23,7 @@
  *     Test for someone typing HELP on the command line: "if (command.equals("HELP"))"
  *     Test if the parameter after the command is "CLOCK": "if (param1 == "CLOCK")"
  *     Convert the second parameter into an int: "uint32_t period = param2.toInt();"
+ * The millis() time the end of the last line was read is kept for time stamping exchanges such as time sync.
 
  * @author Joe Mohos
  * Contact: jmohos@yahoo.com
@@ -41,6 +42,7 @@ private:
   Stream *streamSource;  // Stream source for sensor input (Serial1, Serial2, etc)
   char consoleBuffer[CONSOLE_BUF_SIZE + 1];
   int consoleIndex = 0;
+  uint32_t lineRxMsec = 0;  // millis() when the last line terminator was read
 
   // Define the callback format
   typedef void (*ConsoleRxCallbackFunct)(String comamnd, String param1, String param2);
@@ -71,6 +73,14 @@ public:
   }
 
 
+  //
+  // Time the line being handled by the callback was received, taken as soon as its terminator was read.
+  //
+  uint32_t GetLineRxMsec() {
+    return lineRxMsec;
+  }
+
+
   //
   // Process all pending serial input parsing.  Will trigger the callback
   // if a valid line of command info is framed.
@@ -93,6 +103,7 @@ protected:
       consoleBuffer[consoleIndex++] = c;
 
       if ((c == '\n') || (c == '\r')) {
+        lineRxMsec = millis();
         consoleBuffer[consoleIndex - 1] = 0;
         if (consoleIndex > 1) {
           String command_line = String(consoleBuffer);
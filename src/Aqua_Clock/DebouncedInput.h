@@ -0,0 +1,125 @@
+/*
+ * Debounced discrete input for the Aqua Clock
+ *
+ * Time qualified filter for a noisy discrete input such as a float switch.  The raw input must hold
+ * its new state continuously for the assert time before the filtered state turns on, and for the
+ * release time before it turns off.  Separate times allow a quick reaction in one direction while
+ * ignoring sloshing in the other.
+ * Edges of the filtered state and raw input changes are counted so the chatter can be measured.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef DEBOUNCED_INPUT_H
+#define DEBOUNCED_INPUT_H
+
+#include <Arduino.h>
+#include <elapsedMillis.h>
+
+
+class DebouncedInput {
+private:
+  uint32_t _assert_msec;
+  uint32_t _release_msec;
+  bool _state = false;
+  bool _raw = false;
+  bool _seeded = false;
+  elapsedMillis _raw_stable_elapsed;
+
+  uint32_t _assert_edges = 0;
+  uint32_t _release_edges = 0;
+  uint32_t _raw_changes = 0;
+
+public:
+  DebouncedInput(uint32_t assert_msec, uint32_t release_msec) {
+    _assert_msec = assert_msec;
+    _release_msec = release_msec;
+  }
+
+
+  //
+  // Feed the latest raw reading and return the filtered state.
+  // The first reading is taken as is so the state is valid right after startup.
+  //
+  bool Update(bool raw) {
+    if (!_seeded) {
+      _seeded = true;
+      _raw = raw;
+      _state = raw;
+      _raw_stable_elapsed = 0;
+      return _state;
+    }
+
+    if (raw != _raw) {
+      _raw = raw;
+      _raw_changes++;
+      _raw_stable_elapsed = 0;
+    }
+
+    if (_raw != _state) {
+      uint32_t qualify_msec = _raw ? _assert_msec : _release_msec;
+      if (_raw_stable_elapsed >= qualify_msec) {
+        _state = _raw;
+        if (_state) {
+          _assert_edges++;
+        } else {
+          _release_edges++;
+        }
+      }
+    }
+    return _state;
+  }
+
+
+  bool Get_State() {
+    return _state;
+  }
+
+
+  bool Get_Raw_State() {
+    return _raw;
+  }
+
+
+  void Set_Times(uint32_t assert_msec, uint32_t release_msec) {
+    _assert_msec = assert_msec;
+    _release_msec = release_msec;
+  }
+
+
+  uint32_t Get_Assert_MSEC() {
+    return _assert_msec;
+  }
+
+
+  uint32_t Get_Release_MSEC() {
+    return _release_msec;
+  }
+
+
+  uint32_t Get_Assert_Edges() {
+    return _assert_edges;
+  }
+
+
+  uint32_t Get_Release_Edges() {
+    return _release_edges;
+  }
+
+
+  //
+  // Raw input changes, the difference to the filtered edges is the chatter that was rejected.
+  //
+  uint32_t Get_Raw_Changes() {
+    return _raw_changes;
+  }
+
+
+  void Reset_Counts() {
+    _assert_edges = 0;
+    _release_edges = 0;
+    _raw_changes = 0;
+  }
+};
+
+#endif
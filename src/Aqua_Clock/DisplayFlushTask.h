@@ -0,0 +1,196 @@
+/*
+ * Display Flush Task class for the Aqua Clock
+ *
+ * Moves the SPI transfer of the UI frames off the control loop.  The UI draws into one of two canvases
+ * while the other one is being sent to the SSD1351 by a FreeRTOS task on the other ESP32 core, so the
+ * valve regulation never waits on the display.  A frame handed over while the previous one is still in
+ * flight is dropped and the UI forces a render on its next update to send it again.
+ * The SPI bus is only used by the display.  Anything else that talks to the display from the loop must
+ * hold the Lock() so it does not cut into a frame in flight.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef DISPLAY_FLUSH_TASK_H
+#define DISPLAY_FLUSH_TASK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1351.h>
+
+#include "FrameFlusher.h"
+#include "Stats.h"
+
+
+class DisplayFlushTask {
+private:
+
+  static constexpr uint32_t TASK_STACK_BYTES = 4096;
+  static constexpr UBaseType_t TASK_PRIORITY = 1;
+  static constexpr BaseType_t TASK_CORE = 0;  // The Arduino loop runs on core 1
+
+  FrameFlusher *_flusher;
+  PaletteCanvas *_canvases[2];
+  uint8_t _back = 0;
+  PaletteCanvas *volatile _in_flight = NULL;
+
+  TaskHandle_t _task = NULL;
+  SemaphoreHandle_t _idle = NULL;  // Taken while a frame is in flight or the display is locked
+  bool _async = true;
+
+  volatile uint32_t _frames_done = 0;
+  uint32_t _frames_submitted = 0;
+  uint32_t _frames_dropped = 0;
+  RunningStats _submit_usec_stats;
+
+public:
+
+  DisplayFlushTask(Adafruit_SSD1351 *display, int16_t width, int16_t height) {
+    _canvases[0] = new PaletteCanvas(width, height);
+    _canvases[1] = new PaletteCanvas(width, height);
+    _flusher = new FrameFlusher(display, _canvases[0]);
+    _idle = xSemaphoreCreateBinary();
+    xSemaphoreGive(_idle);
+  }
+
+
+  //
+  // Start the flush task.  Without it the frames are sent from the loop.
+  //
+  void Startup() {
+    if (xTaskCreatePinnedToCore(&DisplayFlushTask::task_entry, "display", TASK_STACK_BYTES, this,
+                                TASK_PRIORITY, &_task, TASK_CORE)
+        != pdPASS) {
+      _task = NULL;
+      Serial.println("ERROR: Failed to start the display flush task!");
+    }
+  }
+
+
+  //
+  // Canvas to draw the next frame into.
+  //
+  PaletteCanvas *Get_Back_Canvas() {
+    return _canvases[_back];
+  }
+
+
+  //
+  // Hand the drawn frame over for sending.  Returns false when the frame was dropped because the
+  // previous one is still in flight.
+  //
+  bool Submit() {
+    uint32_t start_usec = micros();
+    if (xSemaphoreTake(_idle, 0) != pdTRUE) {
+      _frames_dropped++;
+      _submit_usec_stats.Add(micros() - start_usec);
+      return false;
+    }
+
+    PaletteCanvas *frame = _canvases[_back];
+    _frames_submitted++;
+    if (_async && (_task != NULL)) {
+      // Draw the next frame into the other canvas while this one is sent
+      _in_flight = frame;
+      _back ^= 1;
+      xTaskNotifyGive(_task);
+    } else {
+      _flusher->Flush(frame);
+      _frames_done++;
+      xSemaphoreGive(_idle);
+    }
+    _submit_usec_stats.Add(micros() - start_usec);
+    return true;
+  }
+
+
+  //
+  // Wait for the frame in flight and keep the display until Unlock().
+  //
+  bool Lock(uint32_t timeout_msec) {
+    return xSemaphoreTake(_idle, pdMS_TO_TICKS(timeout_msec)) == pdTRUE;
+  }
+
+
+  void Unlock() {
+    xSemaphoreGive(_idle);
+  }
+
+
+  bool Is_Frame_In_Flight() {
+    return _frames_done != _frames_submitted;
+  }
+
+
+  uint32_t Get_Frames_Done() {
+    return _frames_done;
+  }
+
+
+  // Send the frames from the flush task (true) or from the loop (false)
+  void Set_Async(bool async) {
+    _async = async;
+  }
+
+
+  bool Is_Async() {
+    return _async && (_task != NULL);
+  }
+
+
+  void Set_Glyph_Atlas_Enable(bool enable) {
+    _canvases[0]->Set_Glyph_Atlas_Enable(enable);
+    _canvases[1]->Set_Glyph_Atlas_Enable(enable);
+  }
+
+
+  FrameFlusher *Get_Frame_Flusher() {
+    return _flusher;
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Flush: ");
+    Serial.print(Is_Async() ? "TASK" : "LOOP");
+    Serial.print("  Frames sent: ");
+    Serial.print(_frames_done);
+    Serial.print("  dropped: ");
+    Serial.println(_frames_dropped);
+    Serial.print("   Loop usec per frame: ");
+    _submit_usec_stats.Print("");
+    Serial.println();
+  }
+
+
+  void Reset_Stats() {
+    _frames_dropped = 0;
+    _submit_usec_stats.Reset();
+    _flusher->Reset_Stats();
+  }
+
+
+protected:
+
+  static void task_entry(void *context) {
+    ((DisplayFlushTask *)context)->run();
+  }
+
+
+  //
+  // Send each frame handed over and signal its completion.
+  //
+  void run() {
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      _flusher->Flush(_in_flight);
+      _frames_done++;
+      xSemaphoreGive(_idle);
+    }
+  }
+};
+
+#endif
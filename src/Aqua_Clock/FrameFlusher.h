@@ -0,0 +1,274 @@
+/*
+ * Frame Flusher class for the Aqua Clock
+ *
+ * Copies the UI canvas to the SSD1351 OLED.  Pushing the whole 128x128 16 bit frame moves 32 KB over SPI
+ * even when only a seconds digit changed.  The frame is split into tiles and a copy of the palette indexes
+ * last sent is kept, 8 KB at 4 bits per pixel.  Each tile is compared with its copy and only the changed
+ * tiles are sent, each run of changed tiles along a tile row through one SSD1351 column/row address window.
+ * The canvas holds palette indexes, the pixels are expanded to RGB565 one line at a time as they are sent.
+ * The SPI bytes and the CPU time of every flush are measured for both the tiled and the full push so
+ * the two can be compared on the console.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef FRAME_FLUSHER_H
+#define FRAME_FLUSHER_H
+
+#include <Arduino.h>
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1351.h>
+
+#include "PaletteCanvas.h"
+#include "Stats.h"
+
+
+class FrameFlusher {
+public:
+
+  typedef enum {
+    FLUSH_MODE_FULL,  /* Push the whole frame every time */
+    FLUSH_MODE_TILES, /* Push the changed tiles */
+    FLUSH_MODE_COUNT
+  } FLUSH_MODE_T;
+
+  static constexpr int16_t FRAME_WIDTH = 128;
+  static constexpr int16_t FRAME_HEIGHT = 128;
+  static constexpr int16_t TILE_WIDTH = 16;
+  static constexpr int16_t TILE_HEIGHT = 8;
+  static constexpr uint8_t TILE_COLUMNS = FRAME_WIDTH / TILE_WIDTH;
+  static constexpr uint8_t TILE_ROWS = FRAME_HEIGHT / TILE_HEIGHT;
+
+private:
+
+  // SSD1351 set column, set row and write RAM commands with their arguments
+  static constexpr uint32_t WINDOW_OVERHEAD_BYTES = 7;
+
+  Adafruit_SSD1351 *_display;
+  PaletteCanvas *_canvas;
+  uint16_t _line[FRAME_WIDTH];  // One line expanded to RGB565
+
+  FLUSH_MODE_T _mode = FLUSH_MODE_TILES;
+
+  // Palette indexes of the frame the display shows, laid out like the canvas buffer
+  static constexpr int16_t SHOWN_BYTES_PER_LINE = FRAME_WIDTH / 2;
+  uint8_t *_shown;
+  bool _shown_valid = false;
+
+  // Measurements per mode
+  RunningStats _bytes_stats[FLUSH_MODE_COUNT];
+  RunningStats _usec_stats[FLUSH_MODE_COUNT];
+  RunningStats _tiles_stats;
+  RunningStats _expand_usec_stats;
+  uint32_t _last_bytes = 0;
+
+public:
+
+  FrameFlusher(Adafruit_SSD1351 *display, PaletteCanvas *canvas) {
+    _display = display;
+    _canvas = canvas;
+    _shown = (uint8_t *)malloc(SHOWN_BYTES_PER_LINE * FRAME_HEIGHT);
+  }
+
+
+  //
+  // Send a canvas to the display.
+  //
+  void Flush(PaletteCanvas *canvas) {
+    _canvas = canvas;
+    uint32_t start_usec = micros();
+    FLUSH_MODE_T mode = _shown_valid ? _mode : FLUSH_MODE_FULL;
+    if (mode == FLUSH_MODE_FULL) {
+      _last_bytes = flush_full();
+    } else {
+      _last_bytes = flush_tiles();
+    }
+    _bytes_stats[mode].Add(_last_bytes);
+    _usec_stats[mode].Add(micros() - start_usec);
+  }
+
+
+  //
+  // Forget what the display shows, the next flush sends the whole frame.
+  //
+  void Invalidate() {
+    _shown_valid = false;
+  }
+
+
+  void Set_Mode(FLUSH_MODE_T mode) {
+    if (mode < FLUSH_MODE_COUNT) {
+      _mode = mode;
+      _shown_valid = false;
+    }
+  }
+
+
+  FLUSH_MODE_T Get_Mode() {
+    return _mode;
+  }
+
+
+  uint32_t Get_Last_Bytes() {
+    return _last_bytes;
+  }
+
+
+  //
+  // Time a number of full pushes of the last canvas sent for a baseline without waiting for the mode switch.
+  //
+  void Benchmark_Full(uint8_t frames) {
+    for (uint8_t i = 0; i < frames; i++) {
+      uint32_t start_usec = micros();
+      uint32_t bytes = flush_full();
+      _bytes_stats[FLUSH_MODE_FULL].Add(bytes);
+      _usec_stats[FLUSH_MODE_FULL].Add(micros() - start_usec);
+    }
+  }
+
+
+  //
+  // Time the RGB565 expansion of whole frames without sending them, the cost of the palette canvas.
+  //
+  void Benchmark_Expand(uint8_t frames) {
+    for (uint8_t i = 0; i < frames; i++) {
+      uint32_t start_usec = micros();
+      for (int16_t y = 0; y < FRAME_HEIGHT; y++) {
+        _canvas->Expand_Line(0, y, FRAME_WIDTH, _line);
+      }
+      _expand_usec_stats.Add(micros() - start_usec);
+    }
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Mode: ");
+    Serial.println((_mode == FLUSH_MODE_FULL) ? "FULL" : "TILES");
+    for (uint8_t i = 0; i < FLUSH_MODE_COUNT; i++) {
+      Serial.print((i == FLUSH_MODE_FULL) ? "   Full  bytes: " : "   Tiles bytes: ");
+      _bytes_stats[i].Print("");
+      Serial.println();
+      Serial.print("         usec:  ");
+      _usec_stats[i].Print("");
+      Serial.println();
+    }
+    Serial.print("   Expand usec per frame: ");
+    _expand_usec_stats.Print("");
+    Serial.println();
+    Serial.print("   Tiles sent per frame: ");
+    _tiles_stats.Print("");
+    Serial.print(" of ");
+    Serial.println(TILE_ROWS * TILE_COLUMNS);
+    if ((_bytes_stats[FLUSH_MODE_FULL].Get_Mean() > 0) && (_usec_stats[FLUSH_MODE_FULL].Get_Mean() > 0)
+        && (_bytes_stats[FLUSH_MODE_TILES].Get_Count() > 0)) {
+      Serial.print("   Tiles vs full, bytes: ");
+      Serial.print(100.0f * _bytes_stats[FLUSH_MODE_TILES].Get_Mean() / _bytes_stats[FLUSH_MODE_FULL].Get_Mean(), 1);
+      Serial.print("%  usec: ");
+      Serial.print(100.0f * _usec_stats[FLUSH_MODE_TILES].Get_Mean() / _usec_stats[FLUSH_MODE_FULL].Get_Mean(), 1);
+      Serial.println("%");
+    }
+  }
+
+
+  void Reset_Stats() {
+    for (uint8_t i = 0; i < FLUSH_MODE_COUNT; i++) {
+      _bytes_stats[i].Reset();
+      _usec_stats[i].Reset();
+    }
+    _tiles_stats.Reset();
+    _expand_usec_stats.Reset();
+  }
+
+
+protected:
+
+  uint32_t flush_full() {
+    _display->startWrite();
+    send_window(0, 0, FRAME_WIDTH, FRAME_HEIGHT);
+    _display->endWrite();
+    if ((_mode == FLUSH_MODE_TILES) && (_shown != NULL)) {
+      // Start the tile comparison from this frame
+      for (int16_t y = 0; y < FRAME_HEIGHT; y++) {
+        memcpy(&_shown[y * SHOWN_BYTES_PER_LINE], &_canvas->getBuffer()[y * _canvas->Get_Bytes_Per_Line()], SHOWN_BYTES_PER_LINE);
+      }
+      _shown_valid = true;
+    }
+    return WINDOW_OVERHEAD_BYTES + (uint32_t)FRAME_WIDTH * FRAME_HEIGHT * 2;
+  }
+
+
+  //
+  // Send each run of changed tiles along a tile row as one address window.
+  //
+  uint32_t flush_tiles() {
+    uint32_t bytes = 0;
+    uint32_t tiles = 0;
+
+    _display->startWrite();
+    for (uint8_t row = 0; row < TILE_ROWS; row++) {
+      uint8_t col = 0;
+      while (col < TILE_COLUMNS) {
+        if (!tile_changed(row, col)) {
+          col++;
+          continue;
+        }
+
+        // Extend the run over the following changed tiles
+        uint8_t first = col;
+        keep_tile(row, col++);
+        while ((col < TILE_COLUMNS) && tile_changed(row, col)) {
+          keep_tile(row, col++);
+        }
+        bytes += send_window(first * TILE_WIDTH, row * TILE_HEIGHT, (col - first) * TILE_WIDTH, TILE_HEIGHT);
+        tiles += col - first;
+      }
+    }
+    _display->endWrite();
+
+    _tiles_stats.Add(tiles);
+    return bytes;
+  }
+
+
+  uint32_t send_window(int16_t x, int16_t y, int16_t w, int16_t h) {
+    _display->setAddrWindow(x, y, w, h);
+    for (int16_t line = 0; line < h; line++) {
+      _canvas->Expand_Line(x, y + line, w, _line);
+      _display->writePixels(_line, w);
+    }
+    return WINDOW_OVERHEAD_BYTES + (uint32_t)w * h * 2;
+  }
+
+
+  //
+  // True if any palette index of the tile differs from the frame the display shows.
+  //
+  bool tile_changed(uint8_t row, uint8_t col) {
+    const uint8_t *buffer = _canvas->getBuffer();
+    int16_t bytes_per_line = _canvas->Get_Bytes_Per_Line();
+    for (int16_t line = row * TILE_HEIGHT; line < (row + 1) * TILE_HEIGHT; line++) {
+      if (memcmp(&buffer[line * bytes_per_line + col * (TILE_WIDTH / 2)], &_shown[line * SHOWN_BYTES_PER_LINE + col * (TILE_WIDTH / 2)],
+                 TILE_WIDTH / 2)
+          != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  //
+  // Copy a tile that is being sent into the frame the display shows.
+  //
+  void keep_tile(uint8_t row, uint8_t col) {
+    const uint8_t *buffer = _canvas->getBuffer();
+    int16_t bytes_per_line = _canvas->Get_Bytes_Per_Line();
+    for (int16_t line = row * TILE_HEIGHT; line < (row + 1) * TILE_HEIGHT; line++) {
+      memcpy(&_shown[line * SHOWN_BYTES_PER_LINE + col * (TILE_WIDTH / 2)], &buffer[line * bytes_per_line + col * (TILE_WIDTH / 2)],
+             TILE_WIDTH / 2);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,362 @@
+/*
+ * Key Pad class for the Aqua Clock
+ *
+ * Scans the five UI keys on the SX1509 IO expander every few milliseconds, well above the menu update
+ * rate, so quick presses are not missed between menu updates.  Each key is debounced by an integrator
+ * that counts up while the key reads down and down while it reads up, the key only changes state when
+ * the count reaches either end.
+ * Key changes are queued as time stamped events for the UI to drain at its own rate:
+ *   PRESS       The key went down
+ *   REPEAT      The key is still held, sent faster the longer it is held.  Only for keys with repeat enabled.
+ *   LONG_PRESS  The key has been held for LONG_PRESS_MSEC, sent once per press
+ *   RELEASE     The key went up
+ * While the clock sleeps the loop only polls the keys between light sleep slices, far too slowly for the
+ * integrator.  The SX1509 latches the key edges in between and each poll scans a latched key in a burst.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef KEY_PAD_H
+#define KEY_PAD_H
+
+#include <Arduino.h>
+#include <elapsedMillis.h>
+#include <Wire.h>
+#include <SparkFunSX1509.h>
+
+#include "io_expander_config.h"
+
+
+class KeyPad {
+public:
+
+  typedef enum {
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_ENTER,
+    KEY_COUNT
+  } KEY_T;
+
+  typedef enum {
+    KEY_EVENT_PRESS,
+    KEY_EVENT_REPEAT,
+    KEY_EVENT_LONG_PRESS,
+    KEY_EVENT_RELEASE,
+    KEY_EVENT_COUNT
+  } KEY_EVENT_TYPE_T;
+
+  typedef struct {
+    KEY_T key;
+    KEY_EVENT_TYPE_T type;
+    uint32_t msec;       // millis() when the event was detected
+    uint32_t held_msec;  // Time the key had been down
+  } KEY_EVENT_T;
+
+  static constexpr uint32_t SCAN_PERIOD_MSEC = 5;
+  static constexpr uint8_t INTEGRATOR_MAX = 4;  // Scans to change state, 20 msec
+  static constexpr uint32_t LONG_PRESS_MSEC = 800;
+  static constexpr uint32_t REPEAT_DELAY_MSEC = 400;
+  static constexpr uint32_t REPEAT_START_INTERVAL_MSEC = 200;
+  static constexpr uint32_t REPEAT_MIN_INTERVAL_MSEC = 30;
+  static constexpr uint8_t REPEAT_ACCEL_PCT = 85;  // Each repeat interval is this much of the one before
+  static constexpr uint8_t QUEUE_SIZE = 16;
+  static constexpr uint8_t SX1509_REG_DATA_B = 0x10;  // RegDataB, RegDataA follows it
+  static constexpr uint8_t WAKE_SCANS_MAX = 2 * INTEGRATOR_MAX;  // Burst length limit after a sleep slice
+
+private:
+
+  typedef struct {
+    uint8_t integrator;
+    bool active;
+    bool long_press_sent;
+    bool repeat_enable;
+    uint32_t press_msec;
+    uint32_t next_repeat_msec;
+    uint32_t repeat_interval_msec;
+  } KEY_STATE_T;
+
+  // Expander pin of each key, KEY_T order.  The keys pull the pins low.
+  const uint8_t KEY_PINS[KEY_COUNT] = { SC1509_PIN_KEY_4, SC1509_PIN_KEY_5, SC1509_PIN_KEY_3, SC1509_PIN_KEY_2, SC1509_PIN_KEY_1 };
+
+  SX1509 *_io_expander;
+  elapsedMillis _scan_period_elapsed;
+  KEY_STATE_T _keys[KEY_COUNT];
+
+  KEY_EVENT_T _queue[QUEUE_SIZE];
+  uint8_t _queue_head = 0;
+  uint8_t _queue_count = 0;
+
+  uint32_t _event_counts[KEY_EVENT_COUNT];
+  uint32_t _events_dropped = 0;
+  uint8_t _queue_high_water = 0;
+  uint32_t _wake_taps = 0;
+
+public:
+
+  KeyPad(SX1509 *io_expander) {
+    _io_expander = io_expander;
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      _keys[i].integrator = 0;
+      _keys[i].active = false;
+      _keys[i].long_press_sent = false;
+      _keys[i].repeat_enable = false;
+      _keys[i].press_msec = 0;
+      _keys[i].next_repeat_msec = 0;
+      _keys[i].repeat_interval_msec = REPEAT_START_INTERVAL_MSEC;
+    }
+    Reset_Stats();
+  }
+
+
+  //
+  // Sample the keys and queue their events.  Called every loop, rate controlled to SCAN_PERIOD_MSEC.
+  //
+  void Scan() {
+    if (_scan_period_elapsed < SCAN_PERIOD_MSEC) {
+      return;
+    }
+    _scan_period_elapsed = 0;
+
+    scan_keys(millis());
+  }
+
+
+  //
+  // Latch the key presses in the SX1509 while the loop sleeps between polls.  Its interrupt line is not
+  // wired, the falling edges are only held in the interrupt source registers for Wake_Scan() to read.
+  //
+  void Arm_Wake_Latch() {
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      _io_expander->enableInterrupt(KEY_PINS[i], FALLING);
+    }
+    _io_expander->interruptSource(true);
+  }
+
+
+  //
+  // Called after each sleep slice.  A key latched by Arm_Wake_Latch() is scanned in a burst until it
+  // settles, a tap released before the burst could debounce it is queued as a press and a release.
+  //
+  void Wake_Scan() {
+    uint16_t latched = _io_expander->interruptSource(true);
+    uint8_t tapped = 0;
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      if (latched & (1 << KEY_PINS[i])) {
+        tapped |= 1 << i;
+      }
+    }
+    if (tapped == 0) {
+      return;
+    }
+
+    scan_keys(millis());
+    for (uint8_t scan = 1; (scan < WAKE_SCANS_MAX) && !is_settled(tapped); scan++) {
+      delay(SCAN_PERIOD_MSEC);
+      scan_keys(millis());
+    }
+    _scan_period_elapsed = 0;
+
+    uint32_t now_msec = millis();
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      if ((tapped & (1 << i)) && !_keys[i].active) {
+        _keys[i].integrator = 0;
+        _wake_taps++;
+        queue_event((KEY_T)i, KEY_EVENT_PRESS, now_msec, 0);
+        queue_event((KEY_T)i, KEY_EVENT_RELEASE, now_msec, 0);
+      }
+    }
+  }
+
+
+  //
+  // Take the oldest event.  Returns false when there is none.
+  //
+  bool Get_Event(KEY_EVENT_T *event) {
+    if (!Peek_Event(event)) {
+      return false;
+    }
+    _queue_head = (_queue_head + 1) % QUEUE_SIZE;
+    _queue_count--;
+    return true;
+  }
+
+
+  //
+  // Look at the oldest event without taking it.
+  //
+  bool Peek_Event(KEY_EVENT_T *event) {
+    if (_queue_count == 0) {
+      return false;
+    }
+    *event = _queue[_queue_head];
+    return true;
+  }
+
+
+  void Set_Repeat_Enable(KEY_T key, bool enable) {
+    _keys[key].repeat_enable = enable;
+  }
+
+
+  // Debounced state of a key
+  bool Is_Active(KEY_T key) {
+    return _keys[key].active;
+  }
+
+
+  bool Is_Any_Active() {
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      if (_keys[i].active) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Presses: ");
+    Serial.print(_event_counts[KEY_EVENT_PRESS]);
+    Serial.print("  Repeats: ");
+    Serial.print(_event_counts[KEY_EVENT_REPEAT]);
+    Serial.print("  Long presses: ");
+    Serial.print(_event_counts[KEY_EVENT_LONG_PRESS]);
+    Serial.print("  Releases: ");
+    Serial.println(_event_counts[KEY_EVENT_RELEASE]);
+    Serial.print("   Queue high water: ");
+    Serial.print(_queue_high_water);
+    Serial.print(" of ");
+    Serial.print(QUEUE_SIZE);
+    Serial.print("  Events dropped: ");
+    Serial.print(_events_dropped);
+    Serial.print("  Wake taps: ");
+    Serial.println(_wake_taps);
+  }
+
+
+  void Reset_Stats() {
+    for (uint8_t i = 0; i < KEY_EVENT_COUNT; i++) {
+      _event_counts[i] = 0;
+    }
+    _events_dropped = 0;
+    _wake_taps = 0;
+    _queue_high_water = _queue_count;
+  }
+
+
+protected:
+
+  // Sample every key from one read of both SX1509 data registers, the bus is shared with the range
+  // sensors and the RTC.  A failed read skips the scan.
+  void scan_keys(uint32_t now_msec) {
+    uint16_t pins;
+    if (!read_pins(pins)) {
+      return;
+    }
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      scan_key((KEY_T)i, !(pins & (1 << KEY_PINS[i])), now_msec);
+    }
+  }
+
+
+  //
+  // Read RegDataB and RegDataA in one two byte transfer, the SX1509 steps to the next register on its
+  // own.  Bank B is the high byte, bank A with the keys the low byte.  Done on the bus directly since
+  // the library only has a word read public in some of its versions.
+  //
+  bool read_pins(uint16_t &pins) {
+    Wire.beginTransmission(SX1509_ADDRESS);
+    Wire.write(SX1509_REG_DATA_B);
+    if (Wire.endTransmission() != 0) {
+      return false;
+    }
+    if (Wire.requestFrom((uint8_t)SX1509_ADDRESS, (uint8_t)2) != 2) {
+      return false;
+    }
+    uint16_t bank_b = Wire.read();
+    uint16_t bank_a = Wire.read();
+    pins = (bank_b << 8) | bank_a;
+    return true;
+  }
+
+
+  // True when every key in the mask is either debounced down or fully up
+  bool is_settled(uint8_t key_mask) {
+    for (uint8_t i = 0; i < KEY_COUNT; i++) {
+      if ((key_mask & (1 << i)) && !_keys[i].active && (_keys[i].integrator > 0)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void scan_key(KEY_T key, bool down, uint32_t now_msec) {
+    KEY_STATE_T &state = _keys[key];
+
+    // Integrate the raw samples toward down or up
+    if (down) {
+      if (state.integrator < INTEGRATOR_MAX) {
+        state.integrator++;
+      }
+    } else if (state.integrator > 0) {
+      state.integrator--;
+    }
+
+    if (!state.active) {
+      if (state.integrator == INTEGRATOR_MAX) {
+        state.active = true;
+        state.long_press_sent = false;
+        state.press_msec = now_msec;
+        state.repeat_interval_msec = REPEAT_START_INTERVAL_MSEC;
+        state.next_repeat_msec = now_msec + REPEAT_DELAY_MSEC;
+        queue_event(key, KEY_EVENT_PRESS, now_msec, 0);
+      }
+      return;
+    }
+
+    uint32_t held_msec = now_msec - state.press_msec;
+    if (state.integrator == 0) {
+      state.active = false;
+      queue_event(key, KEY_EVENT_RELEASE, now_msec, held_msec);
+      return;
+    }
+
+    if (!state.long_press_sent && (held_msec >= LONG_PRESS_MSEC)) {
+      state.long_press_sent = true;
+      queue_event(key, KEY_EVENT_LONG_PRESS, now_msec, held_msec);
+    }
+
+    // Repeat faster the longer the key is held
+    if (state.repeat_enable && ((int32_t)(now_msec - state.next_repeat_msec) >= 0)) {
+      queue_event(key, KEY_EVENT_REPEAT, now_msec, held_msec);
+      state.repeat_interval_msec = state.repeat_interval_msec * REPEAT_ACCEL_PCT / 100;
+      if (state.repeat_interval_msec < REPEAT_MIN_INTERVAL_MSEC) {
+        state.repeat_interval_msec = REPEAT_MIN_INTERVAL_MSEC;
+      }
+      state.next_repeat_msec = now_msec + state.repeat_interval_msec;
+    }
+  }
+
+
+  void queue_event(KEY_T key, KEY_EVENT_TYPE_T type, uint32_t now_msec, uint32_t held_msec) {
+    if (_queue_count >= QUEUE_SIZE) {
+      _events_dropped++;
+      return;
+    }
+    KEY_EVENT_T &event = _queue[(_queue_head + _queue_count) % QUEUE_SIZE];
+    event.key = key;
+    event.type = type;
+    event.msec = now_msec;
+    event.held_msec = held_msec;
+    _queue_count++;
+    _event_counts[type]++;
+    if (_queue_count > _queue_high_water) {
+      _queue_high_water = _queue_count;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Level Animator class for the Aqua Clock
+ *
+ * Eases a water level drawn on the display toward its measured height instead of jumping to each new
+ * reading.  The level is kept in 1/256 pixel steps and moves a quarter of the remaining distance every
+ * animation frame, at least MIN_STEP_Q8, so it glides quickly at first and then eases in.  The motion
+ * ends as soon as the drawn pixels match the target.
+ * All integer math.  A level that has not been drawn for a while snaps to its target, so a screen that
+ * is entered again does not replay old motion.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef LEVEL_ANIMATOR_H
+#define LEVEL_ANIMATOR_H
+
+#include <Arduino.h>
+
+
+class LevelAnimator {
+public:
+
+  static constexpr uint8_t Q8_SHIFT = 8;
+  static constexpr int32_t MIN_STEP_Q8 = 1 << (Q8_SHIFT - 2);  // 1/4 pixel
+  static constexpr uint8_t EASE_SHIFT = 2;                      // Move 1/4 of the distance per frame
+  static constexpr uint32_t SNAP_AFTER_MSEC = 500;
+
+private:
+
+  int32_t _shown_q8 = 0;
+  int32_t _target_q8 = 0;
+  bool _shown_valid = false;
+  uint32_t _last_step_msec = 0;
+
+public:
+
+  //
+  // Water height in pixels of a vessel filled to fill_num / fill_den.
+  //
+  static int32_t Fill_To_Q8(int32_t height_pixels, int32_t fill_num, int32_t fill_den) {
+    if (fill_den <= 0) {
+      return 0;
+    }
+    fill_num = constrain(fill_num, (int32_t)0, fill_den);
+    return ((height_pixels << Q8_SHIFT) * fill_num) / fill_den;
+  }
+
+
+  //
+  // Move the shown level one frame toward the target.  Returns the whole pixels to draw.
+  //
+  int16_t Step(int32_t target_q8) {
+    uint32_t now_msec = millis();
+    if (!_shown_valid || ((now_msec - _last_step_msec) > SNAP_AFTER_MSEC)) {
+      _shown_q8 = target_q8;
+      _shown_valid = true;
+    }
+    _last_step_msec = now_msec;
+
+    int32_t distance = target_q8 - _shown_q8;
+    int32_t step = distance / (1 << EASE_SHIFT);
+    if ((distance <= MIN_STEP_Q8) && (distance >= -MIN_STEP_Q8)) {
+      step = distance;
+    } else if ((step < MIN_STEP_Q8) && (step > -MIN_STEP_Q8)) {
+      step = (distance > 0) ? MIN_STEP_Q8 : -MIN_STEP_Q8;
+    }
+    _shown_q8 += step;
+    _target_q8 = target_q8;
+
+    // Done once the drawn pixels match, the rest of the motion would not show
+    if (Get_Pixels() == round_pixels(target_q8)) {
+      _shown_q8 = target_q8;
+    }
+    return Get_Pixels();
+  }
+
+
+  // True until the shown level reaches the target of the last step
+  bool Is_Moving() {
+    return _shown_valid && (_shown_q8 != _target_q8);
+  }
+
+
+  // Shown level rounded to whole pixels
+  int16_t Get_Pixels() {
+    return round_pixels(_shown_q8);
+  }
+
+
+protected:
+
+  static int16_t round_pixels(int32_t q8) {
+    return (int16_t)((q8 + (1 << (Q8_SHIFT - 1))) >> Q8_SHIFT);
+  }
+};
+
+#endif
@@ -0,0 +1,638 @@
+/*
+ * Column Move Planner class for the Aqua Clock
+ *
+ * Coordinates when each column is allowed to start a regulated fill or drain.
+ * All of the columns are fed from the same gravity feed tank and drain into the same holding tank,
+ * so flows in the same direction share a path and slow each other down.  On a rollover such as
+ * 12:59 -> 1:00 every column moves at once and the planner decides the order.
+ * Supported strategies:
+ *   SIMULTANEOUS - Every column starts as soon as it is out of deadband (legacy behavior).
+ *   SEQUENTIAL   - Only one column flows at a time, largest move first.
+ *   SHARED_PATH  - One fill on the feed path and one drain on the drain path at a time, largest first.
+ * The planner measures the time for each transition and the flow rate of each move, grouped by how many
+ * columns shared the same path.  The measured rates feed a small hydraulic model that can simulate a
+ * transition for each strategy so they can be compared on the worst case rollovers.
+ * By default the strategy is chosen automatically at the start of every transition, the one the model
+ * finishes soonest from the current elevations to the new setpoints.  Setting a strategy overrides it.
+ * The simulations run a slice of SIM_STEPS_PER_PASS steps per update so the control loop is not held up,
+ * the new moves wait until the choice is made.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef MOVE_PLANNER_H
+#define MOVE_PLANNER_H
+
+#include <Arduino.h>
+#include <elapsedMillis.h>
+
+#include "ColumnManager.h"
+#include "Stats.h"
+
+
+class MovePlanner {
+public:
+  typedef enum {
+    PLAN_SIMULTANEOUS,
+    PLAN_SEQUENTIAL,
+    PLAN_SHARED_PATH,
+    PLAN_STRATEGY_COUNT
+  } PLAN_STRATEGY_T;
+
+  static constexpr uint8_t MAX_COLUMNS = 6;
+
+
+private:
+  typedef enum {
+    FLOW_NONE,
+    FLOW_FILL,
+    FLOW_DRAIN
+  } FLOW_T;
+
+  // A transition simulation in progress
+  typedef struct {
+    int32_t level_um[MAX_COLUMNS];
+    FLOW_T flow[MAX_COLUMNS];
+    uint32_t settle_left[MAX_COLUMNS];
+    uint32_t msec;
+  } SIM_STATE_T;
+
+  ColumnManager **_columns;
+  uint8_t _num_columns = 0;
+
+  PLAN_STRATEGY_T _strategy = PLAN_SIMULTANEOUS;
+  bool _auto_strategy = true;
+  bool _logging_enable = false;
+
+  // Automatic strategy choice, simulated a slice at a time over several updates
+  bool _choosing = false;
+  uint8_t _choose_strategy = 0;
+  PLAN_STRATEGY_T _choose_best = PLAN_SIMULTANEOUS;
+  uint32_t _choose_best_msec = 0;
+  uint8_t _choose_passes = 0;
+  uint16_t _choose_from_mm[MAX_COLUMNS];
+  uint16_t _choose_to_mm[MAX_COLUMNS];
+  SIM_STATE_T _choose_sim;
+  RunningStats _choose_usec_stats;    // Time spent choosing per update
+  RunningStats _choose_passes_stats;  // Updates per choice
+
+  // Transition timing, from the first out of deadband column until all columns are back at rest
+  bool _transition_active = false;
+  PLAN_STRATEGY_T _transition_strategy = PLAN_SIMULTANEOUS;
+  elapsedMillis _transition_elapsed;
+  uint32_t _last_transition_msec = 0;
+  RunningStats _transition_stats[PLAN_STRATEGY_COUNT];
+
+  // Per column move tracking used to measure the flow rates
+  FLOW_T _move_flow[MAX_COLUMNS];
+  uint16_t _move_start_elevation[MAX_COLUMNS];
+  uint32_t _move_start_msec[MAX_COLUMNS];
+  uint8_t _move_peak_sharing[MAX_COLUMNS];
+
+  // Measured flow rates in um/sec.  Indexed by [fill=0, drain=1][concurrent flows on the same path - 1]
+  RunningStats _flow_rate_stats[2][MAX_COLUMNS];
+  static constexpr uint32_t MIN_RATE_SAMPLE_MSEC = 500;  // Ignore tiny corrections, too noisy
+
+  // Hydraulic model defaults used until real flow rates have been measured
+  static constexpr uint32_t DEFAULT_FILL_RATE_UM_PER_SEC = 10000;
+  static constexpr uint32_t DEFAULT_DRAIN_RATE_UM_PER_SEC = 8000;
+  static constexpr uint32_t DEFAULT_SHARED_PATH_PENALTY_PERCENT = 60;  // Rate loss per extra flow on a path
+  static constexpr uint32_t MODEL_SETTLE_MSEC = 1000;
+  static constexpr uint32_t SIM_STEP_MSEC = 50;
+  static constexpr uint32_t SIM_MAX_MSEC = 180000;
+  static constexpr uint16_t SIM_STEPS_PER_PASS = 100;  // Simulation steps per update while choosing
+
+
+public:
+  /* Constructor - capture the set of columns to coordinate */
+  MovePlanner(ColumnManager **columns,
+              uint8_t num_columns) {
+    _columns = columns;
+    _num_columns = (num_columns > MAX_COLUMNS) ? MAX_COLUMNS : num_columns;
+
+    for (uint8_t i = 0; i < MAX_COLUMNS; i++) {
+      _move_flow[i] = FLOW_NONE;
+      _move_start_elevation[i] = 0;
+      _move_start_msec[i] = 0;
+      _move_peak_sharing[i] = 0;
+    }
+  }
+
+
+  PLAN_STRATEGY_T Get_Strategy() {
+    return _strategy;
+  }
+
+
+  //
+  // Use one strategy for every transition, overriding the automatic choice.
+  //
+  void Set_Strategy(PLAN_STRATEGY_T strategy) {
+    if (strategy < PLAN_STRATEGY_COUNT) {
+      _strategy = strategy;
+      _auto_strategy = false;
+    }
+  }
+
+
+  // Choose the fastest simulated strategy at the start of each transition (true) or keep the set one (false)
+  void Set_Auto_Strategy(bool enable) {
+    _auto_strategy = enable;
+  }
+
+
+  bool Is_Auto_Strategy() {
+    return _auto_strategy;
+  }
+
+
+  const char *Get_Strategy_Name(PLAN_STRATEGY_T strategy) {
+    switch (strategy) {
+      case PLAN_SIMULTANEOUS:
+        return "SIMULTANEOUS";
+      case PLAN_SEQUENTIAL:
+        return "SEQUENTIAL";
+      case PLAN_SHARED_PATH:
+        return "SHARED_PATH";
+      default:
+        return "UNKNOWN";
+    }
+  }
+
+
+  bool Is_Transition_Active() {
+    return _transition_active;
+  }
+
+
+  uint32_t Get_Last_Transition_Time_MSEC() {
+    return _last_transition_msec;
+  }
+
+
+  void Enable_Logging() {
+    _logging_enable = true;
+  }
+
+
+  void Disable_Logging() {
+    _logging_enable = false;
+  }
+
+
+  void Reset_Stats() {
+    for (uint8_t s = 0; s < PLAN_STRATEGY_COUNT; s++) {
+      _transition_stats[s].Reset();
+    }
+    for (uint8_t d = 0; d < 2; d++) {
+      for (uint8_t k = 0; k < MAX_COLUMNS; k++) {
+        _flow_rate_stats[d][k].Reset();
+      }
+    }
+    _choose_usec_stats.Reset();
+    _choose_passes_stats.Reset();
+  }
+
+
+  //
+  // Periodic update, run after the column managers have seen their latest setpoints and elevations.
+  // Grants move permits for the next column updates and records timing and flow rate measurements.
+  //
+  void Update() {
+    FLOW_T flow[MAX_COLUMNS];
+    int16_t pending[MAX_COLUMNS];
+    bool grant[MAX_COLUMNS];
+    bool all_at_rest = true;
+
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      ColumnManager::COLUMN_STATE_TYPE_T state = _columns[i]->Get_State();
+      bool out_of_deadband = (_columns[i]->Get_Control_Error_State() != ColumnManager::CONTROL_ERROR_DEADBAND);
+
+      flow[i] = flow_of_state(state);
+      pending[i] = 0;
+
+      if (_columns[i]->Is_Column_Regulator_Enabled()) {
+        if ((state == ColumnManager::COLUMN_IDLE) && out_of_deadband) {
+          pending[i] = _columns[i]->Get_Control_Error_MM();
+        }
+        if ((state != ColumnManager::COLUMN_IDLE) || out_of_deadband) {
+          all_at_rest = false;
+        }
+      }
+    }
+
+    // Plan a new transition with the strategy the model expects to finish first.  No new move starts
+    // until the choice is made.
+    if (_auto_strategy && !_transition_active && !all_at_rest) {
+      start_choice();
+    }
+    if (_choosing && (!_auto_strategy || all_at_rest)) {
+      _choosing = false;
+    }
+    if (_choosing) {
+      update_choice();
+    }
+
+    if (_choosing) {
+      for (uint8_t i = 0; i < _num_columns; i++) {
+        grant[i] = false;
+      }
+    } else {
+      select_moves(flow, pending, grant, _strategy);
+    }
+
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      _columns[i]->Set_Move_Permit(grant[i] || (flow[i] != FLOW_NONE));
+    }
+
+    track_flow_rates(flow);
+    track_transition(all_at_rest);
+  }
+
+
+  //
+  // Estimate the time in msec to move the columns from one set of elevations to another
+  // using the given strategy.  Uses the measured flow rates where available.
+  //
+  uint32_t Simulate_Transition(const uint16_t *from_mm, const uint16_t *to_mm, PLAN_STRATEGY_T strategy) {
+    SIM_STATE_T sim;
+    sim_start(&sim, from_mm);
+    while (!sim_run(&sim, to_mm, strategy, SIM_MAX_MSEC / SIM_STEP_MSEC)) {
+    }
+    return sim.msec;
+  }
+
+
+  //
+  // Report the measured transition times and flow rates on the console
+  //
+  void Print_Stats() {
+    Serial.print("   Strategy: ");
+    Serial.print(Get_Strategy_Name(_strategy));
+    Serial.println(_auto_strategy ? " (AUTO)" : " (FIXED)");
+    Serial.print("   Last transition: ");
+    Serial.print(_last_transition_msec);
+    Serial.println(" msec");
+
+    Serial.print("   Strategy choice usec per update: ");
+    _choose_usec_stats.Print("");
+    Serial.println();
+    Serial.print("   Updates per strategy choice: ");
+    _choose_passes_stats.Print("");
+    Serial.println();
+
+    for (uint8_t s = 0; s < PLAN_STRATEGY_COUNT; s++) {
+      Serial.print("   Transitions ");
+      Serial.print(Get_Strategy_Name((PLAN_STRATEGY_T)s));
+      Serial.print(": ");
+      _transition_stats[s].Print("ms");
+      Serial.println();
+    }
+
+    for (uint8_t d = 0; d < 2; d++) {
+      for (uint8_t k = 0; k < _num_columns; k++) {
+        Serial.print((d == 0) ? "   Fill rate, " : "   Drain rate, ");
+        Serial.print(k + 1);
+        Serial.print(" on path: ");
+        _flow_rate_stats[d][k].Print("um/s");
+        Serial.println();
+      }
+    }
+  }
+
+
+protected:
+
+  //
+  // Begin choosing the strategy with the shortest simulated transition from the current elevations to
+  // the current setpoints.
+  //
+  void start_choice() {
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      _choose_from_mm[i] = _columns[i]->Get_Elevation_Reading_MM();
+      _choose_to_mm[i] = _columns[i]->Get_Target_Setpoint_MM();
+    }
+    _choosing = true;
+    _choose_strategy = 0;
+    _choose_best = PLAN_SIMULTANEOUS;
+    _choose_best_msec = 0xFFFFFFFF;
+    _choose_passes = 0;
+    sim_start(&_choose_sim, _choose_from_mm);
+  }
+
+
+  //
+  // Run the next slice of the strategy simulations.  The first in PLAN_STRATEGY_T order wins a tie.
+  //
+  void update_choice() {
+    uint32_t start_usec = micros();
+    uint16_t steps_left = SIM_STEPS_PER_PASS;
+    while (_choosing && (steps_left > 0)) {
+      uint32_t start_msec = _choose_sim.msec;
+      bool done = sim_run(&_choose_sim, _choose_to_mm, (PLAN_STRATEGY_T)_choose_strategy, steps_left);
+      uint32_t steps = (_choose_sim.msec - start_msec) / SIM_STEP_MSEC;
+      steps_left = (steps < steps_left) ? (steps_left - steps) : 0;
+      if (!done) {
+        break;
+      }
+
+      if (_choose_sim.msec < _choose_best_msec) {
+        _choose_best_msec = _choose_sim.msec;
+        _choose_best = (PLAN_STRATEGY_T)_choose_strategy;
+      }
+      _choose_strategy++;
+      if (_choose_strategy < PLAN_STRATEGY_COUNT) {
+        sim_start(&_choose_sim, _choose_from_mm);
+      } else {
+        _choosing = false;
+        _strategy = _choose_best;
+      }
+    }
+    _choose_passes++;
+    _choose_usec_stats.Add(micros() - start_usec);
+
+    if (!_choosing) {
+      _choose_passes_stats.Add(_choose_passes);
+      if (_logging_enable) {
+        Serial.print("PLANNER: chose ");
+        Serial.print(Get_Strategy_Name(_strategy));
+        Serial.print(", simulated ");
+        Serial.print(_choose_best_msec);
+        Serial.print(" msec in ");
+        Serial.print(_choose_passes);
+        Serial.println(" updates");
+      }
+    }
+  }
+
+
+  void sim_start(SIM_STATE_T *sim, const uint16_t *from_mm) {
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      sim->level_um[i] = (int32_t)from_mm[i] * 1000;
+      sim->flow[i] = FLOW_NONE;
+      sim->settle_left[i] = 0;
+    }
+    sim->msec = 0;
+  }
+
+
+  //
+  // Advance a transition simulation by up to max_steps steps of SIM_STEP_MSEC.  Returns true once every
+  // column is at rest or SIM_MAX_MSEC is reached, with the transition time in sim->msec.
+  //
+  bool sim_run(SIM_STATE_T *sim, const uint16_t *to_mm, PLAN_STRATEGY_T strategy, uint32_t max_steps) {
+    int16_t pending[MAX_COLUMNS];
+    bool grant[MAX_COLUMNS];
+
+    for (uint32_t step = 0; step < max_steps; step++) {
+      if (sim->msec >= SIM_MAX_MSEC) {
+        sim->msec = SIM_MAX_MSEC;
+        return true;
+      }
+      bool all_at_rest = true;
+
+      // Find the remaining moves for the resting columns
+      for (uint8_t i = 0; i < _num_columns; i++) {
+        int16_t error = (int16_t)(sim->level_um[i] / 1000) - (int16_t)to_mm[i];
+        pending[i] = 0;
+        if ((sim->flow[i] == FLOW_NONE) && (sim->settle_left[i] == 0) && (abs(error) > _columns[i]->Get_Setpoint_Deadband())) {
+          pending[i] = error;
+        }
+        if ((sim->flow[i] != FLOW_NONE) || (sim->settle_left[i] > 0) || (pending[i] != 0)) {
+          all_at_rest = false;
+        }
+      }
+
+      if (all_at_rest) {
+        return true;
+      }
+
+      // Start the granted moves
+      select_moves(sim->flow, pending, grant, strategy);
+      for (uint8_t i = 0; i < _num_columns; i++) {
+        if (grant[i]) {
+          sim->flow[i] = (pending[i] > 0) ? FLOW_FILL : FLOW_DRAIN;
+        }
+      }
+
+      // Advance the flowing columns at the rate for the current path sharing
+      uint8_t fills = count_flows(sim->flow, FLOW_FILL);
+      uint8_t drains = count_flows(sim->flow, FLOW_DRAIN);
+
+      for (uint8_t i = 0; i < _num_columns; i++) {
+        if (sim->settle_left[i] > 0) {
+          sim->settle_left[i] = (sim->settle_left[i] > SIM_STEP_MSEC) ? (sim->settle_left[i] - SIM_STEP_MSEC) : 0;
+        } else if (sim->flow[i] == FLOW_FILL) {
+          // Filling raises the water which lowers the sensor range reading
+          sim->level_um[i] -= (int32_t)(model_rate_um_per_sec(FLOW_FILL, fills) * SIM_STEP_MSEC / 1000);
+        } else if (sim->flow[i] == FLOW_DRAIN) {
+          sim->level_um[i] += (int32_t)(model_rate_um_per_sec(FLOW_DRAIN, drains) * SIM_STEP_MSEC / 1000);
+        }
+
+        // Stop the move once it reaches the deadband, just like the column regulator
+        int16_t error = (int16_t)(sim->level_um[i] / 1000) - (int16_t)to_mm[i];
+        if (((sim->flow[i] == FLOW_FILL) && (error <= (int16_t)_columns[i]->Get_Setpoint_Deadband()))
+            || ((sim->flow[i] == FLOW_DRAIN) && (error >= -(int16_t)_columns[i]->Get_Setpoint_Deadband()))) {
+          sim->flow[i] = FLOW_NONE;
+          sim->settle_left[i] = model_settle_msec(i);
+        }
+      }
+      sim->msec += SIM_STEP_MSEC;
+    }
+    return false;
+  }
+
+
+  FLOW_T flow_of_state(ColumnManager::COLUMN_STATE_TYPE_T state) {
+    switch (state) {
+      case ColumnManager::COLUMN_FILL_ACTIVE:
+      case ColumnManager::COLUMN_MANUAL_FILL:
+        return FLOW_FILL;
+      case ColumnManager::COLUMN_DRAIN_ACTIVE:
+      case ColumnManager::COLUMN_MANUAL_DRAIN:
+        return FLOW_DRAIN;
+      default:
+        return FLOW_NONE;
+    }
+  }
+
+
+  uint8_t count_flows(const FLOW_T *flow, FLOW_T direction) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      if (flow[i] == direction) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+
+  //
+  // Decide which resting columns may begin a move.
+  //   flow    - flow in progress on each column
+  //   pending - signed move needed by each resting column, 0 if none
+  //   grant   - set true for each column allowed to start
+  //
+  void select_moves(const FLOW_T *flow, const int16_t *pending, bool *grant, PLAN_STRATEGY_T strategy) {
+    uint8_t fills = count_flows(flow, FLOW_FILL);
+    uint8_t drains = count_flows(flow, FLOW_DRAIN);
+
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      grant[i] = false;
+    }
+
+    switch (strategy) {
+      case PLAN_SIMULTANEOUS:
+        for (uint8_t i = 0; i < _num_columns; i++) {
+          grant[i] = (pending[i] != 0);
+        }
+        break;
+
+      case PLAN_SEQUENTIAL:
+        if ((fills + drains) == 0) {
+          int8_t largest = find_largest_move(pending, 0);
+          if (largest >= 0) {
+            grant[largest] = true;
+          }
+        }
+        break;
+
+      case PLAN_SHARED_PATH:
+      default:
+        if (fills == 0) {
+          int8_t largest = find_largest_move(pending, 1);
+          if (largest >= 0) {
+            grant[largest] = true;
+          }
+        }
+        if (drains == 0) {
+          int8_t largest = find_largest_move(pending, -1);
+          if (largest >= 0) {
+            grant[largest] = true;
+          }
+        }
+        break;
+    }
+  }
+
+
+  //
+  // Find the column with the largest pending move.  Direction 1 for fills only,
+  // -1 for drains only, 0 for either.  Returns -1 if there is no pending move.
+  //
+  int8_t find_largest_move(const int16_t *pending, int8_t direction) {
+    int8_t largest = -1;
+    int16_t largest_size = 0;
+
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      if ((pending[i] == 0) || ((direction > 0) && (pending[i] < 0)) || ((direction < 0) && (pending[i] > 0))) {
+        continue;
+      }
+      if (abs(pending[i]) > largest_size) {
+        largest_size = abs(pending[i]);
+        largest = i;
+      }
+    }
+    return largest;
+  }
+
+
+  //
+  // Flow rate for a direction with a number of concurrent flows sharing the path.
+  // Prefer a direct measurement, then a scaled single flow measurement, then the defaults.
+  //
+  uint32_t model_rate_um_per_sec(FLOW_T direction, uint8_t sharing) {
+    uint8_t d = (direction == FLOW_FILL) ? 0 : 1;
+    if (sharing < 1) {
+      sharing = 1;
+    }
+
+    if (_flow_rate_stats[d][sharing - 1].Get_Count() > 0) {
+      return _flow_rate_stats[d][sharing - 1].Get_Mean();
+    }
+
+    uint32_t single_rate = (d == 0) ? DEFAULT_FILL_RATE_UM_PER_SEC : DEFAULT_DRAIN_RATE_UM_PER_SEC;
+    if (_flow_rate_stats[d][0].Get_Count() > 0) {
+      single_rate = _flow_rate_stats[d][0].Get_Mean();
+    }
+    return (single_rate * 100) / (100 + DEFAULT_SHARED_PATH_PENALTY_PERCENT * (sharing - 1));
+  }
+
+
+  //
+  // Settle time of a column, measured if available.
+  //
+  uint32_t model_settle_msec(uint8_t column) {
+    if (_columns[column]->Get_Settle_Stats()->Get_Count() > 0) {
+      return _columns[column]->Get_Settle_Stats()->Get_Mean();
+    }
+    return MODEL_SETTLE_MSEC;
+  }
+
+
+  //
+  // Measure the average flow rate of each regulated move and file it by the peak path sharing seen.
+  //
+  void track_flow_rates(const FLOW_T *flow) {
+    uint8_t fills = count_flows(flow, FLOW_FILL);
+    uint8_t drains = count_flows(flow, FLOW_DRAIN);
+
+    for (uint8_t i = 0; i < _num_columns; i++) {
+      if (flow[i] != _move_flow[i]) {
+        if (_move_flow[i] != FLOW_NONE) {
+          // A move just ended, compute its rate
+          uint32_t duration = millis() - _move_start_msec[i];
+          uint16_t elevation = _columns[i]->Get_Elevation_Reading_MM();
+          uint32_t distance = abs((int32_t)elevation - (int32_t)_move_start_elevation[i]);
+
+          if ((duration >= MIN_RATE_SAMPLE_MSEC) && (_move_peak_sharing[i] > 0)) {
+            uint8_t d = (_move_flow[i] == FLOW_FILL) ? 0 : 1;
+            _flow_rate_stats[d][_move_peak_sharing[i] - 1].Add((distance * 1000000UL) / duration);
+          }
+        }
+
+        if (flow[i] != FLOW_NONE) {
+          // A move just started
+          _move_start_elevation[i] = _columns[i]->Get_Elevation_Reading_MM();
+          _move_start_msec[i] = millis();
+          _move_peak_sharing[i] = 0;
+        }
+        _move_flow[i] = flow[i];
+      }
+
+      if (flow[i] != FLOW_NONE) {
+        uint8_t sharing = (flow[i] == FLOW_FILL) ? fills : drains;
+        if (sharing > _move_peak_sharing[i]) {
+          _move_peak_sharing[i] = sharing;
+        }
+      }
+    }
+  }
+
+
+  //
+  // Time each transition from the first disturbance until every column is resting in deadband.
+  //
+  void track_transition(bool all_at_rest) {
+    if (!_transition_active && !all_at_rest) {
+      _transition_active = true;
+      _transition_strategy = _strategy;
+      _transition_elapsed = 0;
+    } else if (_transition_active && all_at_rest) {
+      _transition_active = false;
+      _last_transition_msec = _transition_elapsed;
+      _transition_stats[_transition_strategy].Add(_last_transition_msec);
+
+      if (_logging_enable) {
+        Serial.print("PLANNER: ");
+        Serial.print(Get_Strategy_Name(_transition_strategy));
+        Serial.print(" transition took ");
+        Serial.print(_last_transition_msec);
+        Serial.println(" msec");
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,467 @@
+/*
+ * Palette Canvas class for the Aqua Clock
+ *
+ * An Adafruit GFX canvas that stores 4 bits per pixel, an index into a palette of up to 16 RGB565
+ * colors.  The UI only draws with a handful of colors so the 128x128 frame takes 8 KB instead of the
+ * 32 KB of a GFXcanvas16.  Pixels are only expanded to RGB565 a line at a time while being streamed
+ * to the display, through a table that turns each byte into its two RGB565 pixels.
+ * The palette starts with the UI colors.  Other colors are added as they are drawn until the palette
+ * is full, after which they are drawn with the nearest palette color.
+ * Text in the classic font at sizes 1 and 2 is copied from the pre-rasterized glyphs of the glyph atlas
+ * instead of being drawn a pixel at a time, two pixels per byte through a shade to color index table.
+ * Anti-aliased atlas images are drawn white on black through the gray ramp that follows the UI colors,
+ * so their partly covered pixels keep their shade.
+ * Rotation is not supported, the canvas is always drawn in its native orientation.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef PALETTE_CANVAS_H
+#define PALETTE_CANVAS_H
+
+#include <Arduino.h>
+
+#include <Adafruit_GFX.h>
+
+#include "GlyphAtlas.h"
+
+class PaletteCanvas : public Adafruit_GFX {
+public:
+
+  static constexpr uint8_t PALETTE_SIZE = 16;
+
+private:
+
+  // Black (index 0, the cleared screen), blue, red, green, cyan, magenta, yellow, white, then the grays
+  // in between black and white for anti-aliased images
+  static constexpr uint8_t NUM_UI_COLORS = 8;
+  static constexpr uint8_t INDEX_WHITE = 7;
+  static constexpr uint8_t RAMP_GRAYS = 7;
+  static constexpr uint8_t NUM_DEFAULT_COLORS = NUM_UI_COLORS + RAMP_GRAYS;
+
+  uint8_t *_buffer;
+  int16_t _bytes_per_line;
+
+  uint16_t _palette[PALETTE_SIZE];
+  uint8_t _palette_count = 0;
+  uint32_t _palette_misses = 0;
+
+  // Two RGB565 pixels for every byte of the buffer, high nibble first
+  uint32_t _expand_table[256];
+
+  // Last color looked up, most drawing repeats the same color
+  uint16_t _last_color = 0;
+  uint8_t _last_index = 0;
+
+  // Glyph shade pairs to color index pairs for the last text colors
+  bool _glyph_atlas_enable = true;
+  uint8_t _shade_table[256];
+  int16_t _shade_color_index = -1;
+  int16_t _shade_bg_index = -1;
+
+  // Anti-aliased shade pairs to gray ramp index pairs
+  uint8_t _smooth_table[256];
+
+public:
+
+  PaletteCanvas(int16_t width, int16_t height)
+    : Adafruit_GFX(width, height) {
+    _bytes_per_line = (width + 1) / 2;
+    _buffer = (uint8_t *)malloc(_bytes_per_line * height);
+    if (_buffer != NULL) {
+      memset(_buffer, 0, _bytes_per_line * height);
+    }
+
+    const uint16_t default_colors[NUM_UI_COLORS] = { 0x0000, 0x001F, 0xF800, 0x07E0, 0x07FF, 0xF81F, 0xFFE0, 0xFFFF };
+    for (uint8_t i = 0; i < NUM_UI_COLORS; i++) {
+      _palette[i] = default_colors[i];
+    }
+    // Gray k of RAMP_GRAYS + 1 steps from black to white
+    for (uint8_t k = 1; k <= RAMP_GRAYS; k++) {
+      uint16_t red_blue = 31 * k / (RAMP_GRAYS + 1);
+      uint16_t green = 63 * k / (RAMP_GRAYS + 1);
+      _palette[NUM_UI_COLORS + k - 1] = (red_blue << 11) | (green << 5) | red_blue;
+    }
+    _palette_count = NUM_DEFAULT_COLORS;
+    build_expand_table();
+    build_smooth_table();
+  }
+
+
+  ~PaletteCanvas() {
+    free(_buffer);
+  }
+
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if ((_buffer == NULL) || (x < 0) || (y < 0) || (x >= width()) || (y >= height())) {
+      return;
+    }
+    set_index(x, y, color_index(color));
+  }
+
+
+  void fillScreen(uint16_t color) override {
+    if (_buffer != NULL) {
+      uint8_t index = color_index(color);
+      memset(_buffer, (index << 4) | index, _bytes_per_line * height());
+    }
+  }
+
+
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    fillRect(x, y, w, 1, color);
+  }
+
+
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    fillRect(x, y, 1, h, color);
+  }
+
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    // Clip to the canvas
+    if (w < 0) {
+      x += w + 1;
+      w = -w;
+    }
+    if (h < 0) {
+      y += h + 1;
+      h = -h;
+    }
+    if (x < 0) {
+      w += x;
+      x = 0;
+    }
+    if (y < 0) {
+      h += y;
+      y = 0;
+    }
+    if (x + w > width()) {
+      w = width() - x;
+    }
+    if (y + h > height()) {
+      h = height() - y;
+    }
+    if ((_buffer == NULL) || (w <= 0) || (h <= 0)) {
+      return;
+    }
+
+    uint8_t index = color_index(color);
+    uint8_t pair = (index << 4) | index;
+    for (int16_t line = y; line < y + h; line++) {
+      int16_t col = x;
+      int16_t end = x + w;
+      // Odd leading pixel, then whole bytes, then an odd trailing pixel
+      if (col & 1) {
+        set_index(col++, line, index);
+      }
+      int16_t bytes = (end - col) / 2;
+      if (bytes > 0) {
+        memset(&_buffer[line * _bytes_per_line + col / 2], pair, bytes);
+        col += bytes * 2;
+      }
+      if (col < end) {
+        set_index(col, line, index);
+      }
+    }
+  }
+
+
+  using Adafruit_GFX::write;
+
+  //
+  // Print a character.  Opaque classic font text at the atlas sizes is copied from the glyph atlas,
+  // everything else is drawn by Adafruit GFX.
+  //
+  size_t write(uint8_t c) override {
+    uint8_t size = textsize_x;
+    if (!_glyph_atlas_enable || (gfxFont != NULL) || (textsize_y != size) || (size > ATLAS_MAX_TEXT_SIZE)
+        || (textcolor == textbgcolor)) {
+      return Adafruit_GFX::write(c);
+    }
+
+    if (c == '\n') {
+      cursor_x = 0;
+      cursor_y += size * ATLAS_CELL_HEIGHT;
+    } else if (c != '\r') {
+      if ((c < ATLAS_FIRST_CHAR) || (c > ATLAS_LAST_CHAR)) {
+        return Adafruit_GFX::write(c);
+      }
+      if (wrap && ((cursor_x + size * ATLAS_CELL_WIDTH) > _width)) {
+        cursor_x = 0;
+        cursor_y += size * ATLAS_CELL_HEIGHT;
+      }
+      const uint8_t *glyph = (size == 1) ? ATLAS_TEXT_1X[c - ATLAS_FIRST_CHAR] : ATLAS_TEXT_2X[c - ATLAS_FIRST_CHAR];
+      blit(cursor_x, cursor_y, size * ATLAS_CELL_WIDTH, size * ATLAS_CELL_HEIGHT, glyph, (size * ATLAS_CELL_WIDTH + 1) / 2, 0,
+           shade_table(textcolor, textbgcolor));
+      cursor_x += size * ATLAS_CELL_WIDTH;
+    }
+    return 1;
+  }
+
+
+  //
+  // Copy an image of palette indexes, two pixels per byte like the canvas.
+  //
+  void Blit_Indexes(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *image) {
+    blit(x, y, w, h, image, (w + 1) / 2, 0, NULL);
+  }
+
+
+  //
+  // Copy a window of another palette canvas.  Both canvases must hold the same palette.
+  //
+  void Blit_Canvas(int16_t x, int16_t y, PaletteCanvas *source, int16_t source_x, int16_t source_y, int16_t w, int16_t h) {
+    if ((source->getBuffer() == NULL) || (source_x < 0) || (source_y < 0) || (source_x + w > source->width())
+        || (source_y + h > source->height())) {
+      return;
+    }
+    blit(x, y, w, h, &source->getBuffer()[source_y * source->Get_Bytes_Per_Line()], source->Get_Bytes_Per_Line(), source_x, NULL);
+  }
+
+
+  //
+  // Draw an image of glyph shades in a foreground and background color.
+  //
+  void Blit_Shades(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *image, uint16_t color, uint16_t bg) {
+    blit(x, y, w, h, image, (w + 1) / 2, 0, shade_table(color, bg));
+  }
+
+
+  //
+  // Draw an image of anti-aliased shades white on black.
+  //
+  void Blit_Smooth(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *image) {
+    blit(x, y, w, h, image, (w + 1) / 2, 0, _smooth_table);
+  }
+
+
+  // Copy text from the glyph atlas (true) or draw it with Adafruit GFX (false)
+  void Set_Glyph_Atlas_Enable(bool enable) {
+    _glyph_atlas_enable = enable;
+  }
+
+
+  bool Is_Glyph_Atlas_Enabled() {
+    return _glyph_atlas_enable;
+  }
+
+
+  uint8_t *getBuffer() const {
+    return _buffer;
+  }
+
+
+  int16_t Get_Bytes_Per_Line() {
+    return _bytes_per_line;
+  }
+
+
+  //
+  // Expand a run of pixels of a line to RGB565.  Runs starting on an even pixel use the byte table.
+  //
+  void Expand_Line(int16_t x, int16_t y, int16_t w, uint16_t *out) {
+    const uint8_t *line = &_buffer[y * _bytes_per_line];
+    int16_t i = 0;
+    if ((x & 1) == 0) {
+      const uint8_t *pairs = &line[x / 2];
+      for (; i + 1 < w; i += 2) {
+        uint32_t two = _expand_table[*pairs++];
+        out[i] = two >> 16;
+        out[i + 1] = two & 0xFFFF;
+      }
+    }
+    for (; i < w; i++) {
+      out[i] = _palette[get_index(x + i, y)];
+    }
+  }
+
+
+  uint8_t Get_Palette_Count() {
+    return _palette_count;
+  }
+
+
+  // Colors drawn with the nearest palette entry because the palette was full
+  uint32_t Get_Palette_Misses() {
+    return _palette_misses;
+  }
+
+
+protected:
+
+  void set_index(int16_t x, int16_t y, uint8_t index) {
+    uint8_t &pair = _buffer[y * _bytes_per_line + x / 2];
+    if (x & 1) {
+      pair = (pair & 0xF0) | index;
+    } else {
+      pair = (pair & 0x0F) | (index << 4);
+    }
+  }
+
+
+  uint8_t get_index(int16_t x, int16_t y) {
+    uint8_t pair = _buffer[y * _bytes_per_line + x / 2];
+    return (x & 1) ? (pair & 0x0F) : (pair >> 4);
+  }
+
+
+  //
+  // Palette index of a color, added to the palette if there is room.
+  //
+  uint8_t color_index(uint16_t color) {
+    if (color == _last_color) {
+      return _last_index;
+    }
+
+    uint8_t index = PALETTE_SIZE;
+    for (uint8_t i = 0; i < _palette_count; i++) {
+      if (_palette[i] == color) {
+        index = i;
+        break;
+      }
+    }
+    if (index == PALETTE_SIZE) {
+      if (_palette_count < PALETTE_SIZE) {
+        index = _palette_count++;
+        _palette[index] = color;
+        build_expand_table();
+      } else {
+        index = nearest_index(color);
+        _palette_misses++;
+      }
+    }
+
+    _last_color = color;
+    _last_index = index;
+    return index;
+  }
+
+
+  uint8_t nearest_index(uint16_t color) {
+    uint8_t best = 0;
+    uint32_t best_distance = 0xFFFFFFFF;
+    for (uint8_t i = 0; i < _palette_count; i++) {
+      int32_t dr = (int32_t)(color >> 11) - (_palette[i] >> 11);
+      int32_t dg = (int32_t)((color >> 5) & 0x3F) - ((_palette[i] >> 5) & 0x3F);
+      int32_t db = (int32_t)(color & 0x1F) - (_palette[i] & 0x1F);
+      // Green has twice the resolution of red and blue
+      uint32_t distance = 4 * dr * dr + dg * dg + 4 * db * db;
+      if (distance < best_distance) {
+        best_distance = distance;
+        best = i;
+      }
+    }
+    return best;
+  }
+
+
+  //
+  // Copy a window of an image into the canvas, clipped.  The window starts image_x pixels into each image
+  // line.  Runs of pixels that line up with the canvas bytes are copied whole, through the table of index
+  // pairs when there is one.  Index runs a pixel out of line are shifted a byte at a time.
+  //
+  void blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint8_t *image, int16_t image_bytes_per_line,
+            int16_t image_x, const uint8_t *table) {
+    int16_t first_col = (x < 0) ? -x : 0;
+    int16_t first_row = (y < 0) ? -y : 0;
+    int16_t end_col = (x + w > width()) ? width() - x : w;
+    int16_t end_row = (y + h > height()) ? height() - y : h;
+    if ((_buffer == NULL) || (first_col >= end_col) || (first_row >= end_row)) {
+      return;
+    }
+
+    for (int16_t row = first_row; row < end_row; row++) {
+      const uint8_t *src = &image[row * image_bytes_per_line];
+      int16_t line = y + row;
+      int16_t col = first_col;
+      bool aligned = ((x & 1) == (image_x & 1));
+      if (aligned || (table == NULL)) {
+        // Lead in to a whole canvas byte
+        if ((x + col) & 1) {
+          blit_pixel(x + col, line, src, image_x + col, table);
+          col++;
+        }
+        uint8_t *dst = &_buffer[line * _bytes_per_line + (x + col) / 2];
+        const uint8_t *pairs = &src[(image_x + col) / 2];
+        int16_t bytes = (end_col - col) / 2;
+        if (!aligned) {
+          for (int16_t i = 0; i < bytes; i++) {
+            dst[i] = (uint8_t)(pairs[i] << 4) | (pairs[i + 1] >> 4);
+          }
+        } else if (table == NULL) {
+          memcpy(dst, pairs, bytes);
+        } else {
+          for (int16_t i = 0; i < bytes; i++) {
+            dst[i] = table[pairs[i]];
+          }
+        }
+        col += bytes * 2;
+      }
+      for (; col < end_col; col++) {
+        blit_pixel(x + col, line, src, image_x + col, table);
+      }
+    }
+  }
+
+
+  void blit_pixel(int16_t x, int16_t y, const uint8_t *src, int16_t image_col, const uint8_t *table) {
+    uint8_t value = (image_col & 1) ? (src[image_col / 2] & 0x0F) : (src[image_col / 2] >> 4);
+    set_index(x, y, (table == NULL) ? value : (table[value] & 0x0F));
+  }
+
+
+  //
+  // Table from a byte of two glyph shades to the byte of their two color indexes.
+  //
+  const uint8_t *shade_table(uint16_t color, uint16_t bg) {
+    uint8_t color_idx = color_index(color);
+    uint8_t bg_idx = color_index(bg);
+    if ((color_idx != _shade_color_index) || (bg_idx != _shade_bg_index)) {
+      for (uint16_t pair = 0; pair < 256; pair++) {
+        uint8_t high = ((pair >> 4) >= 8) ? color_idx : bg_idx;
+        uint8_t low = ((pair & 0x0F) >= 8) ? color_idx : bg_idx;
+        _shade_table[pair] = (high << 4) | low;
+      }
+      _shade_color_index = color_idx;
+      _shade_bg_index = bg_idx;
+    }
+    return _shade_table;
+  }
+
+
+  //
+  // Table from a byte of two anti-aliased shades to the byte of their two gray ramp indexes.
+  //
+  void build_smooth_table() {
+    uint8_t ramp[ATLAS_SHADE_FOREGROUND + 1];
+    for (uint8_t shade = 0; shade <= ATLAS_SHADE_FOREGROUND; shade++) {
+      // Nearest of the RAMP_GRAYS + 2 levels, black and white at the ends
+      uint8_t level = (shade * (RAMP_GRAYS + 1) + ATLAS_SHADE_FOREGROUND / 2) / ATLAS_SHADE_FOREGROUND;
+      if (level == 0) {
+        ramp[shade] = 0;
+      } else if (level > RAMP_GRAYS) {
+        ramp[shade] = INDEX_WHITE;
+      } else {
+        ramp[shade] = NUM_UI_COLORS + level - 1;
+      }
+    }
+    for (uint16_t pair = 0; pair < 256; pair++) {
+      _smooth_table[pair] = (ramp[pair >> 4] << 4) | ramp[pair & 0x0F];
+    }
+  }
+
+
+  void build_expand_table() {
+    for (uint16_t pair = 0; pair < 256; pair++) {
+      uint8_t high = pair >> 4;
+      uint8_t low = pair & 0x0F;
+      uint16_t first = (high < _palette_count) ? _palette[high] : 0;
+      uint16_t second = (low < _palette_count) ? _palette[low] : 0;
+      _expand_table[pair] = ((uint32_t)first << 16) | second;
+    }
+  }
+};
+
+#endif
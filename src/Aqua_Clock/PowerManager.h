@@ -0,0 +1,417 @@
+/*
+ * Power Manager class for the Aqua Clock
+ *
+ * Puts the clock into a low power state during the sleep window of the ClockManager.  Once the
+ * columns have parked at the sleep elevation and the water has been quiet for a while the range
+ * sensors stop ranging, the OLED panel is turned off and the CPU clock is lowered.  The main loop then
+ * only polls the console, the RTC and the keys, spending the time between the polls in ESP32 light sleep.
+ *
+ * Neither the RV-8803 interrupt nor the SX1509 interrupt is wired to the ESP32, so the light sleep is
+ * woken by a timer slice and by the UART for the console.  The SX1509 still latches the key presses
+ * made during a slice, the keys are checked for one after every slice.  The clock resumes when the sleep window ends or a key is pressed and stays awake while the keys are in use.
+ * A UART wake loses the characters that woke it, so the light sleep is held off for a while after any
+ * console activity; send an empty line first to wake the console.
+ *
+ * There is no current sensing on the board.  The current draw is estimated from the time spent in each
+ * state and the typical currents of the parts, replace the budget constants with bench readings.
+ * The time to resume is measured from the wake trigger until every range sensor has a fresh reading.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <elapsedMillis.h>
+#include <esp_sleep.h>
+#include <driver/uart.h>
+
+#include <SparkFun_I2C_Mux_Arduino_Library.h>
+
+#include "ClockManager.h"
+#include "ColumnConfig.h"
+#include "Console.h"
+#include "RangeUtil.h"
+#include "Stats.h"
+#include "UIManager.h"
+
+
+class PowerManager {
+public:
+
+  typedef enum {
+    POWER_AWAKE,
+    POWER_SLEEPING,
+    POWER_RESUMING
+  } POWER_STATE_T;
+
+private:
+
+  // Water must be still this long in the sleep window before sleeping
+  static constexpr uint32_t QUIET_BEFORE_SLEEP_MSEC = 30000;
+  // Stay awake this long after the last key press
+  static constexpr uint32_t KEY_AWAKE_MSEC = 60000;
+  // No light sleep this long after console activity
+  static constexpr uint32_t CONSOLE_AWAKE_MSEC = 30000;
+  // Light sleep slice, the SX1509 latches a key press made during one
+  static constexpr uint32_t LIGHT_SLEEP_SLICE_MSEC = 100;
+  // Give up waiting for the sensors on resume
+  static constexpr uint32_t RESUME_TIMEOUT_MSEC = 1000;
+
+  static constexpr uint32_t AWAKE_CPU_MHZ = 240;
+  static constexpr uint32_t SLEEP_CPU_MHZ = 80;  // Lowest clock that keeps the 80 MHz APB for the UART and I2C
+
+  // Typical current budget in mA
+  static constexpr float BOARD_BASE_MA = 5.0;          /* Regulators, RTC, mux, IO expander */
+  static constexpr float CPU_240_MHZ_MA = 50.0;        /* ESP32 running, radio off */
+  static constexpr float CPU_80_MHZ_MA = 22.0;
+  static constexpr float CPU_LIGHT_SLEEP_MA = 0.8;
+  static constexpr float SENSOR_RANGING_MA = 16.0;     /* Each VL53L1X */
+  static constexpr float SENSOR_STANDBY_MA = 0.005;
+  static constexpr float DISPLAY_ON_MA = 20.0;         /* SSD1351 showing the clock screen */
+  static constexpr float DISPLAY_OFF_MA = 0.5;
+
+  ClockManager *_clock;
+  UIManager *_ui;
+  Console *_console;
+  RangeUtil **_ranges;
+  QWIICMUX *_mux;
+
+  POWER_STATE_T _state = POWER_AWAKE;
+  bool _enable = true;
+  bool _light_sleep_enable = true;
+  bool _water_busy = false;
+  elapsedMillis _quiet_msec;
+  elapsedMillis _time_in_state_msec;
+
+  // Resume measurement
+  uint32_t _resume_start_usec = 0;
+  uint32_t _resume_reading_counts[NUM_COLUMNS];
+  RunningStats _resume_usec_stats;
+  uint32_t _resume_timeouts = 0;
+
+  // Residency
+  uint64_t _state_msec[3] = { 0, 0, 0 };
+  uint64_t _light_sleep_usec = 0;
+  uint32_t _sleep_count = 0;
+  uint32_t _key_wake_count = 0;
+  uint32_t _uart_wake_count = 0;
+  uint32_t _light_sleep_count = 0;
+  uint32_t _uart_wake_msec = 0;
+
+public:
+
+  PowerManager(ClockManager *clock, UIManager *ui, Console *console, RangeUtil **ranges, QWIICMUX *mux) {
+    _clock = clock;
+    _ui = ui;
+    _console = console;
+    _ranges = ranges;
+    _mux = mux;
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _resume_reading_counts[i] = 0;
+    }
+  }
+
+
+  //
+  // Report if any water is moving, the pump is running or a column move is planned.
+  //
+  void Set_Water_Busy(bool busy) {
+    _water_busy = busy;
+    if (busy) {
+      _quiet_msec = 0;
+    }
+  }
+
+
+  //
+  // Decide when to sleep and when to resume.
+  //
+  void Update() {
+    switch (_state) {
+      case POWER_AWAKE:
+        if (sleep_allowed() && (_quiet_msec >= QUIET_BEFORE_SLEEP_MSEC)) {
+          enter_sleep();
+        }
+        break;
+
+      case POWER_SLEEPING:
+        if (!_enable || !_clock->Is_Sleep_Time()) {
+          start_resume();
+        } else if (_ui->Get_Key_Idle_MSEC() < LIGHT_SLEEP_SLICE_MSEC * 2) {
+          _key_wake_count++;
+          start_resume();
+        }
+        break;
+
+      case POWER_RESUMING:
+        if (sensors_ready()) {
+          _resume_usec_stats.Add(micros() - _resume_start_usec);
+          set_state(POWER_AWAKE);
+        } else if (_time_in_state_msec >= RESUME_TIMEOUT_MSEC) {
+          _resume_timeouts++;
+          Serial.println("ERROR: Range sensors did not resume!");
+          set_state(POWER_AWAKE);
+        }
+        break;
+    }
+  }
+
+
+  //
+  // Spend the rest of a loop pass while sleeping.  Light sleeps for one slice, or yields for one slice
+  // after console activity so the console stays responsive.  Then picks up a key tapped during the slice.
+  //
+  void Idle() {
+    if (_state != POWER_SLEEPING) {
+      return;
+    }
+
+    if (!_light_sleep_enable || (Serial.available() > 0)
+        || ((millis() - _console->GetLineRxMsec()) < CONSOLE_AWAKE_MSEC)
+        || ((millis() - _uart_wake_msec) < CONSOLE_AWAKE_MSEC)) {
+      delay(LIGHT_SLEEP_SLICE_MSEC);
+      _ui->Get_Key_Pad()->Wake_Scan();
+      return;
+    }
+
+    // Let the console output drain before the UART clock stops
+    Serial.flush();
+    esp_sleep_enable_timer_wakeup((uint64_t)LIGHT_SLEEP_SLICE_MSEC * 1000ULL);
+    uint32_t start_usec = micros();
+    esp_light_sleep_start();
+    _light_sleep_usec += (uint32_t)(micros() - start_usec);
+    _light_sleep_count++;
+
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_UART) {
+      // Treat the wake as console activity, the line that woke it was lost
+      _uart_wake_count++;
+      _uart_wake_msec = millis();
+    }
+    _ui->Get_Key_Pad()->Wake_Scan();
+  }
+
+
+  POWER_STATE_T Get_State() {
+    return _state;
+  }
+
+
+  bool Is_Sleeping() {
+    return _state == POWER_SLEEPING;
+  }
+
+
+  // Water may be regulated, the sensors are ranging
+  bool Is_Awake() {
+    return _state == POWER_AWAKE;
+  }
+
+
+  void Set_Enable(bool enable) {
+    _enable = enable;
+  }
+
+
+  bool Is_Enabled() {
+    return _enable;
+  }
+
+
+  void Set_Light_Sleep_Enable(bool enable) {
+    _light_sleep_enable = enable;
+  }
+
+
+  bool Is_Light_Sleep_Enabled() {
+    return _light_sleep_enable;
+  }
+
+
+  //
+  // Estimated average current in mA while awake and while sleeping, from the state residency.
+  //
+  float Get_Awake_MA() {
+    return BOARD_BASE_MA + CPU_240_MHZ_MA + (SENSOR_RANGING_MA * NUM_COLUMNS) + DISPLAY_ON_MA;
+  }
+
+
+  float Get_Sleep_MA() {
+    float duty = get_light_sleep_duty();
+    return BOARD_BASE_MA + (duty * CPU_LIGHT_SLEEP_MA) + ((1.0f - duty) * CPU_80_MHZ_MA)
+           + (SENSOR_STANDBY_MA * NUM_COLUMNS) + DISPLAY_OFF_MA;
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Sleep mode: ");
+    Serial.print(_enable ? "ON" : "OFF");
+    Serial.print("  Light sleep: ");
+    Serial.print(_light_sleep_enable ? "ON" : "OFF");
+    Serial.print("  State: ");
+    Serial.println(state_name(_state));
+    Serial.print("   Time awake: ");
+    Serial.print((uint32_t)(get_state_msec(POWER_AWAKE) / 1000));
+    Serial.print(" sec  sleeping: ");
+    Serial.print((uint32_t)(get_state_msec(POWER_SLEEPING) / 1000));
+    Serial.print(" sec  resuming: ");
+    Serial.print((uint32_t)get_state_msec(POWER_RESUMING));
+    Serial.println(" msec");
+    Serial.print("   Sleeps: ");
+    Serial.print(_sleep_count);
+    Serial.print("  Key wakes: ");
+    Serial.print(_key_wake_count);
+    Serial.print("  Light sleeps: ");
+    Serial.print(_light_sleep_count);
+    Serial.print("  UART wakes: ");
+    Serial.print(_uart_wake_count);
+    Serial.print("  Light sleep duty: ");
+    Serial.print(get_light_sleep_duty() * 100.0f, 1);
+    Serial.println("%");
+    Serial.print("   Estimated current, awake: ");
+    Serial.print(Get_Awake_MA(), 1);
+    Serial.print(" mA  sleeping: ");
+    Serial.print(Get_Sleep_MA(), 1);
+    Serial.print(" mA  average: ");
+    Serial.print(get_average_ma(), 1);
+    Serial.println(" mA");
+    Serial.print("   Resume usec: ");
+    _resume_usec_stats.Print("");
+    Serial.print("  timeouts: ");
+    Serial.println(_resume_timeouts);
+  }
+
+
+  void Reset_Stats() {
+    for (uint8_t i = 0; i < 3; i++) {
+      _state_msec[i] = 0;
+    }
+    _time_in_state_msec = 0;
+    _light_sleep_usec = 0;
+    _sleep_count = 0;
+    _key_wake_count = 0;
+    _uart_wake_count = 0;
+    _light_sleep_count = 0;
+    _resume_usec_stats.Reset();
+    _resume_timeouts = 0;
+  }
+
+
+protected:
+
+  //
+  // Sleep only in clock mode with nothing overridden, no recent keys and the water at rest.
+  //
+  bool sleep_allowed() {
+    if (!_enable || !_clock->Is_Sleep_Time() || _water_busy
+        || (_ui->Get_Operating_Mode() != UIManager::OPERATING_MODE_CLOCK)
+        || (_ui->Get_Key_Idle_MSEC() < KEY_AWAKE_MSEC)) {
+      _quiet_msec = 0;
+      return false;
+    }
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      if (_ui->Get_Column_Override_Setpoint_Enable(i)) {
+        _quiet_msec = 0;
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void enter_sleep() {
+    Serial.println("POWER: Entering sleep");
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _mux->setPort(COLUMN_TABLE[i].mux_port);
+      _ranges[i]->Stop_Ranging();
+    }
+    _ui->Set_Display_Enable(false);
+    _ui->Get_Key_Pad()->Arm_Wake_Latch();
+    digitalWrite(LED_BUILTIN, LOW);
+    Serial.flush();
+    setCpuFrequencyMhz(SLEEP_CPU_MHZ);
+
+    // The console wakes the light sleep, the first characters are lost
+    uart_set_wakeup_threshold(UART_NUM_0, 3);
+    esp_sleep_enable_uart_wakeup(0);
+
+    _sleep_count++;
+    set_state(POWER_SLEEPING);
+  }
+
+
+  void start_resume() {
+    _resume_start_usec = micros();
+    setCpuFrequencyMhz(AWAKE_CPU_MHZ);
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _mux->setPort(COLUMN_TABLE[i].mux_port);
+      _resume_reading_counts[i] = _ranges[i]->Get_Reading_Count();
+      _ranges[i]->Start_Ranging();
+    }
+    _ui->Set_Display_Enable(true);
+    _quiet_msec = 0;
+    set_state(POWER_RESUMING);
+    Serial.println("POWER: Resuming");
+  }
+
+
+  // Every working sensor has a reading taken after the restart
+  bool sensors_ready() {
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      if ((_ranges[i]->Get_State() == RangeUtil::RANGE_SENSOR_WORKING)
+          && (_ranges[i]->Get_Reading_Count() == _resume_reading_counts[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  void set_state(POWER_STATE_T state) {
+    _state_msec[_state] += (uint32_t)_time_in_state_msec;
+    _time_in_state_msec = 0;
+    _state = state;
+  }
+
+
+  uint64_t get_state_msec(POWER_STATE_T state) {
+    return _state_msec[state] + ((state == _state) ? (uint32_t)_time_in_state_msec : 0);
+  }
+
+
+  float get_light_sleep_duty() {
+    uint64_t sleeping_msec = get_state_msec(POWER_SLEEPING);
+    if (sleeping_msec == 0) {
+      return 0;
+    }
+    float duty = (float)(_light_sleep_usec / 1000) / (float)sleeping_msec;
+    return (duty > 1.0f) ? 1.0f : duty;
+  }
+
+
+  float get_average_ma() {
+    uint64_t sleeping_msec = get_state_msec(POWER_SLEEPING);
+    uint64_t total_msec = sleeping_msec + get_state_msec(POWER_AWAKE) + get_state_msec(POWER_RESUMING);
+    if (total_msec == 0) {
+      return Get_Awake_MA();
+    }
+    return ((Get_Sleep_MA() * sleeping_msec) + (Get_Awake_MA() * (total_msec - sleeping_msec))) / total_msec;
+  }
+
+
+  const char *state_name(POWER_STATE_T state) {
+    switch (state) {
+      case POWER_AWAKE:
+        return "AWAKE";
+      case POWER_SLEEPING:
+        return "SLEEPING";
+      case POWER_RESUMING:
+        return "RESUMING";
+      default:
+        return "UNKNOWN";
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,364 @@
+/*
+ * Pump run history for the Aqua Clock
+ *
+ * Keeps a record of the last pump runs in a fixed size ring so a slow change in the water transfer
+ * can be seen, such as fill times creeping up from a clogging filter or refills coming closer together
+ * from a leak.  Each record holds:
+ *   Run time      - Time the pump was driven to complete the fill, deferrals excluded.
+ *   Fill time     - Time from the start of the fill to the high mark edge, deferrals included.
+ *   Band          - Percent of the band between the marks the fill covered, 100 for a fill started at
+ *                   the low mark, less for a top up started from the estimated tank level.
+ *   Interval      - Time since the prior fill completed.
+ * Run and fill times are scaled to a whole band by the band covered, so the frequent top ups of the
+ * hourly schedule count alongside the low mark fills.  Top ups that covered less than MIN_BAND_PCT
+ * are too short to scale reliably and are left out.
+ * The records are summarized with a mean and a 95th percentile and the scaled run times are fitted
+ * with a line to predict how many runs remain before the fill timeout would be hit.
+ * The ring is saved to the ESP32 Preferences after each run so it survives a restart.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef PUMP_HISTORY_H
+#define PUMP_HISTORY_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "faults.h"
+
+
+class PumpHistory {
+public:
+
+  typedef enum {
+    PUMP_RUN_TIME,
+    PUMP_FILL_TIME,
+    PUMP_INTERVAL
+  } PUMP_RUN_FIELD_T;
+
+  static constexpr uint8_t HISTORY_SIZE = 32;
+
+  static constexpr uint8_t RUN_FLAG_FULL_BAND = 0x01; /* Fill started at the low mark */
+  static constexpr uint8_t RUN_FLAG_SOFT_DRIVE = 0x02;
+
+  static constexpr uint8_t MIN_BAND_PCT = 20; /* Smallest top up scaled into the summaries */
+
+  typedef struct {
+    uint32_t run_msec;
+    uint32_t fill_msec;
+    uint32_t interval_sec; /* 0 when there was no prior fill since startup */
+    uint8_t flags;
+    uint8_t band_pct; /* Part of the band between the marks that was filled */
+  } PUMP_RUN_RECORD_T;
+
+private:
+
+  // Non-volatile image of the ring.  Bump the version when the layout changes so an old image is dropped.
+  static constexpr uint8_t NVM_VERSION = 2;
+  typedef struct {
+    uint8_t version;
+    uint8_t head;
+    uint8_t count;
+    PUMP_RUN_RECORD_T records[HISTORY_SIZE];
+  } NVM_PUMP_HISTORY_T;
+
+  Preferences _preferences;
+  bool _nvm_ready = false;
+  NVM_PUMP_HISTORY_T _history;
+
+  // Predictive warning, raised when the p95 run time comes within the margin of the limit or the
+  // fitted trend reaches the limit within the warning horizon.
+  static constexpr uint8_t WARN_LIMIT_PCT = 75;
+  static constexpr uint8_t WARN_HORIZON_RUNS = 20;
+  static constexpr uint8_t MIN_TREND_RUNS = 6;
+
+public:
+
+  PumpHistory() {
+    clear_records();
+  }
+
+
+  //
+  // Open the non-volatile storage and restore the saved runs.
+  //
+  void Startup() {
+    if (!_preferences.begin("pumphist", false)) {
+      FAULT_SET(FAULT_NVM_FAIL);
+      Serial.println("ERROR: Failed to find Non-Volatile memory space for pump history!");
+      return;
+    }
+    _nvm_ready = true;
+
+    NVM_PUMP_HISTORY_T saved;
+    if ((_preferences.getBytesLength("runs") == sizeof(saved))
+        && (_preferences.getBytes("runs", &saved, sizeof(saved)) == sizeof(saved))
+        && (saved.version == NVM_VERSION) && (saved.head < HISTORY_SIZE) && (saved.count <= HISTORY_SIZE)) {
+      _history = saved;
+      Serial.print("Restored pump history: ");
+      Serial.print(_history.count);
+      Serial.println(" runs");
+    }
+  }
+
+
+  //
+  // Add a completed fill and save the ring.
+  //
+  void Record(uint32_t run_msec, uint32_t fill_msec, uint32_t interval_sec, uint8_t flags, uint8_t band_pct) {
+    PUMP_RUN_RECORD_T &record = _history.records[_history.head];
+    record.run_msec = run_msec;
+    record.fill_msec = fill_msec;
+    record.interval_sec = interval_sec;
+    record.flags = flags;
+    record.band_pct = (flags & RUN_FLAG_FULL_BAND) ? 100 : constrain(band_pct, (uint8_t)1, (uint8_t)100);
+
+    _history.head = (_history.head + 1) % HISTORY_SIZE;
+    if (_history.count < HISTORY_SIZE) {
+      _history.count++;
+    }
+    save();
+  }
+
+
+  void Clear() {
+    clear_records();
+    save();
+  }
+
+
+  uint8_t Get_Count() {
+    return _history.count;
+  }
+
+
+  //
+  // Record by age, 0 is the most recent run.
+  //
+  PUMP_RUN_RECORD_T Get_Record(uint8_t age) {
+    uint8_t index = (_history.head + HISTORY_SIZE - 1 - (age % HISTORY_SIZE)) % HISTORY_SIZE;
+    return _history.records[index];
+  }
+
+
+  //
+  // Mean and 95th percentile of a field over the ring.  Run and fill times are scaled to a whole band,
+  // intervals without a prior fill are skipped.
+  //
+  uint32_t Get_Mean(PUMP_RUN_FIELD_T field) {
+    uint32_t values[HISTORY_SIZE];
+    uint8_t n = collect(field, values);
+    if (n == 0) {
+      return 0;
+    }
+    uint64_t sum = 0;
+    for (uint8_t i = 0; i < n; i++) {
+      sum += values[i];
+    }
+    return (uint32_t)(sum / n);
+  }
+
+
+  uint32_t Get_P95(PUMP_RUN_FIELD_T field) {
+    uint32_t values[HISTORY_SIZE];
+    uint8_t n = collect(field, values);
+    if (n == 0) {
+      return 0;
+    }
+
+    // Insertion sort, the ring is small
+    for (uint8_t i = 1; i < n; i++) {
+      uint32_t value = values[i];
+      int8_t j = i - 1;
+      while ((j >= 0) && (values[j] > value)) {
+        values[j + 1] = values[j];
+        j--;
+      }
+      values[j + 1] = value;
+    }
+
+    // Nearest rank
+    uint8_t rank = (uint8_t)(((uint16_t)n * 95 + 99) / 100);
+    return values[rank - 1];
+  }
+
+
+  //
+  // Least squares slope of the whole band run times in msec per run, oldest to newest.
+  // Returns false if there are too few runs to fit.
+  //
+  bool Get_Run_Trend(float &slope_msec_per_run, float &latest_fit_msec) {
+    float sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    uint8_t n = 0;
+    for (int16_t age = _history.count - 1; age >= 0; age--) {
+      PUMP_RUN_RECORD_T record = Get_Record(age);
+      if (record.band_pct >= MIN_BAND_PCT) {
+        float x = n;
+        float y = whole_band_msec(record.run_msec, record);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        n++;
+      }
+    }
+    if (n < MIN_TREND_RUNS) {
+      return false;
+    }
+
+    float denominator = n * sum_xx - sum_x * sum_x;
+    if (denominator <= 0) {
+      return false;
+    }
+    slope_msec_per_run = (n * sum_xy - sum_x * sum_y) / denominator;
+    latest_fit_msec = (sum_y - slope_msec_per_run * sum_x) / n + slope_msec_per_run * (n - 1);
+    return true;
+  }
+
+
+  //
+  // Runs left before the fitted whole band run time reaches the limit, -1 if the trend is flat,
+  // falling or unknown.
+  //
+  int32_t Get_Runs_To_Limit(uint32_t limit_msec) {
+    float slope, latest;
+    if (!Get_Run_Trend(slope, latest) || (slope <= 0)) {
+      return -1;
+    }
+    if (latest >= limit_msec) {
+      return 0;
+    }
+    return (int32_t)((limit_msec - latest) / slope);
+  }
+
+
+  //
+  // Predict trouble with the fill before the limit is ever hit.
+  //
+  bool Is_Limit_Warning(uint32_t limit_msec) {
+    if (Get_P95(PUMP_RUN_TIME) >= (limit_msec / 100) * WARN_LIMIT_PCT) {
+      return true;
+    }
+    int32_t runs_left = Get_Runs_To_Limit(limit_msec);
+    return (runs_left >= 0) && (runs_left <= WARN_HORIZON_RUNS);
+  }
+
+
+  //
+  // Run time in msec at which a fill in progress is reported as running long.
+  //
+  uint32_t Get_Warn_MSEC(uint32_t limit_msec) {
+    return (limit_msec / 100) * WARN_LIMIT_PCT;
+  }
+
+
+  void Print_Summary(uint32_t limit_msec) {
+    Serial.print("   Runs: ");
+    Serial.print(_history.count);
+    Serial.print("/");
+    Serial.println(HISTORY_SIZE);
+    Serial.print("   Run time mean,p95: ");
+    Serial.print(Get_Mean(PUMP_RUN_TIME));
+    Serial.print(", ");
+    Serial.print(Get_P95(PUMP_RUN_TIME));
+    Serial.println(" ms");
+    Serial.print("   Fill time mean,p95: ");
+    Serial.print(Get_Mean(PUMP_FILL_TIME));
+    Serial.print(", ");
+    Serial.print(Get_P95(PUMP_FILL_TIME));
+    Serial.println(" ms");
+    Serial.print("   Interval mean,p95: ");
+    Serial.print(Get_Mean(PUMP_INTERVAL));
+    Serial.print(", ");
+    Serial.print(Get_P95(PUMP_INTERVAL));
+    Serial.println(" s");
+
+    float slope, latest;
+    Serial.print("   Run time trend: ");
+    if (Get_Run_Trend(slope, latest)) {
+      Serial.print(slope, 1);
+      Serial.print(" ms/run, runs to limit: ");
+      Serial.println(Get_Runs_To_Limit(limit_msec));
+    } else {
+      Serial.println("not enough runs");
+    }
+    Serial.print("   Limit warning: ");
+    Serial.println(Is_Limit_Warning(limit_msec) ? "YES" : "no");
+  }
+
+
+  //
+  // List the runs, newest first.
+  //
+  void Print_Records() {
+    Serial.println("   Age  Run ms  Fill ms  Interval s  Start  Band  Drive");
+    for (uint8_t age = 0; age < _history.count; age++) {
+      PUMP_RUN_RECORD_T record = Get_Record(age);
+      Serial.printf("   %3d  %6lu  %7lu  %10lu  %5s  %3u%%  %5s\n",
+                    age,
+                    (unsigned long)record.run_msec,
+                    (unsigned long)record.fill_msec,
+                    (unsigned long)record.interval_sec,
+                    (record.flags & RUN_FLAG_FULL_BAND) ? "LOW" : "TOPUP",
+                    record.band_pct,
+                    (record.flags & RUN_FLAG_SOFT_DRIVE) ? "SOFT" : "HARD");
+    }
+  }
+
+
+protected:
+
+  void clear_records() {
+    _history.version = NVM_VERSION;
+    _history.head = 0;
+    _history.count = 0;
+    memset(_history.records, 0, sizeof(_history.records));
+  }
+
+
+  void save() {
+    if (_nvm_ready) {
+      _preferences.putBytes("runs", &_history, sizeof(_history));
+    }
+  }
+
+
+  //
+  // Time of a fill scaled to a whole band by the part of the band it covered.
+  //
+  uint32_t whole_band_msec(uint32_t msec, const PUMP_RUN_RECORD_T &record) {
+    return (uint32_t)(((uint64_t)msec * 100) / record.band_pct);
+  }
+
+
+  //
+  // Gather the values of a field that take part in its summary.
+  //
+  uint8_t collect(PUMP_RUN_FIELD_T field, uint32_t *values) {
+    uint8_t n = 0;
+    for (uint8_t age = 0; age < _history.count; age++) {
+      PUMP_RUN_RECORD_T record = Get_Record(age);
+      switch (field) {
+        case PUMP_RUN_TIME:
+          if (record.band_pct >= MIN_BAND_PCT) {
+            values[n++] = whole_band_msec(record.run_msec, record);
+          }
+          break;
+        case PUMP_FILL_TIME:
+          if (record.band_pct >= MIN_BAND_PCT) {
+            values[n++] = whole_band_msec(record.fill_msec, record);
+          }
+          break;
+        case PUMP_INTERVAL:
+          if (record.interval_sec > 0) {
+            values[n++] = record.interval_sec;
+          }
+          break;
+      }
+    }
+    return n;
+  }
+};
+
+#endif
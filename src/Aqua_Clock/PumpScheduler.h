@@ -0,0 +1,277 @@
+/*
+ * Pump Scheduler class for the Aqua Clock
+ *
+ * Decides when the feed tank gets refilled so the pump runs as few times as possible.
+ * The water drawn from the feed tank is forecast from the upcoming digit transitions of every column
+ * in COLUMN_TABLE and the sleep window of the ClockManager, where the columns park at the sleep elevation.
+ * The forecast in mm of column fill is converted to tank percent with the column draw learned by the TankManager.
+ * Supported modes:
+ *   ROLLOVER - Top up ahead of each minute rollover with a large predicted fill.
+ *   HOURLY   - Plan the refills for the hour at its start.  The runs needed to carry the hour are spread
+ *              over evenly spaced slots and each slot only tops up if the tank would not last to the next one.
+ * The TankManager low mark refill is always active as the safety fallback.
+ * Pump starts are counted per day.
+ * The scheduler runs on the clock second events rather than being polled from the loop.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef PUMP_SCHEDULER_H
+#define PUMP_SCHEDULER_H
+
+#include <Arduino.h>
+
+#include "ClockManager.h"
+#include "ColumnConfig.h"
+#include "Stats.h"
+#include "TankManager.h"
+
+
+class PumpScheduler {
+public:
+  typedef enum {
+    PUMP_SCHEDULE_ROLLOVER,
+    PUMP_SCHEDULE_HOURLY
+  } PUMP_SCHEDULE_MODE_T;
+
+private:
+  TankManager *_tank;
+  ClockManager *_clock;
+
+  PUMP_SCHEDULE_MODE_T _mode = PUMP_SCHEDULE_HOURLY;
+  bool _logging_enable = false;
+
+  // Rollover mode, top up in the second half of a minute that ends with a large column fill
+  uint16_t _rollover_fill_threshold_mm = 40;
+  uint8_t _rollover_lead_second = 30;
+
+  // Hourly mode.  Slots start at the run minute, after the top of the hour moves have settled, and
+  // wait for the quiet second of the minute when the minute moves are done.
+  static constexpr uint8_t MAX_RUNS_PER_HOUR = 6;
+  uint8_t _run_minute = 5;
+  uint8_t _quiet_second = 20;
+  float _reserve_pct = 5.0; /* Keep this much above the low mark at the next slot */
+  uint8_t _planned_hour = 0xFF;
+  uint8_t _planned_runs = 1;
+  uint8_t _slot_period_min = 60;
+  uint8_t _last_slot_minute = 0xFF;
+  float _hour_forecast_pct = 0;
+  uint32_t _scheduled_runs = 0;
+  uint32_t _skipped_slots = 0;
+
+  // Pump runs per day
+  uint16_t _day = 0xFFFF;
+  uint32_t _pump_start_count = 0;
+  uint32_t _runs_today = 0;
+  uint32_t _runs_yesterday = 0;
+  RunningStats _daily_run_stats;
+
+public:
+  /* Constructor - capture the tank to schedule and the clock to forecast from, run on every new second */
+  PumpScheduler(TankManager *tank, ClockManager *clock) {
+    _tank = tank;
+    _clock = clock;
+    _clock->Subscribe(&PumpScheduler::clock_event, ClockManager::CLOCK_EVENT_SECOND, this);
+  }
+
+
+  PUMP_SCHEDULE_MODE_T Get_Mode() {
+    return _mode;
+  }
+
+
+  void Set_Mode(PUMP_SCHEDULE_MODE_T mode) {
+    _mode = mode;
+    _planned_hour = 0xFF;
+  }
+
+
+  const char *Get_Mode_Name() {
+    return (_mode == PUMP_SCHEDULE_HOURLY) ? "HOURLY" : "ROLLOVER";
+  }
+
+
+  //
+  // Once per second update.  Counts the pump runs and requests the scheduled top ups.
+  // Without a working clock there are no events, the low mark refill still protects the tank.
+  //
+  void Update() {
+    track_daily_runs();
+
+    uint8_t hour = _clock->Get_Hour();
+    uint8_t minute = _clock->Get_Minute();
+    uint8_t second = _clock->Get_Second();
+
+    if (_mode == PUMP_SCHEDULE_ROLLOVER) {
+      if ((second >= _rollover_lead_second) && (Forecast_Fill_MM(hour, minute, 1) >= _rollover_fill_threshold_mm)) {
+        _tank->Request_Top_Up();
+      }
+      return;
+    }
+
+    if (hour != _planned_hour) {
+      plan_hour(hour, minute);
+    }
+
+    // Evaluate each slot once, in its quiet second
+    if ((minute < _run_minute) || (second < _quiet_second) || (minute == _last_slot_minute)
+        || (((minute - _run_minute) % _slot_period_min) != 0)) {
+      return;
+    }
+    _last_slot_minute = minute;
+
+    // Will the tank carry the columns to the next slot?
+    float need_pct = Forecast_Fill_MM(hour, minute, _slot_period_min) * _tank->Get_Column_Pct_Per_MM();
+    float level_pct = _tank->Get_Virtual_Level_Pct();
+    bool run = ((level_pct - need_pct) < (_tank->Get_Low_Mark_Pct() + _reserve_pct));
+    if (run) {
+      _scheduled_runs++;
+      _tank->Request_Top_Up();
+    } else {
+      _skipped_slots++;
+    }
+
+    if (_logging_enable) {
+      Serial.print("PUMP SCHED: Slot ");
+      Serial.print(hour);
+      Serial.print(":");
+      Serial.print(minute);
+      Serial.print(" level ");
+      Serial.print(level_pct, 1);
+      Serial.print("% need ");
+      Serial.print(need_pct, 1);
+      Serial.println(run ? "% -> top up" : "% -> skip");
+    }
+  }
+
+
+  //
+  // Forecast the total column fill in mm over the next minutes starting at a time of day.
+  // Only fills draw on the feed tank, drains are ignored.
+  //
+  uint32_t Forecast_Fill_MM(uint8_t hour, uint8_t minute, uint16_t minutes_ahead) {
+    uint32_t fill_mm = 0;
+    uint16_t start = (uint16_t)hour * 60 + minute;
+
+    for (uint16_t k = 0; k < minutes_ahead; k++) {
+      uint16_t from_time = (start + k) % 1440;
+      uint16_t to_time = (start + k + 1) % 1440;
+      for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+        uint16_t from_mm = setpoint_at(i, from_time);
+        uint16_t to_mm = setpoint_at(i, to_time);
+        // Filling lowers the range reading
+        if (from_mm > to_mm) {
+          fill_mm += from_mm - to_mm;
+        }
+      }
+    }
+    return fill_mm;
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Mode: ");
+    Serial.println(Get_Mode_Name());
+    Serial.print("   Hour forecast: ");
+    Serial.print(_hour_forecast_pct, 1);
+    Serial.print("%  Planned runs: ");
+    Serial.print(_planned_runs);
+    Serial.print(" every ");
+    Serial.print(_slot_period_min);
+    Serial.println(" min");
+    Serial.print("   Scheduled runs: ");
+    Serial.print(_scheduled_runs);
+    Serial.print("  Skipped slots: ");
+    Serial.println(_skipped_slots);
+    Serial.print("   Pump runs today: ");
+    Serial.print(_runs_today);
+    Serial.print("  yesterday: ");
+    Serial.println(_runs_yesterday);
+    Serial.print("   Pump runs per day: ");
+    _daily_run_stats.Print("runs");
+    Serial.println();
+  }
+
+
+  void Enable_Logging() {
+    _logging_enable = true;
+  }
+
+
+  void Disable_Logging() {
+    _logging_enable = false;
+  }
+
+
+protected:
+
+  static void clock_event(uint8_t events, void *context) {
+    ((PumpScheduler *)context)->Update();
+  }
+
+
+  //
+  // Column setpoint at a minute of the day, parked while sleeping.
+  //
+  uint16_t setpoint_at(uint8_t column, uint16_t minute_of_day) {
+    uint8_t hour = minute_of_day / 60;
+    uint8_t minute = minute_of_day % 60;
+    if (_clock->Is_Sleep_Time_At(hour, minute, 0)) {
+      return SLEEP_WATER_COLUMN_ELEVATION;
+    }
+    return scale_time_to_elevation(COLUMN_TABLE[column], hour, minute, 0);
+  }
+
+
+  //
+  // Forecast the rest of the hour and spread the runs it needs over evenly spaced slots.
+  //
+  void plan_hour(uint8_t hour, uint8_t minute) {
+    _planned_hour = hour;
+    _last_slot_minute = 0xFF;
+
+    _hour_forecast_pct = Forecast_Fill_MM(hour, 0, 60) * _tank->Get_Column_Pct_Per_MM();
+    float band_pct = _tank->Get_High_Mark_Pct() - _tank->Get_Low_Mark_Pct() - _reserve_pct;
+    uint8_t runs = 1;
+    if (band_pct > 0) {
+      runs = (uint8_t)constrain(ceilf(_hour_forecast_pct / band_pct), 1.0f, (float)MAX_RUNS_PER_HOUR);
+    }
+    _planned_runs = runs;
+    _slot_period_min = (60 - _run_minute) / runs;
+    if (_slot_period_min == 0) {
+      _slot_period_min = 1;
+    }
+
+    if (_logging_enable) {
+      Serial.print("PUMP SCHED: Hour ");
+      Serial.print(hour);
+      Serial.print(" forecast ");
+      Serial.print(_hour_forecast_pct, 1);
+      Serial.print("% in ");
+      Serial.print(runs);
+      Serial.println(" runs");
+    }
+  }
+
+
+  //
+  // Count the pump starts of each day.
+  //
+  void track_daily_runs() {
+    uint32_t starts = _tank->Get_Pump_Start_Count();
+    _runs_today += starts - _pump_start_count;
+    _pump_start_count = starts;
+
+    uint16_t day = _clock->Get_Day();
+    if (day != _day) {
+      if (_day != 0xFFFF) {
+        _runs_yesterday = _runs_today;
+        _daily_run_stats.Add(_runs_today);
+        _runs_today = 0;
+      }
+      _day = day;
+    }
+  }
+};
+
+#endif
@@ -9,6 +9,7 @@
  * to the raw readings.  A median reading is useful for filtering out a noisy single reading out of three.
  * If the sensor fails to initialize or does not provide a reading in a reasonable period then a system
  * fault is issued.
+ * Ranging can be stopped to save power while the clock sleeps and restarted on wake.
  * This has been testing using the Adafruit and Pololu VL53L1X carrier boards.
  *
  * @author Joe Mohos
@@ -33,6 +34,7 @@ public:
     RANGE_SENSOR_UNINITIALIZED,
     RANGE_SENSOR_INIT_ERROR,
     RANGE_SENSOR_WORKING,
+    RANGE_SENSOR_STOPPED,
     RANGE_SENSOR_TIMEOUT
   } RANGE_SENSOR_STATE_T;
 
@@ -48,6 +50,7 @@ private:
 
   elapsedMillis _time_since_last_read_msec;
   const uint32_t READ_TIMEOUT_MSEC = 200;  // Max time between valid readings
+  static constexpr uint32_t RANGING_PERIOD_MSEC = 25;
 
   // History of raw readings
   static constexpr int HISTORY_SIZE = 3;
@@ -55,6 +58,7 @@ private:
   uint16_t _linearized_median_range = 0;
   uint8_t _median_index = 0;
   uint8_t _roi_center = 0;
+  uint32_t _reading_count = 0;
 
 public:
 
@@ -112,7 +116,7 @@ public:
 
     // start continuous ranging internally with 25msec periodocity
     //_device->startContinuous(50);
-    _device->startContinuous(25);
+    _device->startContinuous(RANGING_PERIOD_MSEC);
 
     // Init complete, ready for use
     _sensor_state = RANGE_SENSOR_WORKING;
@@ -133,6 +137,7 @@ public:
         current_range = process_reading(_device->read());
 
         _time_since_last_read_msec = 0;
+        _reading_count++;
       }
 
       // Detect device timeout
@@ -163,6 +168,36 @@ public:
   }
 
 
+  //
+  // Stop continuous ranging, the sensor drops to its standby current.
+  // The mux port of the sensor must be selected.
+  //
+  void Stop_Ranging() {
+    if (_sensor_state == RANGE_SENSOR_WORKING) {
+      _device->stopContinuous();
+      _sensor_state = RANGE_SENSOR_STOPPED;
+    }
+  }
+
+
+  //
+  // Resume continuous ranging after Stop_Ranging().  The mux port of the sensor must be selected.
+  //
+  void Start_Ranging() {
+    if (_sensor_state == RANGE_SENSOR_STOPPED) {
+      _device->startContinuous(RANGING_PERIOD_MSEC);
+      _time_since_last_read_msec = 0;
+      _sensor_state = RANGE_SENSOR_WORKING;
+    }
+  }
+
+
+  // Number of readings taken, used to spot the first fresh reading after a restart
+  uint32_t Get_Reading_Count() {
+    return _reading_count;
+  }
+
+
   // Report the most recent sensor value, unfiltered
   uint16_t Get_Newest_Reading() {
     return _range_history[0];
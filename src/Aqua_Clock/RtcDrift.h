@@ -0,0 +1,276 @@
+/*
+ * RTC drift tracker for the Aqua Clock
+ *
+ * The RV-8803 is the only timekeeper, there is no network to discipline it.  Every time correction,
+ * from the UI or a serial sync, is a free measurement of how far the RTC wandered since the prior one.
+ * Each correction records the error against the elapsed time, in ppm, along with the calibration
+ * offset that was active.  The crystal error is estimated as the elapsed time weighted mean over the
+ * recorded corrections and the opposite offset is programmed into the RV-8803 offset register.
+ * Longer intervals carry more weight since a one second setting error is a smaller part of them.
+ * The history and the reference of the last correction are kept in the ESP32 Preferences.
+ *
+ * The RV-8803 offset register trims in steps of about 0.24 ppm within about +/-7.5 ppm.  A positive
+ * offset speeds the clock up.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef RTC_DRIFT_H
+#define RTC_DRIFT_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include <SparkFun_RV8803.h>
+
+#include "faults.h"
+
+
+class RtcDriftTracker {
+public:
+
+  static constexpr uint8_t HISTORY_SIZE = 8;
+
+  typedef struct {
+    uint32_t epoch;        /* Corrected time */
+    uint32_t elapsed_sec;  /* Since the prior correction */
+    int32_t error_msec;    /* RTC minus corrected time, positive when the RTC ran fast */
+    float offset_ppm;      /* Calibration offset active over the interval */
+  } DRIFT_RECORD_T;
+
+private:
+
+  // Shorter intervals are dominated by the setting error of a manual correction
+  static constexpr uint32_t MIN_MEASURE_SEC = 24UL * 3600UL;
+  // Larger errors are a time zone or date change, not drift
+  static constexpr uint32_t MAX_ERROR_MSEC = 15UL * 60UL * 1000UL;
+  static constexpr float OFFSET_LIMIT_PPM = 7.4;
+
+  static constexpr uint8_t NVM_VERSION = 1;
+  typedef struct {
+    uint8_t version;
+    uint8_t head;
+    uint8_t count;
+    bool reference_valid;
+    bool auto_trim;
+    uint32_t reference_epoch;
+    int32_t pending_error_msec; /* Corrections since the reference that were too short to measure */
+    float offset_ppm;
+    DRIFT_RECORD_T records[HISTORY_SIZE];
+  } NVM_RTC_DRIFT_T;
+
+  RV8803 *_rtc = NULL;
+  Preferences _preferences;
+  bool _nvm_ready = false;
+  NVM_RTC_DRIFT_T _drift;
+  uint32_t _rejected_count = 0;
+
+public:
+
+  RtcDriftTracker() {
+    clear_records();
+    _drift.auto_trim = true;
+    _drift.offset_ppm = 0;
+  }
+
+
+  //
+  // Restore the history and reprogram the offset in case the RTC lost its backup power.
+  //
+  void Startup(RV8803 *rtc) {
+    _rtc = rtc;
+
+    if (!_preferences.begin("rtcdrift", false)) {
+      FAULT_SET(FAULT_NVM_FAIL);
+      Serial.println("ERROR: Failed to find Non-Volatile memory space for RTC drift!");
+      return;
+    }
+    _nvm_ready = true;
+
+    NVM_RTC_DRIFT_T saved;
+    if ((_preferences.getBytesLength("drift") == sizeof(saved))
+        && (_preferences.getBytes("drift", &saved, sizeof(saved)) == sizeof(saved))
+        && (saved.version == NVM_VERSION) && (saved.head < HISTORY_SIZE) && (saved.count <= HISTORY_SIZE)) {
+      _drift = saved;
+      Serial.print("Restored RTC drift history, offset ppm: ");
+      Serial.println(_drift.offset_ppm, 2);
+    }
+    _rtc->setCalibrationOffset(_drift.offset_ppm);
+  }
+
+
+  //
+  // The time was corrected.  Pass the RTC reading just before the correction and the corrected time,
+  // both as epoch seconds plus hundredths.
+  //
+  void Record_Correction(uint32_t rtc_epoch, uint8_t rtc_hundredths, uint32_t true_epoch, uint8_t true_hundredths) {
+    int32_t error_msec = (int32_t)(rtc_epoch - true_epoch) * 1000 + ((int32_t)rtc_hundredths - (int32_t)true_hundredths) * 10;
+
+    if (!_drift.reference_valid || (true_epoch <= _drift.reference_epoch)
+        || ((uint32_t)abs(error_msec) > MAX_ERROR_MSEC)) {
+      // No usable reference or the time jumped, start measuring from here
+      if (_drift.reference_valid) {
+        _rejected_count++;
+      }
+      restart_reference(true_epoch);
+      save();
+      return;
+    }
+
+    // Short intervals keep adding up against the same reference until they make a measurement
+    _drift.pending_error_msec += error_msec;
+    uint32_t elapsed_sec = true_epoch - _drift.reference_epoch;
+    if (elapsed_sec < MIN_MEASURE_SEC) {
+      save();
+      return;
+    }
+
+    DRIFT_RECORD_T &record = _drift.records[_drift.head];
+    record.epoch = true_epoch;
+    record.elapsed_sec = elapsed_sec;
+    record.error_msec = _drift.pending_error_msec;
+    record.offset_ppm = _drift.offset_ppm;
+    _drift.head = (_drift.head + 1) % HISTORY_SIZE;
+    if (_drift.count < HISTORY_SIZE) {
+      _drift.count++;
+    }
+
+    Serial.print("RTC drift: ");
+    Serial.print(record.error_msec);
+    Serial.print(" msec over ");
+    Serial.print(elapsed_sec);
+    Serial.print(" sec, ");
+    Serial.print(measured_ppm(record), 2);
+    Serial.println(" ppm");
+
+    restart_reference(true_epoch);
+    if (_drift.auto_trim) {
+      apply_offset(-Get_Crystal_PPM());
+    } else {
+      save();
+    }
+  }
+
+
+  //
+  // The time was set without a reference clock.  Drop the measurement in progress and start over.
+  //
+  void Restart_Reference(uint32_t true_epoch) {
+    restart_reference(true_epoch);
+    save();
+  }
+
+
+  //
+  // Estimated crystal error in ppm without any offset applied, positive when running fast.
+  //
+  float Get_Crystal_PPM() {
+    float weighted_ppm = 0;
+    float total_sec = 0;
+    for (uint8_t i = 0; i < _drift.count; i++) {
+      DRIFT_RECORD_T &record = _drift.records[i];
+      weighted_ppm += (measured_ppm(record) - record.offset_ppm) * record.elapsed_sec;
+      total_sec += record.elapsed_sec;
+    }
+    return (total_sec > 0) ? (weighted_ppm / total_sec) : 0;
+  }
+
+
+  float Get_Offset_PPM() {
+    return _drift.offset_ppm;
+  }
+
+
+  bool Is_Auto_Trim() {
+    return _drift.auto_trim;
+  }
+
+
+  void Set_Auto_Trim(bool enable) {
+    _drift.auto_trim = enable;
+    save();
+  }
+
+
+  //
+  // Forget the measurements and the offset.  The next correction starts a new reference.
+  //
+  void Clear() {
+    clear_records();
+    apply_offset(0);
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Auto trim: ");
+    Serial.print(_drift.auto_trim ? "ON" : "OFF");
+    Serial.print("  Offset: ");
+    Serial.print(_drift.offset_ppm, 2);
+    Serial.print(" ppm  Crystal: ");
+    Serial.print(Get_Crystal_PPM(), 2);
+    Serial.println(" ppm");
+    Serial.print("   Reference: ");
+    if (_drift.reference_valid) {
+      Serial.print(_drift.reference_epoch);
+    } else {
+      Serial.print("none");
+    }
+    Serial.print("  Rejected corrections: ");
+    Serial.println(_rejected_count);
+    for (uint8_t age = 0; age < _drift.count; age++) {
+      DRIFT_RECORD_T &record = _drift.records[(_drift.head + HISTORY_SIZE - 1 - age) % HISTORY_SIZE];
+      Serial.printf("   %10lu  %7.2f days  %7ld msec  %6.2f ppm  offset %5.2f ppm\n",
+                    (unsigned long)record.epoch,
+                    record.elapsed_sec / 86400.0,
+                    (long)record.error_msec,
+                    measured_ppm(record),
+                    record.offset_ppm);
+    }
+  }
+
+
+protected:
+
+  float measured_ppm(const DRIFT_RECORD_T &record) {
+    return ((float)record.error_msec * 1000.0f) / (float)record.elapsed_sec;
+  }
+
+
+  void restart_reference(uint32_t epoch) {
+    _drift.reference_epoch = epoch;
+    _drift.pending_error_msec = 0;
+    _drift.reference_valid = true;
+  }
+
+
+  void apply_offset(float offset_ppm) {
+    float limit_ppm = OFFSET_LIMIT_PPM;
+    _drift.offset_ppm = constrain(offset_ppm, -limit_ppm, limit_ppm);
+    if (_rtc != NULL) {
+      _rtc->setCalibrationOffset(_drift.offset_ppm);
+      // Read back the offset the register could hold
+      _drift.offset_ppm = _rtc->getCalibrationOffset();
+    }
+    save();
+  }
+
+
+  void clear_records() {
+    _drift.version = NVM_VERSION;
+    _drift.head = 0;
+    _drift.count = 0;
+    _drift.reference_valid = false;
+    _drift.reference_epoch = 0;
+    _drift.pending_error_msec = 0;
+    memset(_drift.records, 0, sizeof(_drift.records));
+  }
+
+
+  void save() {
+    if (_nvm_ready) {
+      _preferences.putBytes("drift", &_drift, sizeof(_drift));
+    }
+  }
+};
+
+#endif
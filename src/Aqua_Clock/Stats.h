@@ -0,0 +1,149 @@
+/*
+ * Statistics helpers for the Aqua Clock
+ *
+ * Small fixed-size accumulators used to characterize the water movement and
+ * regulation performance without any dynamic memory.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <Arduino.h>
+
+
+//
+// Running count, mean, minimum and maximum of a series of unsigned samples.
+//
+class RunningStats {
+private:
+  uint32_t _count = 0;
+  uint64_t _sum = 0;
+  uint32_t _min = 0xFFFFFFFF;
+  uint32_t _max = 0;
+
+public:
+  void Reset() {
+    _count = 0;
+    _sum = 0;
+    _min = 0xFFFFFFFF;
+    _max = 0;
+  }
+
+
+  void Add(uint32_t sample) {
+    _count++;
+    _sum += sample;
+    if (sample < _min) {
+      _min = sample;
+    }
+    if (sample > _max) {
+      _max = sample;
+    }
+  }
+
+
+  uint32_t Get_Count() {
+    return _count;
+  }
+
+
+  uint32_t Get_Mean() {
+    if (_count == 0) {
+      return 0;
+    }
+    return (uint32_t)(_sum / _count);
+  }
+
+
+  uint32_t Get_Min() {
+    if (_count == 0) {
+      return 0;
+    }
+    return _min;
+  }
+
+
+  uint32_t Get_Max() {
+    return _max;
+  }
+
+
+  // Print "n=x mean=x min=x max=x" on the console
+  void Print(const char *units) {
+    Serial.print("n=");
+    Serial.print(_count);
+    Serial.print(" mean=");
+    Serial.print(Get_Mean());
+    Serial.print(units);
+    Serial.print(" min=");
+    Serial.print(Get_Min());
+    Serial.print(units);
+    Serial.print(" max=");
+    Serial.print(Get_Max());
+    Serial.print(units);
+  }
+};
+
+
+//
+// Counts of samples in equal width bins.  The last bin collects everything beyond the range.
+//
+class Histogram {
+public:
+  static constexpr uint8_t NUM_BINS = 11;
+
+private:
+  uint32_t _bin_width = 1;
+  uint32_t _bins[NUM_BINS];
+
+public:
+  Histogram(uint32_t bin_width) {
+    _bin_width = (bin_width > 0) ? bin_width : 1;
+    Reset();
+  }
+
+
+  void Reset() {
+    for (uint8_t i = 0; i < NUM_BINS; i++) {
+      _bins[i] = 0;
+    }
+  }
+
+
+  void Add(uint32_t sample) {
+    uint32_t index = sample / _bin_width;
+    if (index >= NUM_BINS) {
+      index = NUM_BINS - 1;
+    }
+    _bins[index]++;
+  }
+
+
+  uint32_t Get_Bin(uint8_t index) {
+    if (index >= NUM_BINS) {
+      return 0;
+    }
+    return _bins[index];
+  }
+
+
+  // Print "<100:n <200:n ... >=1000:n" on the console
+  void Print() {
+    for (uint8_t i = 0; i < NUM_BINS; i++) {
+      if (i < (NUM_BINS - 1)) {
+        Serial.print("<");
+        Serial.print((i + 1) * _bin_width);
+      } else {
+        Serial.print(">=");
+        Serial.print(i * _bin_width);
+      }
+      Serial.print(":");
+      Serial.print(_bins[i]);
+      Serial.print(" ");
+    }
+  }
+};
+
+#endif
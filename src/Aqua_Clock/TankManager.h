@@ -5,7 +5,18 @@
  * The upper tank has two water level sensors set at a low (25%) and high (75%) water mark.
  * If the water level of this tank falls below the lower water mark then a pump is turned on to fill
  * the tank up to the high level sensor.
+ * The level switches are debounced with separate wet and dry qualify times so sloshing while the
+ * pump runs does not end a fill early or restart the pump.
  * There is support for manual actuation of the pump for service modes to fill the tanks.
+ * The pump is arbitrated against the water columns.  While a column move is in flight the pump is
+ * held off unless the tank is below the low mark, and the tank can be topped up ahead of large predicted moves.
+ * A virtual tank level is estimated between the level switch events by integrating the pump run time
+ * and the water drawn by the column fills.  Each switch edge resets the estimate to the switch mark and
+ * recalibrates the pump rate and the column draw from the run between the two marks.
+ * The pump can be driven hard on/off or soft, ramping the PWM duty of the IO expander LED driver up
+ * at start and down at stop to limit the inrush current and the start thump.
+ * Every completed fill is recorded in the PumpHistory so creeping fill times and shrinking refill
+ * intervals can be seen, and a warning is raised before the fill timeout is reached.
  * There is fault monitoring applied to look for:
  *   Excessive pump time to fill the tank.  (Lower tank probably running dry, leak or bad pump)
  *   Invalid water level sensor readings.  (Failed sensor, miswired sensors)
@@ -19,7 +30,10 @@
 #include <Arduino.h>
 #include <elapsedMillis.h>
 
+#include "DebouncedInput.h"
 #include "io_expander_config.h"
+#include "PumpHistory.h"
+#include "Stats.h"
 
 
 class TankManager {
@@ -31,9 +45,16 @@ public:
     TANK_FILL_ACTIVE,
     TANK_FILL_SETTLE,
     TANK_MANUAL_FILL,
+    TANK_FILL_DEFERRED,
     TANK_FILL_TIMEOUT_FAULT
   } TANK_STATE_TYPE_T;
 
+  typedef enum {
+    PUMP_DRIVE_HARD, /* Digital on/off */
+    PUMP_DRIVE_SOFT, /* PWM ramps at start and stop */
+    PUMP_DRIVE_MODE_COUNT
+  } PUMP_DRIVE_MODE_T;
+
 private:
 
   /* All discrete IO handled by IO Expander board */
@@ -45,6 +66,12 @@ private:
   bool _feed_tank_level_above_low = false;
   bool _pump_active = false;
 
+  // Level switch filters, wet must hold for the assert time and dry for the release time.
+  // Dry is qualified longer on the low mark since it starts the pump.
+  DebouncedInput _level_low_filter = DebouncedInput(500, 2000);
+  DebouncedInput _level_high_filter = DebouncedInput(750, 1500);
+  uint32_t _pump_start_count = 0;
+
   bool _enable = false;
   bool _enable_logging = false;
 
@@ -60,6 +87,68 @@ private:
 
   const uint32_t MAX_PUMP_FILL_TIME_MSEC = 30000; /* 30 second pump time max */
 
+  // Pump versus column arbitration
+  bool _arbitration_enable = true;
+  bool _columns_busy = false;
+  bool _request_top_up = false;
+  uint32_t _fill_time_before_defer = 0;
+  uint32_t _deferred_count = 0;
+  uint32_t _top_up_count = 0;
+
+  // Pump drive.  The soft mode steps the PWM duty every update between the start duty, where the pump
+  // just turns over, and full duty.  The LED driver sinks current so the written intensity is inverted.
+  static constexpr uint8_t PUMP_DUTY_MAX = 255;
+  static constexpr bool PUMP_PWM_ACTIVE_LOW = true;
+  PUMP_DRIVE_MODE_T _pump_drive_mode = PUMP_DRIVE_HARD;
+  bool _pump_request = false;
+  uint8_t _pump_duty = 0;
+  uint8_t _ramp_start_duty = 80;
+  uint32_t _ramp_up_msec = 1500;
+  uint32_t _ramp_down_msec = 500;
+  bool _ramp_up_active = false;
+  elapsedMillis _ramp_elapsed;
+  RunningStats _ramp_up_stats;
+  RunningStats _fill_time_stats[PUMP_DRIVE_MODE_COUNT];
+
+  // Per fill history and the predictive fill time warning
+  PumpHistory _history;
+  uint32_t _fill_start_msec = 0;
+  bool _fill_full_band = false;
+  float _fill_start_level_pct = 0;
+  uint32_t _last_fill_done_msec = 0;
+  bool _last_fill_done_valid = false;
+  bool _fill_running_long = false;
+  bool _fill_trend_warning = false;
+  uint32_t _long_fill_count = 0;
+
+  // Virtual tank level in percent.  The pump rate and the tank percent used per mm of column fill
+  // are learned from the runs between the low and high marks.
+  typedef enum {
+    LEVEL_EDGE_NONE,
+    LEVEL_EDGE_LOW_RISE,
+    LEVEL_EDGE_LOW_FALL,
+    LEVEL_EDGE_HIGH_RISE,
+    LEVEL_EDGE_HIGH_FALL
+  } LEVEL_EDGE_T;
+
+  static constexpr float LOW_MARK_PCT = 25.0;
+  static constexpr float HIGH_MARK_PCT = 75.0;
+  static constexpr float LEVEL_CAL_FILTER_WEIGHT = 0.3;
+  static constexpr float MIN_CAL_PUMP_SEC = 2.0;
+  static constexpr float MIN_CAL_COLUMN_MM = 20.0;
+  float _level_pct = 50.0;
+  float _pump_rate_pct_per_sec = 2.5; /* 50% of the tank in 20 seconds */
+  float _column_pct_per_mm = 0.05;    /* 50% of the tank per meter of column fill */
+  uint32_t _column_fill_total_mm = 0;
+  bool _column_fill_total_valid = false;
+  LEVEL_EDGE_T _last_level_edge = LEVEL_EDGE_NONE;
+  float _pump_sec_since_edge = 0;
+  float _column_mm_since_edge = 0;
+  bool _prior_above_low = false;
+  bool _prior_above_high = false;
+  bool _level_sense_started = false;
+  elapsedMillis _level_integrate_elapsed;
+
 public:
 
   //
@@ -79,6 +168,15 @@ public:
   }
 
 
+  //
+  // Restore the saved pump history.  Preferences are not available before setup().
+  //
+  void Startup() {
+    _history.Startup();
+    _fill_trend_warning = _history.Is_Limit_Warning(MAX_PUMP_FILL_TIME_MSEC);
+  }
+
+
   TANK_STATE_TYPE_T Get_State() {
     return (_state);
   }
@@ -116,6 +214,215 @@ public:
   }
 
 
+  //
+  // Report if any column is moving water or a transition is still under way.  Pumping is deferred
+  // while columns are busy.
+  //
+  void Set_Column_Demand(bool columns_busy) {
+    _columns_busy = columns_busy;
+  }
+
+
+  //
+  // Ask for the tank to be filled to the high mark before a large predicted column fill.
+  // Only honored when the columns are at rest.
+  //
+  void Request_Top_Up() {
+    _request_top_up = true;
+  }
+
+
+  //
+  // Report the running total of column fill in mm from all columns.  The change since the last
+  // report is drawn out of the virtual tank level.
+  //
+  void Set_Column_Fill_Total_MM(uint32_t total_mm) {
+    if (_column_fill_total_valid && (total_mm >= _column_fill_total_mm)) {
+      float used_mm = (float)(total_mm - _column_fill_total_mm);
+      _column_mm_since_edge += used_mm;
+      _level_pct -= used_mm * _column_pct_per_mm;
+    }
+    _column_fill_total_mm = total_mm;
+    _column_fill_total_valid = true;
+  }
+
+
+  //
+  // Continuous estimate of the feed tank level, 0-100 percent.
+  //
+  float Get_Virtual_Level_Pct() {
+    return _level_pct;
+  }
+
+
+  float Get_Low_Mark_Pct() {
+    return LOW_MARK_PCT;
+  }
+
+
+  float Get_High_Mark_Pct() {
+    return HIGH_MARK_PCT;
+  }
+
+
+  float Get_Pump_Rate_Pct_Per_Sec() {
+    return _pump_rate_pct_per_sec;
+  }
+
+
+  float Get_Column_Pct_Per_MM() {
+    return _column_pct_per_mm;
+  }
+
+
+  bool Is_Arbitration_Enabled() {
+    return _arbitration_enable;
+  }
+
+
+  void Set_Arbitration_Enable(bool enable) {
+    _arbitration_enable = enable;
+  }
+
+
+  uint32_t Get_Deferred_Count() {
+    return _deferred_count;
+  }
+
+
+  uint32_t Get_Top_Up_Count() {
+    return _top_up_count;
+  }
+
+
+  PUMP_DRIVE_MODE_T Get_Pump_Drive_Mode() {
+    return _pump_drive_mode;
+  }
+
+
+  //
+  // Select hard on/off or ramped PWM pump drive.  Reconfigures the pump output pin.
+  //
+  void Set_Pump_Drive_Mode(PUMP_DRIVE_MODE_T mode) {
+    if ((mode == _pump_drive_mode) || (mode >= PUMP_DRIVE_MODE_COUNT)) {
+      return;
+    }
+    _pump_drive_mode = mode;
+    if (_feed_pump_drive_pin >= 0) {
+      _io_expander->pinMode(_feed_pump_drive_pin, (mode == PUMP_DRIVE_SOFT) ? ANALOG_OUTPUT : OUTPUT);
+    }
+    _pump_duty = 0;
+    write_pump_output();
+  }
+
+
+  //
+  // Soft drive ramp profile.  Ramps of 0 msec switch straight to the end duty.
+  //
+  void Set_Pump_Ramp(uint32_t ramp_up_msec, uint32_t ramp_down_msec, uint8_t start_duty) {
+    _ramp_up_msec = ramp_up_msec;
+    _ramp_down_msec = ramp_down_msec;
+    _ramp_start_duty = start_duty;
+  }
+
+
+  uint32_t Get_Pump_Ramp_Up_MSEC() {
+    return _ramp_up_msec;
+  }
+
+
+  uint32_t Get_Pump_Ramp_Down_MSEC() {
+    return _ramp_down_msec;
+  }
+
+
+  uint8_t Get_Pump_Ramp_Start_Duty() {
+    return _ramp_start_duty;
+  }
+
+
+  //
+  // Level switch debounce times in msec for the low (false) or high (true) mark.
+  //
+  void Set_Level_Debounce(bool high_mark, uint32_t wet_msec, uint32_t dry_msec) {
+    if (high_mark) {
+      _level_high_filter.Set_Times(wet_msec, dry_msec);
+    } else {
+      _level_low_filter.Set_Times(wet_msec, dry_msec);
+    }
+  }
+
+
+  DebouncedInput *Get_Level_Filter(bool high_mark) {
+    return high_mark ? &_level_high_filter : &_level_low_filter;
+  }
+
+
+  //
+  // Number of times the pump has been switched on since startup.
+  //
+  uint32_t Get_Pump_Start_Count() {
+    return _pump_start_count;
+  }
+
+
+  uint8_t Get_Pump_Duty() {
+    return _pump_duty;
+  }
+
+
+  PumpHistory *Get_History() {
+    return &_history;
+  }
+
+
+  uint32_t Get_Max_Fill_Time_MSEC() {
+    return MAX_PUMP_FILL_TIME_MSEC;
+  }
+
+
+  //
+  // True while the fill in progress is running long or the fill history predicts the timeout.
+  //
+  bool Is_Fill_Time_Warning() {
+    return _fill_running_long || _fill_trend_warning;
+  }
+
+
+  uint32_t Get_Long_Fill_Count() {
+    return _long_fill_count;
+  }
+
+
+  void Print_Pump_Stats() {
+    Serial.print("   Drive: ");
+    Serial.print((_pump_drive_mode == PUMP_DRIVE_SOFT) ? "SOFT" : "HARD");
+    Serial.print("  Ramp up,down msec: ");
+    Serial.print(_ramp_up_msec);
+    Serial.print(", ");
+    Serial.print(_ramp_down_msec);
+    Serial.print("  Start duty: ");
+    Serial.println(_ramp_start_duty);
+    Serial.print("   Ramp up time: ");
+    _ramp_up_stats.Print("ms");
+    Serial.println();
+    Serial.print("   Fill time HARD: ");
+    _fill_time_stats[PUMP_DRIVE_HARD].Print("ms");
+    Serial.println();
+    Serial.print("   Fill time SOFT: ");
+    _fill_time_stats[PUMP_DRIVE_SOFT].Print("ms");
+    Serial.println();
+  }
+
+
+  void Reset_Pump_Stats() {
+    _ramp_up_stats.Reset();
+    for (uint8_t i = 0; i < PUMP_DRIVE_MODE_COUNT; i++) {
+      _fill_time_stats[i].Reset();
+    }
+  }
+
+
   void Enable_Logging() {
     _enable_logging = true;
   }
@@ -149,6 +456,9 @@ public:
     }
     _time_since_last_update = 0;
 
+    update_virtual_level();
+    update_pump_drive();
+
     //
     // Update the state machine to manage regulation sequencing
     //
@@ -169,12 +479,31 @@ public:
             // Running low on water, begin process of filling
             _state = TANK_FILL_ACTIVE;
             _time_in_current_state = 0;
+            _fill_time_before_defer = 0;
+            begin_fill_record(true);
 
             if (_enable_logging) {
               Serial.println("TANK: IDLE to FILL_ACTIVE");
             }
+          } else if (_request_top_up && _arbitration_enable && !_columns_busy && !Is_Feed_Tank_Above_High_Mark()) {
+            // Top up the tank while the columns are quiet, ahead of a large move
+            _request_top_up = false;
+            _top_up_count++;
+            _state = TANK_FILL_ACTIVE;
+            _time_in_current_state = 0;
+            _fill_time_before_defer = 0;
+            begin_fill_record(false);
+
+            if (_enable_logging) {
+              Serial.println("TANK: IDLE to FILL_ACTIVE for top up");
+            }
           }
         }
+
+        if (Is_Feed_Tank_Above_High_Mark()) {
+          // Already full, nothing to top up
+          _request_top_up = false;
+        }
         break;
 
       case TANK_FILL_ACTIVE:
@@ -183,10 +512,26 @@ public:
           _time_in_current_state = 0;
         }
 
+        if (_arbitration_enable && _columns_busy && Is_Feed_Tank_Above_Low_Mark()) {
+          // A column is moving and there is enough water to finish it, hold the pump off
+          stop_pumping();
+          _fill_time_before_defer += _time_in_current_state;
+          _deferred_count++;
+          _state = TANK_FILL_DEFERRED;
+          _time_in_current_state = 0;
+
+          if (_enable_logging) {
+            Serial.println("TANK: FILL_ACTIVE to FILL_DEFERRED");
+          }
+          break;
+        }
+
         start_pumping();
 
         if (Is_Feed_Tank_Above_High_Mark()) {
           stop_pumping();
+          _fill_time_stats[_pump_drive_mode].Add(_fill_time_before_defer + _time_in_current_state);
+          end_fill_record(_fill_time_before_defer + _time_in_current_state);
           _state = TANK_FILL_SETTLE;
           _time_in_current_state = 0;
 
@@ -195,7 +540,19 @@ public:
           }
         }
 
-        if (_time_in_current_state >= MAX_PUMP_FILL_TIME_MSEC) {
+        if (!_fill_running_long && (_state == TANK_FILL_ACTIVE)
+            && ((_fill_time_before_defer + _time_in_current_state) >= _history.Get_Warn_MSEC(MAX_PUMP_FILL_TIME_MSEC))) {
+          // Warn while there is still time before the timeout
+          _fill_running_long = true;
+          _long_fill_count++;
+          Serial.print("WARNING: Tank fill running long, ");
+          Serial.print(_fill_time_before_defer + _time_in_current_state);
+          Serial.print(" of ");
+          Serial.print(MAX_PUMP_FILL_TIME_MSEC);
+          Serial.println(" msec");
+        }
+
+        if ((_fill_time_before_defer + _time_in_current_state) >= MAX_PUMP_FILL_TIME_MSEC) {
           // Took too long to fill tank, something is wrong, register fault
           FAULT_SET(FAULT_TANK_FILL_TIMEOUT);
         }
@@ -219,6 +576,23 @@ public:
         }
         break;
 
+      case TANK_FILL_DEFERRED:
+        stop_pumping();
+
+        if (!_enable) {
+          _state = TANK_IDLE;
+          _time_in_current_state = 0;
+        } else if (!Is_Feed_Tank_Above_Low_Mark() || !_columns_busy || !_arbitration_enable) {
+          // Columns are done or the tank ran low, resume filling to the high mark
+          _state = TANK_FILL_ACTIVE;
+          _time_in_current_state = 0;
+
+          if (_enable_logging) {
+            Serial.println("TANK: FILL_DEFERRED to FILL_ACTIVE");
+          }
+        }
+        break;
+
       case TANK_MANUAL_FILL:
         start_pumping();
 
@@ -243,32 +617,196 @@ public:
 
 private:
 
+  //
+  // Integrate the pump inflow into the virtual level, recalibrate on each switch edge and keep the
+  // estimate within the band the switches allow.
+  //
+  void update_virtual_level() {
+    float dt_sec = (float)_level_integrate_elapsed / 1000.0;
+    _level_integrate_elapsed = 0;
+
+    if (_pump_active) {
+      // Flow is taken as proportional to the drive duty while ramping
+      float flow_sec = dt_sec * (float)_pump_duty / (float)PUMP_DUTY_MAX;
+      _pump_sec_since_edge += flow_sec;
+      _level_pct += _pump_rate_pct_per_sec * flow_sec;
+    }
+
+    bool above_low = Is_Feed_Tank_Above_Low_Mark();
+    bool above_high = Is_Feed_Tank_Above_High_Mark();
+
+    if (!_level_sense_started) {
+      // Seed the estimate from the switch band on the first pass
+      _level_sense_started = true;
+      _level_pct = above_high ? HIGH_MARK_PCT : (above_low ? (LOW_MARK_PCT + HIGH_MARK_PCT) / 2.0f : LOW_MARK_PCT);
+    } else if (above_high != _prior_above_high) {
+      level_edge(above_high ? LEVEL_EDGE_HIGH_RISE : LEVEL_EDGE_HIGH_FALL, HIGH_MARK_PCT);
+    } else if (above_low != _prior_above_low) {
+      level_edge(above_low ? LEVEL_EDGE_LOW_RISE : LEVEL_EDGE_LOW_FALL, LOW_MARK_PCT);
+    }
+    _prior_above_low = above_low;
+    _prior_above_high = above_high;
+
+    // The switches bound the estimate
+    if (above_high) {
+      _level_pct = constrain(_level_pct, HIGH_MARK_PCT, 100.0f);
+    } else if (above_low) {
+      _level_pct = constrain(_level_pct, LOW_MARK_PCT, HIGH_MARK_PCT);
+    } else {
+      _level_pct = constrain(_level_pct, 0.0f, LOW_MARK_PCT);
+    }
+  }
+
+
+  //
+  // A level switch changed state.  A run from one mark to the other moved exactly the water between
+  // the marks, use it to learn the pump rate (filling) or the column draw (emptying without the pump).
+  //
+  void level_edge(LEVEL_EDGE_T edge, float mark_pct) {
+    float band_pct = HIGH_MARK_PCT - LOW_MARK_PCT;
+
+    if ((edge == LEVEL_EDGE_HIGH_RISE) && (_last_level_edge == LEVEL_EDGE_LOW_RISE)
+        && (_pump_sec_since_edge >= MIN_CAL_PUMP_SEC)) {
+      float rate = (band_pct + _column_mm_since_edge * _column_pct_per_mm) / _pump_sec_since_edge;
+      _pump_rate_pct_per_sec += LEVEL_CAL_FILTER_WEIGHT * (rate - _pump_rate_pct_per_sec);
+    } else if ((edge == LEVEL_EDGE_LOW_FALL) && (_last_level_edge == LEVEL_EDGE_HIGH_FALL)
+               && (_column_mm_since_edge >= MIN_CAL_COLUMN_MM)) {
+      float draw = (band_pct + _pump_sec_since_edge * _pump_rate_pct_per_sec) / _column_mm_since_edge;
+      _column_pct_per_mm += LEVEL_CAL_FILTER_WEIGHT * (draw - _column_pct_per_mm);
+    }
+
+    if (_enable_logging) {
+      Serial.print("TANK: Level edge, estimate ");
+      Serial.print(_level_pct, 1);
+      Serial.print("% corrected to ");
+      Serial.print(mark_pct, 1);
+      Serial.print("%, pump ");
+      Serial.print(_pump_rate_pct_per_sec, 2);
+      Serial.print(" %/s, column ");
+      Serial.print(_column_pct_per_mm, 4);
+      Serial.println(" %/mm");
+    }
+
+    _level_pct = mark_pct;
+    _last_level_edge = edge;
+    _pump_sec_since_edge = 0;
+    _column_mm_since_edge = 0;
+  }
+
+
+  //
+  // Mark the start of a fill, from the low mark for a full band fill or from above it for a top up.
+  //
+  void begin_fill_record(bool full_band) {
+    _fill_start_msec = millis();
+    _fill_full_band = full_band;
+    _fill_start_level_pct = _level_pct;
+    _fill_running_long = false;
+  }
+
+
+  //
+  // The high mark was reached, add the fill to the history and check the trend.
+  //
+  void end_fill_record(uint32_t run_msec) {
+    uint32_t now = millis();
+    uint32_t interval_sec = _last_fill_done_valid ? ((now - _last_fill_done_msec) / 1000) : 0;
+    uint8_t flags = (_fill_full_band ? PumpHistory::RUN_FLAG_FULL_BAND : 0)
+                    | ((_pump_drive_mode == PUMP_DRIVE_SOFT) ? PumpHistory::RUN_FLAG_SOFT_DRIVE : 0);
+    // Part of the band a top up covered, from the estimated level it started at
+    float band_pct = (HIGH_MARK_PCT - _fill_start_level_pct) * 100.0f / (HIGH_MARK_PCT - LOW_MARK_PCT);
+    band_pct = constrain(band_pct, 1.0f, 100.0f);
+    _history.Record(run_msec, now - _fill_start_msec, interval_sec, flags, (uint8_t)(band_pct + 0.5f));
+    _last_fill_done_msec = now;
+    _last_fill_done_valid = true;
+    _fill_running_long = false;
+
+    bool warning = _history.Is_Limit_Warning(MAX_PUMP_FILL_TIME_MSEC);
+    if (warning && !_fill_trend_warning) {
+      Serial.println("WARNING: Tank fill times are trending toward the timeout, check the pump filter and for leaks");
+    }
+    _fill_trend_warning = warning;
+  }
+
+
   void update_feed_tank_level_status() {
     if (_feed_tank_level_high_pin >= 0) {
-      _feed_tank_level_above_high = !_io_expander->digitalRead(_feed_tank_level_high_pin);
+      _feed_tank_level_above_high = _level_high_filter.Update(!_io_expander->digitalRead(_feed_tank_level_high_pin));
     }
     if (_feed_tank_level_low_pin >= 0) {
-      _feed_tank_level_above_low = !_io_expander->digitalRead(_feed_tank_level_low_pin);
+      _feed_tank_level_above_low = _level_low_filter.Update(!_io_expander->digitalRead(_feed_tank_level_low_pin));
     }
   }
 
 
+  //
+  // Request the pump on.  The drive is applied by update_pump_drive().
+  //
   void start_pumping() {
-    if (_feed_pump_drive_pin >= 0) {
-      // Using digital output mode:
-      _io_expander->digitalWrite(_feed_pump_drive_pin, HIGH);
-
-      _pump_active = true;
+    if (!_pump_request) {
+      _pump_start_count++;
+      if (_pump_drive_mode == PUMP_DRIVE_SOFT) {
+        _ramp_up_active = true;
+        _ramp_elapsed = 0;
+      }
+    }
+    _pump_request = true;
+    if (_pump_drive_mode == PUMP_DRIVE_HARD) {
+      update_pump_drive();
     }
   }
 
 
+  //
+  // Request the pump off.  The drive is applied by update_pump_drive().
+  //
   void stop_pumping() {
-    if (_feed_pump_drive_pin >= 0) {
-      // Using digital output mode:
-      _io_expander->digitalWrite(_feed_pump_drive_pin, LOW);
+    _pump_request = false;
+    _ramp_up_active = false;
+    if (_pump_drive_mode == PUMP_DRIVE_HARD) {
+      update_pump_drive();
+    }
+  }
+
+
+  //
+  // Move the pump duty toward the request, in one step for hard drive or along the ramp for soft drive.
+  //
+  void update_pump_drive() {
+    uint8_t target = _pump_request ? PUMP_DUTY_MAX : 0;
+
+    if ((_pump_drive_mode == PUMP_DRIVE_HARD) || (_pump_duty == target)) {
+      _pump_duty = target;
+    } else if (_pump_request) {
+      // Jump to the start duty then ramp linearly to full duty
+      uint32_t step = (_ramp_up_msec > 0) ? max((uint32_t)1, ((uint32_t)(PUMP_DUTY_MAX - _ramp_start_duty) * TANK_UPDATE_PERIOD_MSEC) / _ramp_up_msec) : PUMP_DUTY_MAX;
+      uint32_t duty = max((uint32_t)_pump_duty, (uint32_t)_ramp_start_duty) + step;
+      _pump_duty = (duty >= PUMP_DUTY_MAX) ? PUMP_DUTY_MAX : duty;
+    } else {
+      uint32_t step = (_ramp_down_msec > 0) ? max((uint32_t)1, ((uint32_t)PUMP_DUTY_MAX * TANK_UPDATE_PERIOD_MSEC) / _ramp_down_msec) : PUMP_DUTY_MAX;
+      // Below the start duty the pump stalls, cut it off
+      _pump_duty = ((_pump_duty <= step) || ((_pump_duty - step) < _ramp_start_duty)) ? 0 : (_pump_duty - step);
+    }
 
-      _pump_active = false;
+    if (_ramp_up_active && (_pump_duty == PUMP_DUTY_MAX)) {
+      _ramp_up_active = false;
+      _ramp_up_stats.Add(_ramp_elapsed);
+    }
+
+    write_pump_output();
+  }
+
+
+  void write_pump_output() {
+    if (_feed_pump_drive_pin >= 0) {
+      if (_pump_drive_mode == PUMP_DRIVE_SOFT) {
+        _io_expander->analogWrite(_feed_pump_drive_pin, PUMP_PWM_ACTIVE_LOW ? (PUMP_DUTY_MAX - _pump_duty) : _pump_duty);
+      } else {
+        // Using digital output mode:
+        _io_expander->digitalWrite(_feed_pump_drive_pin, (_pump_duty > 0) ? HIGH : LOW);
+      }
+
+      _pump_active = (_pump_duty > 0);
     }
   }
 };
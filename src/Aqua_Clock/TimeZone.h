@@ -0,0 +1,253 @@
+/*
+ * Time zone and daylight saving rules for the Aqua Clock
+ *
+ * The RTC keeps UTC and the local time is derived with the rules of one time zone, described the
+ * way a POSIX TZ string does: a standard offset, a daylight offset and the month/week/weekday/time of
+ * the two daylight saving transitions.  The UTC instants of the transitions for every year from
+ * TZ_FIRST_YEAR on are computed at compile time into constexpr tables, so finding the offset for a
+ * UTC time is a table lookup.  Change LOCAL_TIME_ZONE to move the clock.
+ *
+ * Only C++11 constexpr is available, so every compile time helper is a single return expression and
+ * the tables are expanded from a custom index sequence.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef TIME_ZONE_H
+#define TIME_ZONE_H
+
+#include <Arduino.h>
+
+
+// A daylight saving transition, POSIX "Mm.w.d/time"
+typedef struct {
+  uint8_t month;    /* 1-12 */
+  uint8_t week;     /* 1-4 for the nth weekday of the month, 5 for the last */
+  uint8_t weekday;  /* 0=Sunday */
+  int16_t minute;   /* Local time of the transition, minutes after midnight of the offset in effect before it */
+} TZ_TRANSITION_RULE_T;
+
+typedef struct {
+  const char *name;       /* Equivalent POSIX TZ string */
+  int16_t std_offset_min; /* Local minus UTC in standard time */
+  int16_t dst_offset_min; /* Local minus UTC in daylight time */
+  bool has_dst;
+  TZ_TRANSITION_RULE_T dst_start;
+  TZ_TRANSITION_RULE_T dst_end;
+} TIME_ZONE_T;
+
+// Broken down time
+typedef struct {
+  uint16_t year;
+  uint8_t month;   /* 1-12 */
+  uint8_t date;    /* 1-31 */
+  uint8_t weekday; /* 0=Sunday */
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+} TIME_FIELDS_T;
+
+
+//
+// Zone the clock shows.  US Pacific, daylight time from the second Sunday of March 02:00 to the first
+// Sunday of November 02:00.
+//
+constexpr TIME_ZONE_T LOCAL_TIME_ZONE = { "PST8PDT,M3.2.0,M11.1.0", -480, -420, true, { 3, 2, 0, 120 }, { 11, 1, 0, 120 } };
+
+constexpr uint16_t TZ_FIRST_YEAR = 2020;
+constexpr uint8_t TZ_NUM_YEARS = 80;
+
+
+//
+// Calendar arithmetic on days since 1970-01-01, for years from 1970 on.
+// Days from 1970-01-01 to the first of March of a year, counting years from March so leap days fall at the end
+constexpr int32_t tz_days_to_march_year(int32_t y) {
+  return y * 365 + y / 4 - y / 100 + y / 400 - 719468;
+}
+
+
+constexpr int32_t tz_days_into_march_year(uint8_t month) {
+  return (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5;
+}
+
+
+constexpr int32_t tz_days_from_civil(uint16_t year, uint8_t month, uint8_t date) {
+  return tz_days_to_march_year(year - (month <= 2 ? 1 : 0)) + tz_days_into_march_year(month) + date - 1;
+}
+
+
+constexpr bool tz_is_leap_year(uint16_t year) {
+  return ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+}
+
+
+constexpr uint8_t tz_days_in_month(uint16_t year, uint8_t month) {
+  return (month == 2) ? (tz_is_leap_year(year) ? 29 : 28) : (((month == 4) || (month == 6) || (month == 9) || (month == 11)) ? 30 : 31);
+}
+
+
+constexpr uint8_t tz_weekday_from_days(int32_t days) {
+  return (uint8_t)((days + 4) % 7);
+}
+
+
+// Date of the nth (or last) weekday of a month
+constexpr uint8_t tz_rule_date_candidate(uint8_t first_weekday, const TZ_TRANSITION_RULE_T &rule) {
+  return 1 + (rule.weekday + 7 - first_weekday) % 7 + 7 * (rule.week - 1);
+}
+
+
+constexpr uint8_t tz_rule_date(uint16_t year, const TZ_TRANSITION_RULE_T &rule) {
+  return (tz_rule_date_candidate(tz_weekday_from_days(tz_days_from_civil(year, rule.month, 1)), rule) > tz_days_in_month(year, rule.month))
+           ? tz_rule_date_candidate(tz_weekday_from_days(tz_days_from_civil(year, rule.month, 1)), rule) - 7
+           : tz_rule_date_candidate(tz_weekday_from_days(tz_days_from_civil(year, rule.month, 1)), rule);
+}
+
+
+// UTC instant of a transition, the rule time is in the local time in effect before it
+constexpr uint32_t tz_transition_utc(uint16_t year, const TZ_TRANSITION_RULE_T &rule, int16_t offset_before_min) {
+  return (uint32_t)((int64_t)tz_days_from_civil(year, rule.month, tz_rule_date(year, rule)) * 86400
+                    + (int32_t)rule.minute * 60 - (int32_t)offset_before_min * 60);
+}
+
+
+constexpr uint32_t tz_year_start_utc(uint16_t year) {
+  return (uint32_t)((int64_t)tz_days_from_civil(year, 1, 1) * 86400);
+}
+
+
+constexpr uint32_t tz_dst_start_utc(const TIME_ZONE_T &zone, uint16_t year) {
+  return zone.has_dst ? tz_transition_utc(year, zone.dst_start, zone.std_offset_min) : 0;
+}
+
+
+constexpr uint32_t tz_dst_end_utc(const TIME_ZONE_T &zone, uint16_t year) {
+  return zone.has_dst ? tz_transition_utc(year, zone.dst_end, zone.dst_offset_min) : 0;
+}
+
+
+// Known US transitions check the calendar math at compile time
+constexpr TIME_ZONE_T TZ_CHECK_US_EASTERN = { "EST5EDT,M3.2.0,M11.1.0", -300, -240, true, { 3, 2, 0, 120 }, { 11, 1, 0, 120 } };
+static_assert(tz_dst_start_utc(TZ_CHECK_US_EASTERN, 2024) == 1710054000UL, "DST start of 2024-03-10 07:00 UTC");
+static_assert(tz_dst_end_utc(TZ_CHECK_US_EASTERN, 2024) == 1730613600UL, "DST end of 2024-11-03 06:00 UTC");
+static_assert(tz_dst_start_utc(TZ_CHECK_US_EASTERN, 2021) == 1615705200UL, "DST start of 2021-03-14 07:00 UTC");
+static_assert(tz_year_start_utc(2100) == 4102444800UL, "2100 is not a leap year");
+
+
+//
+// Compile time tables of the year starts and transitions, one entry per year from TZ_FIRST_YEAR.
+//
+template<uint8_t... I>
+struct TzIndexList {};
+
+template<uint8_t N, uint8_t... I>
+struct TzMakeIndexList : TzMakeIndexList<N - 1, N - 1, I...> {};
+
+template<uint8_t... I>
+struct TzMakeIndexList<0, I...> {
+  typedef TzIndexList<I...> type;
+};
+
+template<typename L>
+struct TzTransitionTable;
+
+template<uint8_t... I>
+struct TzTransitionTable<TzIndexList<I...>> {
+  static constexpr uint32_t year_start[sizeof...(I)] = { tz_year_start_utc(TZ_FIRST_YEAR + I)... };
+  static constexpr uint32_t dst_start[sizeof...(I)] = { tz_dst_start_utc(LOCAL_TIME_ZONE, TZ_FIRST_YEAR + I)... };
+  static constexpr uint32_t dst_end[sizeof...(I)] = { tz_dst_end_utc(LOCAL_TIME_ZONE, TZ_FIRST_YEAR + I)... };
+};
+
+template<uint8_t... I>
+constexpr uint32_t TzTransitionTable<TzIndexList<I...>>::year_start[];
+template<uint8_t... I>
+constexpr uint32_t TzTransitionTable<TzIndexList<I...>>::dst_start[];
+template<uint8_t... I>
+constexpr uint32_t TzTransitionTable<TzIndexList<I...>>::dst_end[];
+
+typedef TzTransitionTable<TzMakeIndexList<TZ_NUM_YEARS>::type> TZ_TABLE;
+
+
+//
+// Is a UTC time in daylight saving time.  Outside the table years standard time is used.
+//
+inline bool tz_is_dst(uint32_t utc) {
+  if (!LOCAL_TIME_ZONE.has_dst || (utc < TZ_TABLE::year_start[0])
+      || (utc >= tz_year_start_utc(TZ_FIRST_YEAR + TZ_NUM_YEARS))) {
+    return false;
+  }
+  // Years are never shorter than 365 days, the estimate is the year or the one after it
+  uint32_t index = (utc - TZ_TABLE::year_start[0]) / (365UL * 86400UL);
+  if (index >= TZ_NUM_YEARS) {
+    index = TZ_NUM_YEARS - 1;
+  }
+  if (utc < TZ_TABLE::year_start[index]) {
+    index--;
+  }
+
+  uint32_t start = TZ_TABLE::dst_start[index];
+  uint32_t end = TZ_TABLE::dst_end[index];
+  if (start < end) {
+    return (utc >= start) && (utc < end);
+  }
+  // Southern hemisphere, daylight time spans the new year
+  return (utc >= start) || (utc < end);
+}
+
+
+inline int16_t tz_offset_minutes(uint32_t utc) {
+  return tz_is_dst(utc) ? LOCAL_TIME_ZONE.dst_offset_min : LOCAL_TIME_ZONE.std_offset_min;
+}
+
+
+//
+// Convert a local time to UTC.  A local time repeated at the end of daylight time is taken as the
+// first, daylight, occurrence and a skipped one is moved forward by the daylight shift.
+//
+inline uint32_t tz_local_to_utc(uint32_t local) {
+  uint32_t utc_as_std = local - (int32_t)LOCAL_TIME_ZONE.std_offset_min * 60;
+  uint32_t utc_as_dst = local - (int32_t)LOCAL_TIME_ZONE.dst_offset_min * 60;
+  if (tz_is_dst(utc_as_dst)) {
+    return utc_as_dst;
+  }
+  return utc_as_std;
+}
+
+
+inline uint32_t tz_utc_to_local(uint32_t utc) {
+  return utc + (int32_t)tz_offset_minutes(utc) * 60;
+}
+
+
+//
+// Epoch seconds to and from broken down time.
+//
+inline uint32_t tz_epoch_from_fields(const TIME_FIELDS_T &fields) {
+  return (uint32_t)tz_days_from_civil(fields.year, fields.month, fields.date) * 86400UL
+         + (uint32_t)fields.hour * 3600UL + (uint32_t)fields.minute * 60UL + fields.second;
+}
+
+
+inline TIME_FIELDS_T tz_fields_from_epoch(uint32_t epoch) {
+  TIME_FIELDS_T fields;
+  uint32_t days = epoch / 86400UL;
+  uint32_t seconds = epoch % 86400UL;
+  fields.hour = seconds / 3600;
+  fields.minute = (seconds / 60) % 60;
+  fields.second = seconds % 60;
+  fields.weekday = tz_weekday_from_days(days);
+
+  // Walk the March based 400 year cycle back to the calendar date
+  uint32_t z = days + 719468UL;
+  uint32_t era = z / 146097UL;
+  uint32_t doe = z - era * 146097UL;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  fields.date = doy - (153 * mp + 2) / 5 + 1;
+  fields.month = (mp < 10) ? (mp + 3) : (mp - 9);
+  fields.year = yoe + era * 400 + ((fields.month <= 2) ? 1 : 0);
+  return fields;
+}
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Trend Plot class for the Aqua Clock
+ *
+ * Records the recent raw and linearized elevation, setpoint and valve state of every column in a fixed
+ * ring, one sample every READINGS_PER_SAMPLE sensor readings, and plots a column on the diagnostics screen.
+ * The plot is kept in its own palette canvas used as a ring of pixel columns, so each frame only draws
+ * the pixel columns of the samples taken since the last frame.  The ring is copied into the UI canvas in
+ * two pieces, oldest sample on the left, which scrolls the plot without redrawing it.
+ * Elevation readings grow downward, so higher water is drawn higher on the plot.
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#ifndef TREND_PLOT_H
+#define TREND_PLOT_H
+
+#include <Arduino.h>
+
+#include "ColumnConfig.h"
+#include "ColumnManager.h"
+#include "PaletteCanvas.h"
+#include "RangeUtil.h"
+#include "Stats.h"
+
+
+class TrendPlot {
+public:
+
+  typedef enum {
+    TREND_VALVES_CLOSED,
+    TREND_VALVE_FILL,
+    TREND_VALVE_DRAIN
+  } TREND_VALVE_T;
+
+  typedef struct {
+    uint16_t raw_mm;
+    uint16_t linear_mm;
+    uint16_t setpoint_mm;
+    uint8_t valve;  // TREND_VALVE_T
+  } TREND_SAMPLE_T;
+
+  static constexpr int16_t PLOT_WIDTH = 128;  // Samples kept per column, one pixel column each
+  static constexpr int16_t TRACE_HEIGHT = 80;
+  static constexpr int16_t VALVE_BAND_HEIGHT = 4;
+  static constexpr int16_t PLOT_HEIGHT = TRACE_HEIGHT + VALVE_BAND_HEIGHT;
+  static constexpr uint8_t READINGS_PER_SAMPLE = 4;  // 100 msec per sample, 12.8 seconds across the plot
+
+  // Trace colors, default palette colors so the plot canvas copies straight into the UI canvas
+  static constexpr uint16_t COLOR_BACKGROUND = 0x0000;  // Black
+  static constexpr uint16_t COLOR_RAW = 0x001F;         // Blue
+  static constexpr uint16_t COLOR_LINEAR = 0x07FF;      // Cyan
+  static constexpr uint16_t COLOR_SETPOINT = 0xFFE0;    // Yellow
+  static constexpr uint16_t COLOR_FILL = 0x07E0;        // Green
+  static constexpr uint16_t COLOR_DRAIN = 0xF800;       // Red
+
+private:
+
+  RangeUtil **_column_ranges;
+  ColumnManager **_column_managers;
+
+  // Sample n of a column is kept at ring index n % PLOT_WIDTH
+  TREND_SAMPLE_T _samples[NUM_COLUMNS][PLOT_WIDTH];
+  uint32_t _sample_count[NUM_COLUMNS];
+  uint32_t _last_reading_count[NUM_COLUMNS];
+
+  // Plot of one column.  Sample n is drawn in pixel column n % PLOT_WIDTH.
+  PaletteCanvas *_plot;
+  uint8_t _plot_column = NUM_COLUMNS;
+  uint32_t _plot_sample_count = 0;  // Samples drawn into the plot
+
+  RunningStats _columns_drawn_stats;
+  RunningStats _draw_usec_stats;
+
+public:
+
+  TrendPlot(RangeUtil **column_ranges, ColumnManager **column_managers) {
+    _column_ranges = column_ranges;
+    _column_managers = column_managers;
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _sample_count[i] = 0;
+      _last_reading_count[i] = 0;
+    }
+    _plot = new PaletteCanvas(PLOT_WIDTH, PLOT_HEIGHT);
+  }
+
+
+  //
+  // Record a sample of every column that took READINGS_PER_SAMPLE new readings.  Called every loop.
+  //
+  void Sample() {
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      uint32_t readings = _column_ranges[i]->Get_Reading_Count();
+      if (readings - _last_reading_count[i] < READINGS_PER_SAMPLE) {
+        continue;
+      }
+      _last_reading_count[i] = readings;
+
+      TREND_SAMPLE_T &sample = _samples[i][_sample_count[i] % PLOT_WIDTH];
+      sample.raw_mm = _column_ranges[i]->Get_Newest_Reading();
+      sample.linear_mm = _column_ranges[i]->Get_Linearized_Median_Reading();
+      sample.setpoint_mm = _column_managers[i]->Get_Target_Setpoint_MM();
+      sample.valve = valve_state(_column_managers[i]->Get_State());
+      _sample_count[i]++;
+    }
+  }
+
+
+  uint32_t Get_Sample_Count(uint8_t column) {
+    return _sample_count[column];
+  }
+
+
+  // Newest sample of a column, zeros before the first one
+  TREND_SAMPLE_T Get_Newest_Sample(uint8_t column) {
+    TREND_SAMPLE_T sample = { 0, 0, 0, TREND_VALVES_CLOSED };
+    if (_sample_count[column] > 0) {
+      sample = _samples[column][(_sample_count[column] - 1) % PLOT_WIDTH];
+    }
+    return sample;
+  }
+
+
+  //
+  // Bring the plot of a column up to date and copy it into the canvas with its upper left corner at x, y.
+  //
+  void Draw(PaletteCanvas *canvas, int16_t x, int16_t y, uint8_t column) {
+    uint32_t start_usec = micros();
+    uint32_t count = _sample_count[column];
+    uint32_t first = (count > PLOT_WIDTH) ? count - PLOT_WIDTH : 0;
+
+    // Start over for another column or once the samples not yet drawn have been overwritten
+    if ((column != _plot_column) || (_plot_sample_count < first)) {
+      _plot->fillScreen(COLOR_BACKGROUND);
+      _plot_column = column;
+      _plot_sample_count = first;
+    }
+
+    uint32_t drawn = count - _plot_sample_count;
+    while (_plot_sample_count < count) {
+      draw_sample(column, _plot_sample_count++, first);
+    }
+
+    // Oldest sample on the left
+    int16_t oldest = count % PLOT_WIDTH;
+    canvas->Blit_Canvas(x, y, _plot, oldest, 0, PLOT_WIDTH - oldest, PLOT_HEIGHT);
+    canvas->Blit_Canvas(x + PLOT_WIDTH - oldest, y, _plot, 0, 0, oldest, PLOT_HEIGHT);
+
+    _columns_drawn_stats.Add(drawn);
+    _draw_usec_stats.Add(micros() - start_usec);
+  }
+
+
+  void Print_Stats() {
+    Serial.print("   Trend pixel columns drawn per frame: ");
+    _columns_drawn_stats.Print("");
+    Serial.println();
+    Serial.print("   Trend usec per frame: ");
+    _draw_usec_stats.Print("");
+    Serial.println();
+  }
+
+
+  void Reset_Stats() {
+    _columns_drawn_stats.Reset();
+    _draw_usec_stats.Reset();
+  }
+
+
+protected:
+
+  TREND_VALVE_T valve_state(ColumnManager::COLUMN_STATE_TYPE_T state) {
+    switch (state) {
+      case ColumnManager::COLUMN_FILL_ACTIVE:
+      case ColumnManager::COLUMN_MANUAL_FILL:
+        return TREND_VALVE_FILL;
+      case ColumnManager::COLUMN_DRAIN_ACTIVE:
+      case ColumnManager::COLUMN_MANUAL_DRAIN:
+        return TREND_VALVE_DRAIN;
+      default:
+        return TREND_VALVES_CLOSED;
+    }
+  }
+
+
+  //
+  // Plot line of an elevation on the column scale, clipped to the trace.
+  //
+  int16_t trace_y(uint8_t column, uint16_t elevation_mm) {
+    int32_t lower = _column_managers[column]->Get_Setpoint_Lower_Limit();
+    int32_t upper = _column_managers[column]->Get_Setpoint_Upper_Limit();
+    int32_t value = constrain((int32_t)elevation_mm, lower, upper);
+    if (upper <= lower) {
+      return 0;
+    }
+    return (int16_t)((value - lower) * (TRACE_HEIGHT - 1) / (upper - lower));
+  }
+
+
+  //
+  // Draw the pixel column of one sample.  The linearized trace is joined to the sample before it.
+  //
+  void draw_sample(uint8_t column, uint32_t n, uint32_t first) {
+    const TREND_SAMPLE_T &sample = _samples[column][n % PLOT_WIDTH];
+    int16_t x = n % PLOT_WIDTH;
+
+    _plot->fillRect(x, 0, 1, TRACE_HEIGHT, COLOR_BACKGROUND);
+    _plot->drawPixel(x, trace_y(column, sample.raw_mm), COLOR_RAW);
+    _plot->drawPixel(x, trace_y(column, sample.setpoint_mm), COLOR_SETPOINT);
+
+    int16_t linear_y = trace_y(column, sample.linear_mm);
+    int16_t prior_y = linear_y;
+    if (n > first) {
+      prior_y = trace_y(column, _samples[column][(n - 1) % PLOT_WIDTH].linear_mm);
+    }
+    int16_t top = min(linear_y, prior_y);
+    _plot->drawFastVLine(x, top, max(linear_y, prior_y) - top + 1, COLOR_LINEAR);
+
+    uint16_t band_color = COLOR_BACKGROUND;
+    if (sample.valve == TREND_VALVE_FILL) {
+      band_color = COLOR_FILL;
+    } else if (sample.valve == TREND_VALVE_DRAIN) {
+      band_color = COLOR_DRAIN;
+    }
+    _plot->fillRect(x, TRACE_HEIGHT, 1, VALVE_BAND_HEIGHT, band_color);
+  }
+};
+
+#endif
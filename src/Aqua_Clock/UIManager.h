@@ -4,6 +4,16 @@
  * Manages the user interface implemented via a small OLED screen and 5 input buttons.
  * The UI is implemented using a series of states that define what should be displayed
  * and what user inputs are for that given state.  
+ * Each frame is drawn into a 4 bit palette canvas and a FrameFlusher sends the changed parts of it to the display.
+ * The canvases are double buffered by a DisplayFlushTask, which sends them from the other core.
+ * Every screen declares the inputs it shows in screen_signature().  A frame is only drawn and sent when
+ * the signature changes, a key is held or an animation is running, otherwise the state is left alone.
+ * Drawn water levels ease toward the readings through LevelAnimators.  While one is moving the UI updates
+ * at the faster ANIMATION_PERIOD_MS, the tile flusher only sends the few tiles the water changed.
+ * The keys are scanned every loop by a KeyPad.  Each menu update takes the key events queued since the last
+ * one, so no press is lost between updates and held up/down keys repeat faster the longer they are held.
+ * The idle screen is an ambient clock face, large anti-aliased numerals and the column states from the glyph
+ * atlas.  It only changes with the minute or a column state and the panel is dimmed in the sleep window.
  *
  *
  * @author Joe Mohos
@@ -22,9 +32,15 @@
 
 #include "pins.h"
 #include "io_expander_config.h"
+#include "ClockFace.h"
 #include "ClockManager.h"
+#include "ColumnConfig.h"
 #include "ColumnManager.h"
+#include "DisplayFlushTask.h"
+#include "KeyPad.h"
+#include "LevelAnimator.h"
 #include "TankManager.h"
+#include "TrendPlot.h"
 
 
 class UIManager {
@@ -59,23 +75,25 @@ private:
 #define TEXT_COLOR_HIGHLIGHT RED
 
   // Graphics drivers for the real display and a buffered canvas to
-  // allow for drawing without flicker
+  // allow for drawing without flicker.  The canvas is the back buffer of the flush task.
   Adafruit_SSD1351 *_display;
-  GFXcanvas16 *_canvas;
+  PaletteCanvas *_canvas;
+  DisplayFlushTask *_flush_task;
 
   // Graphic element properties
   const int16_t COLUMN_GRAPHIC_WIDTH = 18;
   const int16_t COLUMN_GRAPHIC_HEIGHT = 64;
+  const int16_t COLUMN_GRAPHIC_X0 = 18;
+  const int16_t COLUMN_GRAPHIC_SPACING = (SCREEN_WIDTH - 20) / NUM_COLUMNS;
 
 
   /* Handles to system components the UI will interact with */
   SX1509 *_io_expander;
-  RangeUtil *_hour_column_range;
-  RangeUtil *_min_10s_column_range;
-  RangeUtil *_min_1s_column_range;
-  ColumnManager *_column_manager_hour;
-  ColumnManager *_column_manager_min_10s;
-  ColumnManager *_column_manager_min_1s;
+  KeyPad *_keypad;
+  TrendPlot *_trend_plot;
+  ClockFace *_clock_face;
+  RangeUtil **_column_ranges;
+  ColumnManager **_column_managers;
   TankManager *_tank;
   ClockManager *_clock_man;
 
@@ -118,49 +136,73 @@ private:
   } MENU_STATE_T;
   MENU_STATE_T _menu_state = MENU_STATE_0_INIT;
 
-  // Keyboard input debouncing support
-  elapsedMillis _menu_button_debounce_period_elapsed;
   elapsedMillis _menu_state_update_period_elapsed;
-  static constexpr int MENU_BUTTON_DEBOUNCE_PERIOD_MS = 50;
   static constexpr int MENU_STATE_UPDATE_PERIOD_MS = 100;
+  static constexpr int ANIMATION_PERIOD_MS = 33;  // UI update period while a water level is moving
+  static constexpr uint16_t SETPOINT_STEP_MM = 2;  // Setpoint change per key press or repeat
+  static constexpr uint32_t DISPLAY_LOCK_TIMEOUT_MS = 100;  // Longer than a full frame transfer
+  static constexpr uint8_t CONTRAST_FULL = 0x0F;  // SSD1351 master contrast, 16ths of the color contrasts
+  static constexpr uint8_t CONTRAST_DIM = 0x03;
+
+  // Display power and key activity, used by the sleep mode
+  bool _display_enable = true;
+  bool _display_dim = false;
+  elapsedMillis _time_since_key_msec;
+
+  // Render on change
+  bool _render_always = false;
+  bool _force_render = true;
+  bool _animating = false;     // Set while drawing a screen that must be redrawn on the next update
+  bool _level_motion = false;  // Set while drawing a water level that has not reached its reading
+  uint32_t _level_motion_frames = 0;
+
+  // Drawn water levels
+  LevelAnimator _column_levels[NUM_COLUMNS];
+  LevelAnimator _tank_level;
+  uint32_t _rendered_signature = 0;
+  uint32_t _frames_rendered = 0;
+  uint32_t _frames_skipped = 0;
+  uint32_t _minute_rendered = 0;
+  uint32_t _minute_skipped = 0;
+  uint32_t _last_minute_rendered = 0;
+  uint32_t _last_minute_skipped = 0;
+  uint32_t _minute_face_usec = 0;
+  uint32_t _last_minute_face_usec = 0;
+  elapsedMillis _render_minute_elapsed;
+
+  // Time to draw a frame, with the text and sprites from the glyph atlas [1] or drawn by Adafruit GFX [0]
+  RunningStats _render_usec_stats[2];
 
   OPERATING_MODE_T _operating_mode = OPERATING_MODE_CLOCK;
 
   // Water column regulator override enables and setpoints for
   // UI diagnostic actions.
-  bool _hour_override_setpoint_enable = false;
-  bool _min_10s_override_setpoint_enable = false;
-  bool _min_1s_override_setpoint_enable = false;
-  uint16_t _hour_override_setpoint = 150;
-  uint16_t _min_10s_override_setpoint = 150;
-  uint16_t _min_1s_override_setpoint = 150;
-
-  // UI keyboard input parameters
-  typedef struct {
-    bool left_button_active = false;
-    bool right_button_active = false;
-    bool up_button_active = false;
-    bool down_button_active = false;
-    bool enter_button_active = false;
-  } Buttons;
-  Buttons cur_button_status;
-  Buttons pre_button_status;
+  // One entry per column in COLUMN_TABLE.
+  bool _override_setpoint_enable[NUM_COLUMNS];
+  uint16_t _override_setpoint[NUM_COLUMNS];
+
+  // Presses and repeats of each key taken from the key pad for this menu update
+  uint8_t _key_steps[KeyPad::KEY_COUNT];
 
 //Button accessor macros
 // These detect level events on the button inputs.
-#define LEFT_BUTTON_ACTIVE (cur_button_status.left_button_active == true)
-#define RIGHT_BUTTON_ACTIVE (cur_button_status.right_button_active == true)
-#define UP_BUTTON_ACTIVE (cur_button_status.up_button_active == true)
-#define DOWN_BUTTON_ACTIVE (cur_button_status.down_button_active == true)
-#define ENTER_BUTTON_ACTIVE (cur_button_status.enter_button_active == true)
-
-// Button transition detection macros
-// These detect edge events on the button inputs.
-#define LEFT_BUTTON_PRESSED ((pre_button_status.left_button_active == false) && (cur_button_status.left_button_active == true))
-#define RIGHT_BUTTON_PRESSED ((pre_button_status.right_button_active == false) && (cur_button_status.right_button_active == true))
-#define UP_BUTTON_PRESSED ((pre_button_status.up_button_active == false) && (cur_button_status.up_button_active == true))
-#define DOWN_BUTTON_PRESSED ((pre_button_status.down_button_active == false) && (cur_button_status.down_button_active == true))
-#define ENTER_BUTTON_PRESSED ((pre_button_status.enter_button_active == false) && (cur_button_status.enter_button_active == true))
+#define LEFT_BUTTON_ACTIVE (_keypad->Is_Active(KeyPad::KEY_LEFT))
+#define RIGHT_BUTTON_ACTIVE (_keypad->Is_Active(KeyPad::KEY_RIGHT))
+#define UP_BUTTON_ACTIVE (_keypad->Is_Active(KeyPad::KEY_UP))
+#define DOWN_BUTTON_ACTIVE (_keypad->Is_Active(KeyPad::KEY_DOWN))
+#define ENTER_BUTTON_ACTIVE (_keypad->Is_Active(KeyPad::KEY_ENTER))
+
+// Button press detection macros
+// These detect press and auto-repeat events on the button inputs.
+#define LEFT_BUTTON_PRESSED (_key_steps[KeyPad::KEY_LEFT] > 0)
+#define RIGHT_BUTTON_PRESSED (_key_steps[KeyPad::KEY_RIGHT] > 0)
+#define UP_BUTTON_PRESSED (_key_steps[KeyPad::KEY_UP] > 0)
+#define DOWN_BUTTON_PRESSED (_key_steps[KeyPad::KEY_DOWN] > 0)
+#define ENTER_BUTTON_PRESSED (_key_steps[KeyPad::KEY_ENTER] > 0)
+
+// Number of steps to move an edited value, every press and auto-repeat since the last update
+#define UP_BUTTON_STEPS (_key_steps[KeyPad::KEY_UP])
+#define DOWN_BUTTON_STEPS (_key_steps[KeyPad::KEY_DOWN])
 
   // Non-volatile memory storage handler
   Preferences preferences;
@@ -187,29 +229,35 @@ private:
 public:
 
   /* Constructor - Capture access to all relevant system components */
+  /* Column ranges and managers are arrays of NUM_COLUMNS entries ordered as COLUMN_TABLE */
   UIManager(SX1509 *io_expander, /* Button inputs */
-            RangeUtil *hour_column_range,
-            RangeUtil *min_10s_column_range,
-            RangeUtil *min_1s_column_range,
-            ColumnManager *column_manager_hour,
-            ColumnManager *column_manager_min_10s,
-            ColumnManager *column_manager_min_1s,
+            RangeUtil **column_ranges,
+            ColumnManager **column_managers,
             TankManager *tank,
             ClockManager *clock_man) {
     _io_expander = io_expander;
-    _hour_column_range = hour_column_range;
-    _min_10s_column_range = min_10s_column_range;
-    _min_1s_column_range = min_1s_column_range;
-    _column_manager_hour = column_manager_hour;
-    _column_manager_min_10s = column_manager_min_10s;
-    _column_manager_min_1s = column_manager_min_1s;
+    _keypad = new KeyPad(io_expander);
+    _keypad->Set_Repeat_Enable(KeyPad::KEY_UP, true);
+    _keypad->Set_Repeat_Enable(KeyPad::KEY_DOWN, true);
+    for (uint8_t i = 0; i < KeyPad::KEY_COUNT; i++) {
+      _key_steps[i] = 0;
+    }
+    _column_ranges = column_ranges;
+    _column_managers = column_managers;
+    _trend_plot = new TrendPlot(column_ranges, column_managers);
+    _clock_face = new ClockFace();
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _override_setpoint_enable[i] = false;
+      _override_setpoint[i] = 150;
+    }
     _tank = tank;
     _clock_man = clock_man;
 
     // Initiate both a real and virtual graphics interface.  They are the same size so we can
     // simply copy the canvas to the display when we are done with a UI update cycle.
     _display = new Adafruit_SSD1351(SCREEN_WIDTH, SCREEN_HEIGHT, &SPI, SPI_OLED_CS_PIN, SPI_OLED_DC_PIN, SPI_OLED_RST_PIN);
-    _canvas = new GFXcanvas16(SCREEN_WIDTH, SCREEN_HEIGHT);
+    _flush_task = new DisplayFlushTask(_display, SCREEN_WIDTH, SCREEN_HEIGHT);
+    _canvas = _flush_task->Get_Back_Canvas();
   }
 
 
@@ -236,10 +284,16 @@ public:
     _display->fillScreen(BLACK);
     _display->setTextWrap(false);  // Don't allow text to wrap a line
 
-    // Initialize the virtual display buffer canvas with the same settings.
-    _canvas->cp437(true);
-    _canvas->setTextWrap(false);
-    _canvas->fillScreen(BLACK);
+    // Initialize both virtual display buffer canvases with the same settings.
+    for (uint8_t i = 0; i < 2; i++) {
+      _canvas = _flush_task->Get_Back_Canvas();
+      _canvas->cp437(true);
+      _canvas->setTextWrap(false);
+      _canvas->fillScreen(BLACK);
+    }
+
+    // Send the frames from the other core from now on
+    _flush_task->Startup();
   }
 
 
@@ -251,15 +305,52 @@ public:
     static MENU_STATE_T prior_menu_state = MENU_STATE_0_INIT;
 
     debounce_buttons();
+    _trend_plot->Sample();
 
-    // Rate control the UI processing
-    if (_menu_state_update_period_elapsed < MENU_STATE_UPDATE_PERIOD_MS) {
+    // Rate control the UI processing, faster while the water levels are moving
+    uint32_t update_period_ms = MENU_STATE_UPDATE_PERIOD_MS;
+    if (_level_motion) {
+      update_period_ms = ANIMATION_PERIOD_MS;
+    }
+    if (_menu_state_update_period_elapsed < update_period_ms) {
       return;
     }
     _menu_state_update_period_elapsed = 0;
 
     detect_button_activity();
 
+    // Only watch the keys while the display is off, a key press wakes it without acting on the menu
+    if (!_display_enable) {
+      return;
+    }
+
+    // The clock face dims in the sleep window, the menus are always shown at full contrast
+    set_display_dim((_menu_state == MENU_STATE_1_IDLE) && _clock_man->Is_Sleep_Time());
+
+    // Leave the screen alone while nothing it shows changed.  Held keys act on every update.
+    count_render_minute();
+    uint32_t signature = screen_signature();
+    if (!_render_always && !_force_render && !_animating && !_level_motion && (signature == _rendered_signature)
+        && !is_key_activity()) {
+      _frames_skipped++;
+      _minute_skipped++;
+      return;
+    }
+    // The signature is taken before the state handler so edits it makes are drawn on the next update
+    _rendered_signature = signature;
+    _force_render = false;
+    if (_level_motion) {
+      _level_motion_frames++;
+    }
+    _animating = false;
+    _level_motion = false;
+    _frames_rendered++;
+    _minute_rendered++;
+
+
+    // Draw into the canvas that is not in flight
+    _canvas = _flush_task->Get_Back_Canvas();
+    uint32_t render_start_usec = micros();
 
     // Before any UI state updates, clear the buffer, restore the cursor
     // set the text size to normal so we don't have to do it in each state.
@@ -312,13 +403,19 @@ public:
         break;
     } /* switch state */
 
-    // Record history for button transition detection
-    pre_button_status = cur_button_status;
+    uint32_t render_usec = micros() - render_start_usec;
+    _render_usec_stats[_canvas->Is_Glyph_Atlas_Enabled() ? 1 : 0].Add(render_usec);
+    if (prior_menu_state == MENU_STATE_1_IDLE) {
+      _minute_face_usec += render_usec;
+    }
 
-    // After updating all display elements, transfer the contents of the virtual
-    // display into the real one.  This method prevents flicker that would happen if we
-    // directly modified the display element by element.
-    _display->drawRGBBitmap(0, 0, _canvas->getBuffer(), _canvas->width(), _canvas->height());
+    // After updating all display elements, hand the virtual display over to be transferred
+    // into the real one.  This method prevents flicker that would happen if we
+    // directly modified the display element by element.  A frame dropped while the previous one is
+    // still in flight is rendered again on the next update, the signature alone would skip it.
+    if (!_flush_task->Submit()) {
+      _force_render = true;
+    }
   }
 
 
@@ -327,47 +424,144 @@ public:
   }
 
 
+  //
+  // Turn the OLED panel on or off.  Off is the SSD1351 sleep mode, the display RAM is kept.
+  //
+  void Set_Display_Enable(bool enable) {
+    if (enable != _display_enable) {
+      bool locked = _flush_task->Lock(DISPLAY_LOCK_TIMEOUT_MS);
+      _display->enableDisplay(enable);
+      if (locked) {
+        _flush_task->Unlock();
+      }
+      _display_enable = enable;
+      _force_render = true;
+    }
+  }
+
+
+  bool Is_Display_Enabled() {
+    return _display_enable;
+  }
+
+
+  KeyPad *Get_Key_Pad() {
+    return _keypad;
+  }
+
+
+  TrendPlot *Get_Trend_Plot() {
+    return _trend_plot;
+  }
+
+
+  ClockFace *Get_Clock_Face() {
+    return _clock_face;
+  }
+
+
+  DisplayFlushTask *Get_Display_Flush_Task() {
+    return _flush_task;
+  }
+
+
+  //
+  // Redraw on every update (true) or only when the screen inputs change (false).
+  //
+  void Set_Render_Always(bool always) {
+    _render_always = always;
+    _force_render = true;
+  }
+
+
+  //
+  // Copy the text and sprites from the glyph atlas (true) or draw them with Adafruit GFX (false).
+  //
+  void Set_Glyph_Atlas_Enable(bool enable) {
+    _flush_task->Set_Glyph_Atlas_Enable(enable);
+    _force_render = true;
+  }
+
+
+  void Reset_Render_Stats() {
+    _render_usec_stats[0].Reset();
+    _render_usec_stats[1].Reset();
+  }
+
+
+  void Print_Render_Stats() {
+    Serial.print("   Render: ");
+    Serial.print(_render_always ? "ALWAYS" : "CHANGES");
+    Serial.print("  Frames rendered: ");
+    Serial.print(_frames_rendered);
+    Serial.print("  skipped: ");
+    Serial.println(_frames_skipped);
+    Serial.print("   Last minute rendered: ");
+    Serial.print(_last_minute_rendered);
+    Serial.print("  skipped: ");
+    Serial.println(_last_minute_skipped);
+    Serial.print("   Level motion frames: ");
+    Serial.println(_level_motion_frames);
+    Serial.print("   Clock face draw usec last minute: ");
+    Serial.print(_last_minute_face_usec);
+    Serial.print("  Dimmed: ");
+    Serial.println(_display_dim ? "YES" : "NO");
+    Serial.print("   Draw usec, atlas: ");
+    _render_usec_stats[1].Print("");
+    Serial.println();
+    Serial.print("              GFX:   ");
+    _render_usec_stats[0].Print("");
+    Serial.println();
+  }
+
+
+  // Time since a key was last held down
+  uint32_t Get_Key_Idle_MSEC() {
+    return _time_since_key_msec;
+  }
+
+
   void Set_Operating_Mode(OPERATING_MODE_T operating_mode) {
     switch (operating_mode) {
       case OPERATING_MODE_CLOCK:
         // Enable tank and column regulators
         set_tank_regulator_enable(true);
-        set_hour_column_regulator_enable(true);
-        set_min_10s_column_regulator_enable(true);
-        set_min_1s_column_regulator_enable(true);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_regulator_enable(i, true);
+        }
 
         // Disable column overrides
-        set_hour_column_override_setpoint_enable(false);
-        set_min_10s_column_override_setpoint_enable(false);
-        set_min_1s_column_override_setpoint_enable(false);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_override_setpoint_enable(i, false);
+        }
         _operating_mode = operating_mode;
         break;
 
       case OPERATING_MODE_STATIC_OVERRIDE:
         // Enable tank and column regulators
         set_tank_regulator_enable(true);
-        set_hour_column_regulator_enable(true);
-        set_min_10s_column_regulator_enable(true);
-        set_min_1s_column_regulator_enable(true);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_regulator_enable(i, true);
+        }
 
         // Enable column overrides
-        set_hour_column_override_setpoint_enable(true);
-        set_min_10s_column_override_setpoint_enable(true);
-        set_min_1s_column_override_setpoint_enable(true);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_override_setpoint_enable(i, true);
+        }
         _operating_mode = operating_mode;
         break;
 
       case OPERATING_MODE_VALVE_OVERRIDE:
         // Disable tank and column regulators
         set_tank_regulator_enable(false);
-        set_hour_column_regulator_enable(false);
-        set_min_10s_column_regulator_enable(false);
-        set_min_1s_column_regulator_enable(false);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_regulator_enable(i, false);
+        }
 
         // Disable column overrides
-        set_hour_column_override_setpoint_enable(false);
-        set_min_10s_column_override_setpoint_enable(false);
-        set_min_1s_column_override_setpoint_enable(false);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          set_column_override_setpoint_enable(i, false);
+        }
         _operating_mode = operating_mode;
         break;
 
@@ -385,91 +579,162 @@ public:
   }
 
 
-  bool Get_Hour_Column_Regulator_Enable() {
-    return _column_manager_hour->Is_Column_Regulator_Enabled();
+  bool Get_Column_Regulator_Enable(uint8_t index) {
+    return _column_managers[index]->Is_Column_Regulator_Enabled();
   }
 
 
-  bool Get_Hour_Column_Override_Setpoint_Enable() {
-    return _hour_override_setpoint_enable;
+  bool Get_Column_Override_Setpoint_Enable(uint8_t index) {
+    return _override_setpoint_enable[index];
   }
 
 
-  uint16_t Get_Hour_Column_Override_Setpoint() {
-    return _hour_override_setpoint;
+  uint16_t Get_Column_Override_Setpoint(uint8_t index) {
+    return _override_setpoint[index];
   }
 
 
-  void Set_Hour_Column_Override_Setpoint(uint16_t setpoint) {
-    _hour_override_setpoint = setpoint;
+  void Set_Column_Override_Setpoint(uint8_t index, uint16_t setpoint) {
+    _override_setpoint[index] = setpoint;
   }
 
+protected:
 
-  bool Get_Min_10s_Column_Regulator_Enable() {
-    return _column_manager_min_10s->Is_Column_Regulator_Enabled();
-  }
+  //
+  // Restore all backed up ESP32 non-volatile parameters
+  //
+  void restore_preferences() {
 
+    // Attempt to read in all backup settings, apply defaults if they don't exist
+    backup_settings.wake_hour = preferences.getUChar("wake_hour", backup_settings_defaults.wake_hour);
+    backup_settings.wake_min = preferences.getUChar("wake_min", backup_settings_defaults.wake_min);
+    backup_settings.sleep_hour = preferences.getUChar("sleep_hour", backup_settings_defaults.sleep_hour);
+    backup_settings.sleep_min = preferences.getUChar("sleep_min", backup_settings_defaults.sleep_min);
 
-  bool Get_Min_10s_Column_Override_Setpoint_Enable() {
-    return _min_10s_override_setpoint_enable;
+    // Transfer the newly restored clock setting to the clock manager
+    apply_clock_sleep_settings();
   }
 
 
-  uint16_t Get_Min_10s_Column_Override_Setpoint() {
-    return _min_10s_override_setpoint;
+  //
+  // Save all backed up ESP32 non-volatile parameters
+  //
+  void save_preferences() {
+    preferences.putUChar("wake_hour", backup_settings.wake_hour);
+    preferences.putUChar("wake_min", backup_settings.wake_min);
+    preferences.putUChar("sleep_hour", backup_settings.sleep_hour);
+    preferences.putUChar("sleep_min", backup_settings.sleep_min);
   }
 
 
-  void Set_Min_10s_Column_Override_Setpoint(uint16_t setpoint) {
-    _min_10s_override_setpoint = setpoint;
+  //
+  // FNV-1a fold of one screen input into a signature.
+  //
+  void add_signature(uint32_t &signature, uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) {
+      signature = (signature ^ ((value >> (i * 8)) & 0xFF)) * 16777619UL;
+    }
   }
 
 
-  bool Get_Min_1s_Column_Regulator_Enable() {
-    return _column_manager_min_1s->Is_Column_Regulator_Enabled();
-  }
+  //
+  // Signature of everything the current screen shows, along with the screen and the keys.
+  //
+  uint32_t screen_signature() {
+    uint32_t signature = 2166136261UL;
+    add_signature(signature, _menu_state);
+    add_signature(signature, (LEFT_BUTTON_ACTIVE << 0) | (RIGHT_BUTTON_ACTIVE << 1) | (UP_BUTTON_ACTIVE << 2)
+                               | (DOWN_BUTTON_ACTIVE << 3) | (ENTER_BUTTON_ACTIVE << 4));
 
+    switch (_menu_state) {
+      case MENU_STATE_1_IDLE:
+        // No seconds, the face changes once a minute
+        add_signature(signature, ((uint32_t)_clock_man->Get_Year() << 16) | (_clock_man->Get_Month() << 8) | _clock_man->Get_Day());
+        add_signature(signature, (_clock_man->Get_Hour() << 8) | _clock_man->Get_Minute());
+        add_signature(signature, (_operating_mode << 1) | _clock_man->Is_Sleep_Time());
+        add_signature(signature, (backup_settings.wake_hour << 24) | (backup_settings.wake_min << 16)
+                                   | (backup_settings.sleep_hour << 8) | backup_settings.sleep_min);
+        add_signature(signature, system_faults);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          add_signature(signature, _column_managers[i]->Get_State());
+        }
+        break;
 
-  bool Get_Min_1s_Column_Override_Setpoint_Enable() {
-    return _min_1s_override_setpoint_enable;
-  }
+      case MENU_STATE_2_SELECT_MENU:
+        add_signature(signature, _edit_field_index);
+        break;
 
+      case MENU_STATE_3_DO_CLOCK_DIAGS:
+        add_signature(signature, _edit_field_index);
+        add_signature(signature, _trend_plot->Get_Sample_Count(_edit_field_index));
+        break;
 
-  uint16_t Get_Min_1s_Column_Override_Setpoint() {
-    return _min_1s_override_setpoint;
-  }
+      case MENU_STATE_4_DO_SET_TIME:
+        add_signature(signature, (_edit_field_index << 16) | (_edit_rtc_hours << 8) | _edit_rtc_minutes);
+        break;
 
+      case MENU_STATE_5_DO_SET_DATE:
+        add_signature(signature, _edit_field_index);
+        add_signature(signature, ((uint32_t)_edit_rtc_year << 16) | (_edit_rtc_month << 8) | _edit_rtc_date);
+        break;
 
-  void Set_Min_1s_Column_Override_Setpoint(uint16_t setpoint) {
-    _min_1s_override_setpoint = setpoint;
-  }
+      case MENU_STATE_6_DO_SET_SLEEP:
+        add_signature(signature, _edit_field_index);
+        add_signature(signature, (_edit_wake_hour << 24) | (_edit_wake_min << 16) | (_edit_sleep_hour << 8) | _edit_sleep_min);
+        break;
 
-protected:
+      case MENU_STATE_7_DO_MAN_VALVES:
+      case MENU_STATE_9_DO_MAN_SETPOINTS:
+        // The operating mode is reasserted by the screen
+        add_signature(signature, (_edit_field_index << 8) | _operating_mode);
+        for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+          add_signature(signature, ((uint32_t)_override_setpoint[i] << 16) | _column_managers[i]->Get_Elevation_Reading_MM());
+        }
+        break;
 
-  //
-  // Restore all backed up ESP32 non-volatile parameters
-  //
-  void restore_preferences() {
+      case MENU_STATE_8_DO_MAN_PUMP:
+        add_signature(signature, (_tank->Is_Feed_Tank_Above_Low_Mark() << 2) | (_tank->Is_Feed_Tank_Above_High_Mark() << 1)
+                                   | _tank->Is_Pump_Active());
+        add_signature(signature, (uint32_t)(_tank->Get_Virtual_Level_Pct() * 10.0f));
+        break;
 
-    // Attempt to read in all backup settings, apply defaults if they don't exist
-    backup_settings.wake_hour = preferences.getUChar("wake_hour", backup_settings_defaults.wake_hour);
-    backup_settings.wake_min = preferences.getUChar("wake_min", backup_settings_defaults.wake_min);
-    backup_settings.sleep_hour = preferences.getUChar("sleep_hour", backup_settings_defaults.sleep_hour);
-    backup_settings.sleep_min = preferences.getUChar("sleep_min", backup_settings_defaults.sleep_min);
+      default:
+        // Static screens
+        break;
+    }
+    return signature;
+  }
 
-    // Transfer the newly restored clock setting to the clock manager
-    apply_clock_sleep_settings();
+
+  void count_render_minute() {
+    if (_render_minute_elapsed >= 60000) {
+      _render_minute_elapsed = 0;
+      _last_minute_rendered = _minute_rendered;
+      _last_minute_skipped = _minute_skipped;
+      _last_minute_face_usec = _minute_face_usec;
+      _minute_rendered = 0;
+      _minute_skipped = 0;
+      _minute_face_usec = 0;
+    }
   }
 
 
   //
-  // Save all backed up ESP32 non-volatile parameters
+  // Lower the master contrast of the panel (true) or restore it (false).  Sent between frame transfers.
   //
-  void save_preferences() {
-    preferences.putUChar("wake_hour", backup_settings.wake_hour);
-    preferences.putUChar("wake_min", backup_settings.wake_min);
-    preferences.putUChar("sleep_hour", backup_settings.sleep_hour);
-    preferences.putUChar("sleep_min", backup_settings.sleep_min);
+  void set_display_dim(bool dim) {
+    if (dim != _display_dim) {
+      uint8_t contrast = CONTRAST_FULL;
+      if (dim) {
+        contrast = CONTRAST_DIM;
+      }
+      bool locked = _flush_task->Lock(DISPLAY_LOCK_TIMEOUT_MS);
+      _display->sendCommand(SSD1351_CMD_CONTRASTMASTER, &contrast, 1);
+      if (locked) {
+        _flush_task->Unlock();
+      }
+      _display_dim = dim;
+    }
   }
 
 
@@ -482,80 +747,81 @@ protected:
 
   MENU_STATE_T do_menu_1_idle_state() {
 
-    _canvas->setTextSize(2);
-    print_menu_header("AQUA CLOCK");
-    _canvas->setTextSize(1);
-
-    // Print date and time
+    // Date and any system faults along the top
     print_zero_padded_four_digit_uint(_clock_man->Get_Year(), false);
     _canvas->print(F("-"));
     print_zero_padded_two_digit_uint(_clock_man->Get_Month(), false);
     _canvas->print(F("-"));
     print_zero_padded_two_digit_uint(_clock_man->Get_Day(), false);
-    _canvas->print("  ");
-    print_zero_padded_two_digit_uint(_clock_man->Get_Hour(), false);
-    _canvas->print(F(":"));
-    print_zero_padded_two_digit_uint(_clock_man->Get_Minute(), false);
-    _canvas->print(F(":"));
-    print_zero_padded_two_digit_uint(_clock_man->Get_Second(), false);
-    _canvas->println();
-    _canvas->print(F("Mode: "));
+    if (system_faults != 0x0000) {
+      _canvas->setCursor(68, 0);
+      _canvas->setTextColor(RED, BLACK);
+      _canvas->print(F("F:"));
+      _canvas->print(system_faults, HEX);
+      _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);  // Default is white text over black background
+    }
+
+    // Large numerals, only the changed ones are drawn
+    _clock_face->Draw_Time(_canvas, (SCREEN_WIDTH - ClockFace::TIME_WIDTH) / 2, 16, _clock_man->Get_Hour(), _clock_man->Get_Minute());
+
+    // State and name of every column, centered in equal cells
+    int16_t cell_width = SCREEN_WIDTH / NUM_COLUMNS;
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      int16_t cell_x = i * cell_width;
+      _clock_face->Draw_Column_State(_canvas, cell_x + (cell_width - ClockFace::ICON_SIZE) / 2, 64, _column_managers[i]->Get_State());
+      _canvas->setCursor(cell_x + (cell_width - (int16_t)strlen(COLUMN_TABLE[i].name) * 6) / 2, 84);
+      _canvas->print(COLUMN_TABLE[i].name);
+    }
+
+    // Operating mode and the next sleep or wake time
+    _canvas->setCursor(0, 104);
     switch (_operating_mode) {
       case OPERATING_MODE_CLOCK:
-        _canvas->println("CLOCK");
+        _canvas->print("CLOCK");
         break;
 
       case OPERATING_MODE_STATIC_OVERRIDE:
-        _canvas->println("STATIC OVERRIDE");
+        _canvas->setTextColor(TEXT_COLOR_HIGHLIGHT, BLACK);
+        _canvas->print("STATIC");
         break;
 
       case OPERATING_MODE_VALVE_OVERRIDE:
-        _canvas->println("VALVE OVERRIDE");
+        _canvas->setTextColor(TEXT_COLOR_HIGHLIGHT, BLACK);
+        _canvas->print("VALVES");
         break;
 
       default:
-        _canvas->println("???");
+        _canvas->print("???");
         break;
     }
-
-    // Report sleep status
+    _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);
     if (_clock_man->Is_Sleep_Time()) {
-      _canvas->printf("Sleeping till ");
+      _canvas->setCursor(SCREEN_WIDTH - 10 * 6, 104);
+      _canvas->print(F("Wake "));
       print_zero_padded_two_digit_uint(backup_settings.wake_hour, false);
-      _canvas->printf(":");
+      _canvas->print(F(":"));
       print_zero_padded_two_digit_uint(backup_settings.wake_min, false);
     } else {
-      _canvas->printf("Awake till ");
+      _canvas->setCursor(SCREEN_WIDTH - 11 * 6, 104);
+      _canvas->print(F("Sleep "));
       print_zero_padded_two_digit_uint(backup_settings.sleep_hour, false);
-      _canvas->printf(":");
+      _canvas->print(F(":"));
       print_zero_padded_two_digit_uint(backup_settings.sleep_min, false);
     }
-    _canvas->println();
 
-    // Display any system faults
+    // Name the active faults at the bottom, otherwise draw the instructions
     if (system_faults != 0x0000) {
-      _canvas->println();
-      _canvas->setTextColor(RED, BLACK);  // Default is white text over black background
-      _canvas->printf("Faults: = %08lx\r\n", system_faults);
-      display_faults();
-      _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);  // Default is white text over black background
+      _canvas->setCursor(0, 112);
+      _canvas->setTextColor(RED, BLACK);
+      display_faults(2);
+      _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);
     } else {
-      _canvas->printf("Faults: None\r\n");
+      _canvas->setCursor(0, 120);
+      _canvas->print(F("Hit "));
+      _canvas->write(0x1F);  // Down arrow
+      _canvas->println(F(" for menu."));
     }
 
-    // Draw the seconds on a progress bar to countdown changes in the clock
-    float percentage = (((float)_clock_man->Get_Second() * 1.0) / 60.0f); /* % = [0.0 - 1.0] */
-    draw_progress_bar(32, 90, 62, 20, percentage, WHITE, GREEN);
-
-    // Draw instructions at the bottom
-    _canvas->setCursor(0, 120);
-    _canvas->print(F("Hit "));
-    _canvas->write(0x1F);  // Down arrow
-    _canvas->println(F(" for menu."));
-
-    // Draw a line under menu heading
-    //_canvas->drawLine(0, 10, _canvas->width() - 1, 10, WHITE);
-
     // Up or Down = Enter the selection menu state
     if ((DOWN_BUTTON_PRESSED) || (UP_BUTTON_PRESSED)) {
       _edit_field_index = 0; /* Begin with selection on the first choice */
@@ -643,9 +909,45 @@ protected:
   MENU_STATE_T do_menu_3_clock_diags_state() {
     print_menu_header("-----Diagnostics-----");
 
-    _canvas->println();
-    _canvas->println("DIAG TBD");
+    // Newest setpoint and linearized elevation of the selected column
+    TrendPlot::TREND_SAMPLE_T sample = _trend_plot->Get_Newest_Sample(_edit_field_index);
+    _canvas->printf("%-7s SP%3u LV%3u", COLUMN_TABLE[_edit_field_index].name, sample.setpoint_mm, sample.linear_mm);
+
+    // Recent trend of the selected column
+    _trend_plot->Draw(_canvas, 0, 26, _edit_field_index);
+
+    // Trace legend
+    _canvas->setCursor(0, 112);
+    _canvas->setTextColor(TrendPlot::COLOR_RAW, BLACK);
+    _canvas->print(F("RAW "));
+    _canvas->setTextColor(TrendPlot::COLOR_LINEAR, BLACK);
+    _canvas->print(F("LIN "));
+    _canvas->setTextColor(TrendPlot::COLOR_SETPOINT, BLACK);
+    _canvas->print(F("SP "));
+    _canvas->setTextColor(TrendPlot::COLOR_FILL, BLACK);
+    _canvas->print(F("FILL "));
+    _canvas->setTextColor(TrendPlot::COLOR_DRAIN, BLACK);
+    _canvas->print(F("DRN"));
+    _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);
 
+    // Draw instructions at the bottom
+    _canvas->setCursor(0, 120);
+    _canvas->write(0x1E);  // Up arrow
+    _canvas->write(0x1F);  // Down arrow
+    _canvas->print(F(" column  < back"));
+
+    // Down = Next column
+    if (DOWN_BUTTON_PRESSED) {
+      if (_edit_field_index < (NUM_COLUMNS - 1)) {
+        _edit_field_index++;
+      }
+    }
+    // Up = Prior column
+    if (UP_BUTTON_PRESSED) {
+      if (_edit_field_index > 0) {
+        _edit_field_index--;
+      }
+    }
     // Left = return to prior menu state
     if (LEFT_BUTTON_PRESSED) {
       return MENU_STATE_2_SELECT_MENU;
@@ -676,15 +978,11 @@ protected:
       switch (_edit_field_index) {
         case 0:
           // Editing Hour, decrement down to 0.
-          if (_edit_rtc_hours > 0) {
-            _edit_rtc_hours--;
-          }
+          _edit_rtc_hours = step_down(_edit_rtc_hours, DOWN_BUTTON_STEPS, 0);
           break;
         case 1:
           // Editing minutes, decrementing down to 0.
-          if (_edit_rtc_minutes > 0) {
-            _edit_rtc_minutes--;
-          }
+          _edit_rtc_minutes = step_down(_edit_rtc_minutes, DOWN_BUTTON_STEPS, 0);
           break;
       }
     }
@@ -693,15 +991,11 @@ protected:
       switch (_edit_field_index) {
         case 0:
           // Editing Hour, increment to to 23.
-          if (_edit_rtc_hours < 23) {
-            _edit_rtc_hours++;
-          }
+          _edit_rtc_hours = step_up(_edit_rtc_hours, UP_BUTTON_STEPS, 23);
           break;
         case 1:
           // Editing minutes, increment up to 59.
-          if (_edit_rtc_minutes < 59) {
-            _edit_rtc_minutes++;
-          }
+          _edit_rtc_minutes = step_up(_edit_rtc_minutes, UP_BUTTON_STEPS, 59);
           break;
       }
     }
@@ -721,8 +1015,9 @@ protected:
     }
     // Enter = set the time
     if (ENTER_BUTTON_PRESSED) {
-      // Set the time using the clock manager
-      _clock_man->Set_Time(_edit_rtc_seconds, _edit_rtc_minutes, _edit_rtc_hours, _edit_rtc_weekday, _edit_rtc_date, _edit_rtc_month, _edit_rtc_year);
+      // Set the time using the clock manager.  Enter is pressed as the reference clock turns to the
+      // edited minute so the seconds start at zero, the correction feeds the drift tracker.
+      _clock_man->Set_Time(0, _edit_rtc_minutes, _edit_rtc_hours, _edit_rtc_weekday, _edit_rtc_date, _edit_rtc_month, _edit_rtc_year);
       return MENU_STATE_2_SELECT_MENU;
     }
 
@@ -750,19 +1045,13 @@ protected:
     if (DOWN_BUTTON_PRESSED) {
       switch (_edit_field_index) {
         case 0:  // Editing Year, decrement down to 2023.
-          if (_edit_rtc_year > 2023) {
-            _edit_rtc_year--;
-          }
+          _edit_rtc_year = step_down(_edit_rtc_year, DOWN_BUTTON_STEPS, 2023);
           break;
         case 1:  // Editing month, decrementing down to 0.
-          if (_edit_rtc_month > 0) {
-            _edit_rtc_month--;
-          }
+          _edit_rtc_month = step_down(_edit_rtc_month, DOWN_BUTTON_STEPS, 0);
           break;
         case 2:  // Editing day, decrementing down to 1.
-          if (_edit_rtc_date > 1) {
-            _edit_rtc_date--;
-          }
+          _edit_rtc_date = step_down(_edit_rtc_date, DOWN_BUTTON_STEPS, 1);
           break;
       }
     }
@@ -770,19 +1059,13 @@ protected:
     if (UP_BUTTON_PRESSED) {
       switch (_edit_field_index) {
         case 0:  // Editing year, increment to to 2050.
-          if (_edit_rtc_year < 2050) {
-            _edit_rtc_year++;
-          }
+          _edit_rtc_year = step_up(_edit_rtc_year, UP_BUTTON_STEPS, 2050);
           break;
         case 1:  // Editing month, increment up to 11.
-          if (_edit_rtc_month < 12) {
-            _edit_rtc_month++;
-          }
+          _edit_rtc_month = step_up(_edit_rtc_month, UP_BUTTON_STEPS, 12);
           break;
         case 2:  // Editing day, increment up to 31
-          if (_edit_rtc_date < 31) {
-            _edit_rtc_date++;
-          }
+          _edit_rtc_date = step_up(_edit_rtc_date, UP_BUTTON_STEPS, 31);
           break;
       }
     }
@@ -802,10 +1085,11 @@ protected:
         _edit_field_index = 0;
       }
     }
-    // Enter = set the time
+    // Enter = set the date
     if (ENTER_BUTTON_PRESSED) {
-      // Set the time using the clock manager
-      _clock_man->Set_Time(_edit_rtc_seconds, _edit_rtc_minutes, _edit_rtc_hours, _edit_rtc_weekday, _edit_rtc_date, _edit_rtc_month, _edit_rtc_year);
+      // Set the date using the clock manager, keeping the running time of day.
+      // Not a time correction so it is not measured for drift.
+      _clock_man->Set_Time(_clock_man->Get_Second(), _clock_man->Get_Minute(), _clock_man->Get_Hour(), _edit_rtc_weekday, _edit_rtc_date, _edit_rtc_month, _edit_rtc_year, false);
       return MENU_STATE_2_SELECT_MENU;
     }
 
@@ -838,27 +1122,19 @@ protected:
       switch (_edit_field_index) {
         case 0:
           // Editing Wake Hour, decrement down to 0.
-          if (_edit_wake_hour > 0) {
-            _edit_wake_hour--;
-          }
+          _edit_wake_hour = step_down(_edit_wake_hour, DOWN_BUTTON_STEPS, 0);
           break;
         case 1:
           // Editing Wake Min, decrementing down to 0.
-          if (_edit_wake_min > 0) {
-            _edit_wake_min--;
-          }
+          _edit_wake_min = step_down(_edit_wake_min, DOWN_BUTTON_STEPS, 0);
           break;
         case 2:
           // Editing Sleep Hour, decrement down to 0.
-          if (_edit_sleep_hour > 0) {
-            _edit_sleep_hour--;
-          }
+          _edit_sleep_hour = step_down(_edit_sleep_hour, DOWN_BUTTON_STEPS, 0);
           break;
         case 3:
           // Editing Sleep Min, decrementing down to 0.
-          if (_edit_sleep_min > 0) {
-            _edit_sleep_min--;
-          }
+          _edit_sleep_min = step_down(_edit_sleep_min, DOWN_BUTTON_STEPS, 0);
           break;
       }
     }
@@ -867,27 +1143,19 @@ protected:
       switch (_edit_field_index) {
         case 0:
           // Editing Wake Hour, increment to to 23.
-          if (_edit_wake_hour < 23) {
-            _edit_wake_hour++;
-          }
+          _edit_wake_hour = step_up(_edit_wake_hour, UP_BUTTON_STEPS, 23);
           break;
         case 1:
           // Editing Wake Min, increment up to 59.
-          if (_edit_wake_min < 59) {
-            _edit_wake_min++;
-          }
+          _edit_wake_min = step_up(_edit_wake_min, UP_BUTTON_STEPS, 59);
           break;
         case 2:
           // Editing Sleep Hour, increment to to 23.
-          if (_edit_sleep_hour < 23) {
-            _edit_sleep_hour++;
-          }
+          _edit_sleep_hour = step_up(_edit_sleep_hour, UP_BUTTON_STEPS, 23);
           break;
         case 3:
           // Editing Sleep Min, increment up to 59.
-          if (_edit_sleep_min < 59) {
-            _edit_sleep_min++;
-          }
+          _edit_sleep_min = step_up(_edit_sleep_min, UP_BUTTON_STEPS, 59);
           break;
       }
     }
@@ -933,77 +1201,17 @@ protected:
     Set_Operating_Mode(UIManager::OPERATING_MODE_VALVE_OVERRIDE);
 
     // Present the valve edit screen
-    // There are three fields to edit, HOUR Column(index 0), MIN 10s column(index 1), MIN 1s column(index 2)
+    // There is one field to edit per column in COLUMN_TABLE, left to right
     print_menu_header("----MANUAL VALVES----");
 
-    // Black out the area above the columns for up arrows
-    _canvas->fillRect(18, 10,  // x, y
-                      90,      // Width
-                      8,       // height
-                      BLACK);
-
-    // Black out the area above the columns for up arrows
-    _canvas->fillRect(18, 86,  // x, y
-                      90,      // Width
-                      8,       // height
-                      BLACK);
-
-    // Draw the up and down arrows above and below the column selected
-    switch (_edit_field_index) {
-      case 0:
-        // Adjusting the HOUR column
-        _canvas->setCursor(18 + 5, 10);  // Draw above the hour column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(18 + 5, 88);  // Draw below the hour column
-        _canvas->write(0x1F);            // Down arrow
-        break;
-
-      case 1:
-        // Adjusting the MIN 10s column
-        _canvas->setCursor(54 + 5, 10);  // Draw above the min 10s column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(54 + 5, 88);  // Draw below the min 10s column
-        _canvas->write(0x1F);            // Down arrow
-        break;
-
-      case 2:
-        // Adjusting the MIN 1s column
-        _canvas->setCursor(90 + 5, 10);  // Draw above the min 1s column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(90 + 5, 88);  // Draw below the min 1s column
-        _canvas->write(0x1F);            // Down arrow
-        break;
-    }
-
-    // Render the columns graphically
-    draw_column_symbol(18,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_hour->Get_Elevation_Reading_MM(),
-                       _column_manager_hour->Get_Setpoint_Upper_Limit());
-
-    draw_column_symbol(54,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_min_10s->Get_Elevation_Reading_MM(),
-                       _column_manager_min_10s->Get_Setpoint_Upper_Limit());
-
-    draw_column_symbol(90,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_min_1s->Get_Elevation_Reading_MM(),
-                       _column_manager_min_1s->Get_Setpoint_Upper_Limit());
+    // Draw the columns with arrows above and below the selected one
+    draw_column_edit_row();
 
     // Draw the elevation readings right under the column
-    _canvas->setCursor(18, 100);
-    _canvas->printf("%3d", _column_manager_hour->Get_Elevation_Reading_MM());
-    _canvas->setCursor(54, 100);
-    _canvas->printf("%3d", _column_manager_min_10s->Get_Elevation_Reading_MM());
-    _canvas->setCursor(90, 100);
-    _canvas->printf("%3d", _column_manager_min_1s->Get_Elevation_Reading_MM());
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _canvas->setCursor(column_graphic_x(i), 100);
+      _canvas->printf("%3d", _column_managers[i]->Get_Elevation_Reading_MM());
+    }
 
     // Draw instructions at the bottom
     _canvas->setCursor(0, 120);
@@ -1027,7 +1235,7 @@ protected:
     }
     // Right = Alternate between fields
     if (RIGHT_BUTTON_PRESSED) {
-      if (_edit_field_index < 2) {
+      if (_edit_field_index < (NUM_COLUMNS - 1)) {
         _edit_field_index++;
       }
     }
@@ -1035,32 +1243,12 @@ protected:
     // Down = Activate the FILL valve for the hour column
     if (DOWN_BUTTON_ACTIVE) {
       // Request a manual drain for 150msec
-      switch (_edit_field_index) {
-        case 0:
-          _column_manager_hour->Manual_Drain(150);
-          break;
-        case 1:
-          _column_manager_min_10s->Manual_Drain(150);
-          break;
-        case 2:
-          _column_manager_min_1s->Manual_Drain(150);
-          break;
-      }
+      _column_managers[_edit_field_index]->Manual_Drain(150);
     }
     // Up = Activate the DRAIN valve for the hour column
     if (UP_BUTTON_ACTIVE) {
       // Request a manual fill for 150msec
-      switch (_edit_field_index) {
-        case 0:
-          _column_manager_hour->Manual_Fill(150);
-          break;
-        case 1:
-          _column_manager_min_10s->Manual_Fill(150);
-          break;
-        case 2:
-          _column_manager_min_1s->Manual_Fill(150);
-          break;
-      }
+      _column_managers[_edit_field_index]->Manual_Fill(150);
     }
 
     // Default is to stay in the current state
@@ -1081,6 +1269,7 @@ protected:
     // Draw the tank schematic
     draw_tank_schematic(30, 30,  // Tank upper left coordinate
                         60, 30,  // Tank width and height
+                        _tank->Get_Virtual_Level_Pct() / 100.0f,
                         lower_level_sensor_wet,
                         upper_level_sensor_wet,
                         pump_running);
@@ -1113,86 +1302,20 @@ protected:
     Set_Operating_Mode(UIManager::OPERATING_MODE_STATIC_OVERRIDE);
 
     // Present the column setpoint edit screen
-    // There are three fields to edit, HOUR Column(index 0), MIN 10s column(index 1), MIN 1s column(index 2)
+    // There is one field to edit per column in COLUMN_TABLE, left to right
     print_menu_header("--MANUAL SETPOINTS--");
 
-    // Black out the area above the columns for up arrows
-    _canvas->fillRect(18, 10,  // x, y
-                      90,      // Width
-                      8,       // height
-                      BLACK);
-
-    // Black out the area above the columns for up arrows
-    _canvas->fillRect(18, 86,  // x, y
-                      90,      // Width
-                      8,       // height
-                      BLACK);
-
-    // Draw the up and down arrows above and below the column selected
-    switch (_edit_field_index) {
-      case 0:
-        // Adjusting the HOUR column
-        _canvas->setCursor(18 + 5, 10);  // Draw above the hour column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(18 + 5, 88);  // Draw below the hour column
-        _canvas->write(0x1F);            // Down arrow
-        break;
-
-      case 1:
-        // Adjusting the MIN 10s column
-        _canvas->setCursor(54 + 5, 10);  // Draw above the min 10s column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(54 + 5, 88);  // Draw below the min 10s column
-        _canvas->write(0x1F);            // Down arrow
-        break;
+    // Draw the columns with arrows above and below the selected one
+    draw_column_edit_row();
 
-      case 2:
-        // Adjusting the MIN 1s column
-        _canvas->setCursor(90 + 5, 10);  // Draw above the min 1s column
-        _canvas->write(0x1E);            // Up arrow
-        _canvas->setCursor(90 + 5, 88);  // Draw below the min 1s column
-        _canvas->write(0x1F);            // Down arrow
-        break;
+    // Draw the elevation setpoint and the current elevation reading under the column
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      _canvas->setCursor(column_graphic_x(i), 100);
+      _canvas->printf("%3d", Get_Column_Override_Setpoint(i));
+      _canvas->setCursor(column_graphic_x(i), 110);
+      _canvas->printf("%3d", _column_managers[i]->Get_Elevation_Reading_MM());
     }
 
-    // Render the columns graphically
-    draw_column_symbol(18,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_hour->Get_Elevation_Reading_MM(),
-                       _column_manager_hour->Get_Setpoint_Upper_Limit());
-
-    draw_column_symbol(54,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_min_10s->Get_Elevation_Reading_MM(),
-                       _column_manager_min_10s->Get_Setpoint_Upper_Limit());
-
-    draw_column_symbol(90,                     // x0,
-                       22,                     // y0,
-                       COLUMN_GRAPHIC_WIDTH,   // width,
-                       COLUMN_GRAPHIC_HEIGHT,  // height,
-                       _column_manager_min_1s->Get_Elevation_Reading_MM(),
-                       _column_manager_min_1s->Get_Setpoint_Upper_Limit());
-
-    // Draw the elevation setpoint under the column
-    _canvas->setCursor(18, 100);
-    _canvas->printf("%3d", Get_Hour_Column_Override_Setpoint());
-    _canvas->setCursor(54, 100);
-    _canvas->printf("%3d", Get_Min_10s_Column_Override_Setpoint());
-    _canvas->setCursor(90, 100);
-    _canvas->printf("%3d", Get_Min_1s_Column_Override_Setpoint());
-
-    // Draw the current elevation readings
-    _canvas->setCursor(18, 110);
-    _canvas->printf("%3d", _column_manager_hour->Get_Elevation_Reading_MM());
-    _canvas->setCursor(54, 110);
-    _canvas->printf("%3d", _column_manager_min_10s->Get_Elevation_Reading_MM());
-    _canvas->setCursor(90, 110);
-    _canvas->printf("%3d", _column_manager_min_1s->Get_Elevation_Reading_MM());
-
     // Draw instructions at the bottom
     _canvas->setCursor(0, 120);
     _canvas->print(F("Hold "));
@@ -1215,60 +1338,26 @@ protected:
     }
     // Right = Alternate between fields
     if (RIGHT_BUTTON_PRESSED) {
-      if (_edit_field_index < 2) {
+      if (_edit_field_index < (NUM_COLUMNS - 1)) {
         _edit_field_index++;
       }
     }
 
-    // Down = Activate the FILL valve for the hour column
-    if (DOWN_BUTTON_ACTIVE) {
-      // Request a manual drain for 150msec
-      switch (_edit_field_index) {
-        case 0:
-          //adjust hour setpoint higher to limit
-          Set_Hour_Column_Override_Setpoint(increment_setpoint(Get_Hour_Column_Override_Setpoint(),
-                                                               2,
-                                                               _column_manager_hour->Get_Setpoint_Upper_Limit()));
-          break;
-        case 1:
-          //adjust min 10s setpoint higher to limit
-          Set_Min_10s_Column_Override_Setpoint(increment_setpoint(Get_Min_10s_Column_Override_Setpoint(),
-                                                                  2,
-                                                                  _column_manager_min_10s->Get_Setpoint_Upper_Limit()));
-          break;
-        case 2:
-          //adjust min 1s setpoint higher to limit
-          Set_Min_1s_Column_Override_Setpoint(increment_setpoint(Get_Min_1s_Column_Override_Setpoint(),
-                                                                 2,
-                                                                 _column_manager_min_1s->Get_Setpoint_Upper_Limit()));
-
-          break;
-      }
+    // Down = Raise the selected column setpoint elevation
+    if (DOWN_BUTTON_PRESSED) {
+      // Adjust the selected column setpoint higher to its limit
+      Set_Column_Override_Setpoint(_edit_field_index,
+                                   increment_setpoint(Get_Column_Override_Setpoint(_edit_field_index),
+                                                      SETPOINT_STEP_MM * DOWN_BUTTON_STEPS,
+                                                      _column_managers[_edit_field_index]->Get_Setpoint_Upper_Limit()));
     }
-    // Up = Activate the DRAIN valve for the hour column
-    if (UP_BUTTON_ACTIVE) {
-      // Request a manual fill for 150msec
-      switch (_edit_field_index) {
-        case 0:
-          //adjust hour setpoint lower to limit
-          Set_Hour_Column_Override_Setpoint(decrement_setpoint(Get_Hour_Column_Override_Setpoint(),
-                                                               2,
-                                                               _column_manager_hour->Get_Setpoint_Lower_Limit()));
-          break;
-
-        case 1:
-          //adjust min 10s setpoint lower to limit break;
-          Set_Min_10s_Column_Override_Setpoint(decrement_setpoint(Get_Min_10s_Column_Override_Setpoint(),
-                                                                  2,
-                                                                  _column_manager_min_10s->Get_Setpoint_Lower_Limit()));
-          break;
-        case 2:
-          //adjust min 1s setpoint lower to limit break;
-          Set_Min_1s_Column_Override_Setpoint(decrement_setpoint(Get_Min_1s_Column_Override_Setpoint(),
-                                                                 2,
-                                                                 _column_manager_min_1s->Get_Setpoint_Lower_Limit()));
-          break;
-      }
+    // Up = Lower the selected column setpoint elevation
+    if (UP_BUTTON_PRESSED) {
+      // Adjust the selected column setpoint lower to its limit
+      Set_Column_Override_Setpoint(_edit_field_index,
+                                   decrement_setpoint(Get_Column_Override_Setpoint(_edit_field_index),
+                                                      SETPOINT_STEP_MM * UP_BUTTON_STEPS,
+                                                      _column_managers[_edit_field_index]->Get_Setpoint_Lower_Limit()));
     }
 
     // Default is to stay in the current state
@@ -1289,39 +1378,65 @@ protected:
   }
 
 
-  void set_tank_regulator_enable(bool enable) {
-    _tank->Set_Regulator_Enable(enable);
+  //
+  // Left edge of a column graphic, columns are spread evenly across the screen
+  //
+  int16_t column_graphic_x(uint8_t index) {
+    return COLUMN_GRAPHIC_X0 + (index * COLUMN_GRAPHIC_SPACING);
   }
 
 
-  void set_hour_column_regulator_enable(bool enable) {
-    _column_manager_hour->Set_Regulator_Enable(enable);
-  }
+  //
+  // Draw every column graphic with up and down arrows around the column being edited
+  //
+  void draw_column_edit_row() {
+    int16_t row_width = column_graphic_x(NUM_COLUMNS - 1) + COLUMN_GRAPHIC_WIDTH - COLUMN_GRAPHIC_X0;
 
+    // Black out the area above the columns for up arrows
+    _canvas->fillRect(COLUMN_GRAPHIC_X0, 10,  // x, y
+                      row_width,              // Width
+                      8,                      // height
+                      BLACK);
 
-  void set_hour_column_override_setpoint_enable(bool enable) {
-    _hour_override_setpoint_enable = enable;
-  }
+    // Black out the area below the columns for down arrows
+    _canvas->fillRect(COLUMN_GRAPHIC_X0, 86,  // x, y
+                      row_width,              // Width
+                      8,                      // height
+                      BLACK);
 
+    // Draw the up and down arrows above and below the column selected
+    if (_edit_field_index < NUM_COLUMNS) {
+      _canvas->setCursor(column_graphic_x(_edit_field_index) + 5, 10);  // Draw above the column
+      _canvas->write(0x1E);                                             // Up arrow
+      _canvas->setCursor(column_graphic_x(_edit_field_index) + 5, 88);  // Draw below the column
+      _canvas->write(0x1F);                                             // Down arrow
+    }
 
-  void set_min_10s_column_regulator_enable(bool enable) {
-    //_min_10s_regulator_enable = enable;
-    _column_manager_min_10s->Set_Regulator_Enable(enable);
+    // Render the columns graphically
+    for (uint8_t i = 0; i < NUM_COLUMNS; i++) {
+      draw_column_symbol(i,
+                         column_graphic_x(i),    // x0,
+                         22,                     // y0,
+                         COLUMN_GRAPHIC_WIDTH,   // width,
+                         COLUMN_GRAPHIC_HEIGHT,  // height,
+                         _column_managers[i]->Get_Elevation_Reading_MM(),
+                         _column_managers[i]->Get_Setpoint_Upper_Limit());
+    }
   }
 
 
-  void set_min_10s_column_override_setpoint_enable(bool enable) {
-    _min_10s_override_setpoint_enable = enable;
+  void set_tank_regulator_enable(bool enable) {
+    _tank->Set_Regulator_Enable(enable);
   }
 
 
-  void set_min_1s_column_regulator_enable(bool enable) {
-    _column_manager_min_1s->Set_Regulator_Enable(enable);
+  void set_column_regulator_enable(uint8_t index, bool enable) {
+    _column_managers[index]->Set_Regulator_Enable(enable);
   }
 
 
-  void set_min_1s_column_override_setpoint_enable(bool enable) {
-    _min_1s_override_setpoint_enable = enable;
+  void set_column_override_setpoint_enable(uint8_t index, bool enable) {
+    _override_setpoint_enable[index] = enable;
   }
 
 
@@ -1344,54 +1459,61 @@ protected:
   }
 
 
-  bool scan_left_button_input() {
-    bool active = !_io_expander->digitalRead(SC1509_PIN_KEY_4);
-    return active;
-  }
-
-
-  bool scan_right_button_input() {
-    bool active = !_io_expander->digitalRead(SC1509_PIN_KEY_5);
-    return active;
-  }
-
+  //
+  // Take the key events queued since the last menu update.  A second press of a key already pressed
+  // in this update is left queued for the next one, so every press acts on the menu.
+  //
+  void detect_button_activity() {
+    KeyPad::KEY_EVENT_T event;
+    for (uint8_t i = 0; i < KeyPad::KEY_COUNT; i++) {
+      _key_steps[i] = 0;
+    }
+    while (_keypad->Peek_Event(&event)) {
+      if ((event.type == KeyPad::KEY_EVENT_PRESS) && (_key_steps[event.key] > 0)) {
+        break;
+      }
+      _keypad->Get_Event(&event);
+      if ((event.type == KeyPad::KEY_EVENT_PRESS) || (event.type == KeyPad::KEY_EVENT_REPEAT)) {
+        _key_steps[event.key]++;
+      }
+    }
 
-  bool scan_up_button_input() {
-    bool active = !_io_expander->digitalRead(SC1509_PIN_KEY_3);
-    return active;
+    if (is_key_activity()) {
+      _time_since_key_msec = 0;
+    }
   }
 
 
-  bool scan_down_button_input() {
-    bool active = !_io_expander->digitalRead(SC1509_PIN_KEY_2);
-    return active;
+  bool is_key_activity() {
+    for (uint8_t i = 0; i < KeyPad::KEY_COUNT; i++) {
+      if (_key_steps[i] > 0) {
+        return true;
+      }
+    }
+    return _keypad->Is_Any_Active();
   }
 
 
-  bool scan_enter_button_input() {
-    bool active = !_io_expander->digitalRead(SC1509_PIN_KEY_1);
-    return active;
+  void debounce_buttons() {
+    _keypad->Scan();
   }
 
 
-  void detect_button_activity() {
-    // Update the button inputs to look for changes since the last menu update
-    cur_button_status.left_button_active = scan_left_button_input();
-    cur_button_status.right_button_active = scan_right_button_input();
-    cur_button_status.up_button_active = scan_up_button_input();
-    cur_button_status.down_button_active = scan_down_button_input();
-    cur_button_status.enter_button_active = scan_enter_button_input();
+  // Edited value moved up by the key steps of this update, up to its limit
+  uint16_t step_up(uint16_t value, uint8_t steps, uint16_t value_max) {
+    if (value >= value_max) {
+      return value;
+    }
+    return (value_max - value > steps) ? value + steps : value_max;
   }
 
 
-  void debounce_buttons() {
-    // Schedule button input debounce
-    if (_menu_button_debounce_period_elapsed < MENU_BUTTON_DEBOUNCE_PERIOD_MS) {
-      return;
+  // Edited value moved down by the key steps of this update, down to its limit
+  uint16_t step_down(uint16_t value, uint8_t steps, uint16_t value_min) {
+    if (value <= value_min) {
+      return value;
     }
-    _menu_button_debounce_period_elapsed = 0;
-
-    //TODO: Add debounce filtering in fuure
+    return (value - value_min > steps) ? value - steps : value_min;
   }
 
 
@@ -1486,35 +1608,41 @@ protected:
 
 
   // Draw a graphical symbol for a water column with a variable level of water
-  void draw_column_symbol(uint8_t col_x0, uint8_t col_y0, uint8_t col_width, uint8_t col_height, uint16_t elevation_mm, uint16_t upper_elevation) {
+  void draw_column_symbol(uint8_t index, uint8_t col_x0, uint8_t col_y0, uint8_t col_width, uint8_t col_height, uint16_t elevation_mm, uint16_t upper_elevation) {
 
-    // Calculate how much of the column needs to be filled with fluid in percentage.
+    // Calculate how much of the column needs to be filled with fluid.
     // An elevation reading close to the upper elevation limit is an empty column.
     // A low elevation reading means the float is at the top thus a full column.
-    // This is why we subtract the elevation ration from 100 to invert.
-    float fill_percentage = 1.0 - (((float)elevation_mm * 1.0) / (float)upper_elevation); /* % = [0.0 - 1.0] */
+    // This is why we subtract the elevation from the upper elevation to invert.
+    int32_t target_q8 = LevelAnimator::Fill_To_Q8(col_height, (int32_t)upper_elevation - elevation_mm, upper_elevation);
+
+    // Ease the drawn water toward the reading
+    int16_t water_height = _column_levels[index].Step(target_q8);
+    _level_motion |= _column_levels[index].Is_Moving();
 
     // Draw the column
-    draw_water_vessel(col_x0, col_y0, col_width, col_height, fill_percentage, WHITE, CYAN);
+    draw_water_vessel(col_x0, col_y0, col_width, col_height, water_height, WHITE, CYAN);
   }
 
 
   // Draw a graphical symbol for a water tank with level sensor status, water level and pump activity
-  void draw_tank_schematic(uint8_t x0, uint8_t y0, uint8_t width, uint8_t height, bool lower_sensed, bool upper_sensed, bool pump_active) {
+  void draw_tank_schematic(uint8_t x0, uint8_t y0, uint8_t width, uint8_t height, float level_fraction, bool lower_sensed, bool upper_sensed, bool pump_active) {
     static uint8_t pump_anim_phase = 0;
 
-    // Draw the tank and contents
-    if (upper_sensed) {
-      // Full tank to %75 full
-      draw_water_vessel(x0, y0, width, height, 0.75f, WHITE, CYAN);
-    } else if (lower_sensed) {
-      // Full tank to %25 full
-      draw_water_vessel(x0, y0, width, height, 0.25f, WHITE, CYAN);
-    } else {
-      // Tank is completely empty
-      draw_water_vessel(x0, y0, width, height, 0.0f, WHITE, CYAN);
+    // Keep redrawing while the pump runs so it animates
+    if (pump_active) {
+      _animating = true;
     }
 
+    // Draw the tank and contents easing toward the estimated level
+    int16_t water_height = _tank_level.Step(LevelAnimator::Fill_To_Q8(height, (int32_t)(level_fraction * 1000.0f + 0.5f), 1000));
+    _level_motion |= _tank_level.Is_Moving();
+    draw_water_vessel(x0, y0, width, height, water_height, WHITE, CYAN);
+
+    // Estimated level below the tank
+    _canvas->setCursor(x0 + (width / 2) - 12, y0 + height + 4);
+    _canvas->printf("%3d%%", (int)(level_fraction * 100.0f + 0.5f));
+
     _canvas->setTextColor(RED, BLACK);  // Switch to red for level sensor status
 
     // Draw the upper sensor status to the left of the tank symbol
@@ -1535,6 +1663,19 @@ protected:
 
     _canvas->setTextColor(TEXT_COLOR_BASE, BLACK);  // Return to default text color
 
+    // Pipes and pump in one copy from the glyph atlas
+    if (_canvas->Is_Glyph_Atlas_Enabled()) {
+      const uint8_t *sprite = ATLAS_PUMP_IDLE;
+      if (pump_active) {
+        pump_anim_phase = !pump_anim_phase;
+        if (pump_anim_phase) {
+          sprite = ATLAS_PUMP_RUNNING;
+        }
+      }
+      _canvas->Blit_Indexes(x0 + width, y0 + height + ATLAS_PUMP_Y_OFFSET, ATLAS_PUMP_WIDTH, ATLAS_PUMP_HEIGHT, sprite);
+      return;
+    }
+
     // Draw pipes from the pump to the upper tank
     _canvas->fillRect(x0 + width, y0 + height - 5, 10, 4, CYAN);       // horizontal pipe out of upper tank
     _canvas->fillRect(x0 + width + 10, y0 + height - 5, 4, 15, CYAN);  // vertical pipe down to pump
@@ -1557,18 +1698,15 @@ protected:
   }
 
 
-  // Draw a generic water vessel with a specificed percentage of water filled
+  // Draw a generic water vessel filled to a water height in pixels
   void draw_water_vessel(uint16_t x, uint16_t y,           // Upper left coordinate of vessel
                          uint16_t width, uint16_t height,  // width and height of vessel
-                         float percent_filled,             // 0.0 to 1.0
+                         int16_t water_height,             // 0 to height
                          uint16_t frame_color,
                          uint16_t water_color) {
     // Draw the vessel outer frame
     _canvas->drawRect(x, y, width, height, frame_color);
 
-    // Scale the vessel height with the fill_percentage to compute how high to draw the water
-    float water_height = height * percent_filled;
-
     // Draw the water at the bottom of the vessel with the scaled height
     _canvas->fillRect(x + 1,                     /* 1 pixel in on left to not draw over left frame */
                       y + height - water_height, /* Shift water to bottom of column */
@@ -1599,11 +1737,13 @@ protected:
   }
 
 
-  // Display a list of active faults using the fault description strings
-  void display_faults() {
-    for (int i = 0; i < FAULT_MAX_INDEX; i++) {
+  // Display a list of active faults using the fault description strings, the first max_lines of them
+  void display_faults(uint8_t max_lines) {
+    uint8_t lines = 0;
+    for (int i = 0; (i < FAULT_MAX_INDEX) && (lines < max_lines); i++) {
       if (FAULT_ACTIVE(i)) {
         _canvas->println(FAULT_STRING[i]);
+        lines++;
       }
     }
   }
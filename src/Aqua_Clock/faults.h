@@ -34,16 +34,27 @@ typedef enum {
   FAULT_TANK_FILL_TIMEOUT = 16,            /* See TankManager.h */
   FAULT_TANK_LEVEL_SENSE_FAIL = 17,        /* See TankManager.h */
   FAULT_NVM_FAIL = 18,                     /* See UIManager.h */
-  FAULT_MAX_INDEX = 19
+  FAULT_COLUMN_1_FLOW_FAIL = 19,           /* See ColumnManager.h */
+  FAULT_COLUMN_2_FLOW_FAIL = 20,           /* See ColumnManager.h */
+  FAULT_COLUMN_3_FLOW_FAIL = 21,           /* See ColumnManager.h */
+  FAULT_COLUMN_UNKNOWN_FLOW_FAIL = 22,     /* See ColumnManager.h */
+  FAULT_I2C_MUX_PORT_3_FAIL = 23,          /* See main .ini */
+  FAULT_I2C_MUX_PORT_4_FAIL = 24,          /* See main .ini */
+  FAULT_I2C_MUX_PORT_5_FAIL = 25,          /* See main .ini */
+  FAULT_I2C_MUX_PORT_6_FAIL = 26,          /* See main .ini */
+  FAULT_I2C_MUX_PORT_7_FAIL = 27,          /* See main .ini */
+  FAULT_MAX_INDEX = 28
 } SYSTEM_FAULT_T;
 
+static_assert(FAULT_MAX_INDEX <= 32, "Every fault needs a bit of system_faults");
+
 // Forward reference to master system fault bits in master .ini file.
 extern uint32_t system_faults;
 extern const char *FAULT_STRING[];
 
 // Fault macros.  Replace x with the fault enumeration name.
 #define FAULT_SET(x) system_faults = (system_faults | ((uint32_t)1 << x))
-#define FAULT_CLEAR(x) system_faults = (system_faults &= ~((uint32_t)1 << x))
+#define FAULT_CLEAR(x) system_faults = (system_faults & ~((uint32_t)1 << x))
 #define FAULT_ACTIVE(x) ((system_faults & (uint32_t)1 << x) != 0)
 
 #endif
\ No newline at end of file
@@ -0,0 +1,566 @@
+/*
+ * Aqua Clock glyph atlas generator
+ *
+ * Writes GlyphAtlas.h, the pre-rasterized text glyphs and schematic sprites the UI copies into its
+ * palette canvas instead of drawing them pixel by pixel every frame.
+ *   Text glyphs: the printable ASCII characters of the Adafruit GFX classic font at text sizes 1 and 2,
+ *                whole 6x8 character cells with the spacing column, exactly as drawChar() draws them
+ *                with a background color.  4 bit shades, 0 = background and 15 = foreground.
+ *   Sprites:     the manual pump schematic with the pump idle and running, drawn with the Adafruit GFX
+ *                circle algorithms.  4 bit indexes into the default PaletteCanvas palette.
+ *   Numerals:    the large anti-aliased digits and colon of the idle clock face.  Each glyph is a set of
+ *                round pen strokes, every pixel shaded by how many of its 4x4 sub-samples the pen covers.
+ *   State icons: the column state symbols of the idle clock face, drawn the same way.
+ * Lines are packed two pixels per byte, high nibble first, the same layout as the PaletteCanvas buffer.
+ *
+ * Build:  g++ -std=c++11 -O2 -o make_glyph_atlas make_glyph_atlas.cpp
+ * Usage:  make_glyph_atlas <Adafruit GFX library>/glcdfont.c > ../../src/Aqua_Clock/GlyphAtlas.h
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+
+static const int FIRST_CHAR = 32;
+static const int LAST_CHAR = 126;
+static const int FONT_COLUMNS = 5;
+static const int CELL_WIDTH = 6;
+static const int CELL_HEIGHT = 8;
+
+static const uint8_t SHADE_FOREGROUND = 15;
+
+// Default PaletteCanvas palette indexes
+static const uint8_t INDEX_BLACK = 0;
+static const uint8_t INDEX_RED = 2;
+static const uint8_t INDEX_GREEN = 3;
+static const uint8_t INDEX_CYAN = 4;
+
+// Pump schematic, relative to the lower right corner of the tank less the 5 pixel pipe offset
+static const int PUMP_WIDTH = 24;
+static const int PUMP_HEIGHT = 50;
+static const int PUMP_CENTER_X = 12;
+static const int PUMP_CENTER_Y = 25;
+static const int PUMP_RADIUS = 10;
+
+// Clock face numerals, pen radius in pixels
+static const int NUMERAL_WIDTH = 24;
+static const int NUMERAL_HEIGHT = 40;
+static const int COLON_WIDTH = 12;
+static const double NUMERAL_PEN = 2.6;
+static const int SUBSAMPLES = 4;  // Per pixel side
+
+// Clock face column state icons
+static const int ICON_SIZE = 16;
+static const double ICON_PEN = 1.5;
+static const int ICON_COUNT = 5;
+
+
+//
+// 4 bit image, one byte per pixel until it is packed.
+//
+struct Image {
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;
+
+  Image(int w, int h) : width(w), height(h), pixels(w * h, 0) {}
+
+  void pixel(int x, int y, uint8_t value) {
+    if ((x >= 0) && (y >= 0) && (x < width) && (y < height)) {
+      pixels[y * width + x] = value;
+    }
+  }
+
+  void fill_rect(int x, int y, int w, int h, uint8_t value) {
+    for (int j = y; j < y + h; j++) {
+      for (int i = x; i < x + w; i++) {
+        pixel(i, j, value);
+      }
+    }
+  }
+
+  void vline(int x, int y, int h, uint8_t value) {
+    fill_rect(x, y, 1, h, value);
+  }
+
+  int bytes_per_line() const {
+    return (width + 1) / 2;
+  }
+
+  std::vector<uint8_t> pack() const {
+    std::vector<uint8_t> packed(bytes_per_line() * height, 0);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        uint8_t &pair = packed[y * bytes_per_line() + x / 2];
+        pair |= (x & 1) ? pixels[y * width + x] : (pixels[y * width + x] << 4);
+      }
+    }
+    return packed;
+  }
+};
+
+
+//
+// Adafruit_GFX::drawCircle()
+//
+static void draw_circle(Image &image, int x0, int y0, int r, uint8_t value) {
+  int f = 1 - r;
+  int ddF_x = 1;
+  int ddF_y = -2 * r;
+  int x = 0;
+  int y = r;
+
+  image.pixel(x0, y0 + r, value);
+  image.pixel(x0, y0 - r, value);
+  image.pixel(x0 + r, y0, value);
+  image.pixel(x0 - r, y0, value);
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    image.pixel(x0 + x, y0 + y, value);
+    image.pixel(x0 - x, y0 + y, value);
+    image.pixel(x0 + x, y0 - y, value);
+    image.pixel(x0 - x, y0 - y, value);
+    image.pixel(x0 + y, y0 + x, value);
+    image.pixel(x0 - y, y0 + x, value);
+    image.pixel(x0 + y, y0 - x, value);
+    image.pixel(x0 - y, y0 - x, value);
+  }
+}
+
+
+//
+// Adafruit_GFX::fillCircle(), the center line and fillCircleHelper() for both halves
+//
+static void fill_circle(Image &image, int x0, int y0, int r, uint8_t value) {
+  image.vline(x0, y0 - r, 2 * r + 1, value);
+
+  int f = 1 - r;
+  int ddF_x = 1;
+  int ddF_y = -2 * r;
+  int x = 0;
+  int y = r;
+  int px = x;
+  int py = y;
+  int delta = 1;
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    if (x < (y + 1)) {
+      image.vline(x0 + x, y0 - y, 2 * y + delta, value);
+      image.vline(x0 - x, y0 - y, 2 * y + delta, value);
+    }
+    if (y != py) {
+      image.vline(x0 + py, y0 - px, 2 * px + delta, value);
+      image.vline(x0 - py, y0 - px, 2 * px + delta, value);
+      py = y;
+    }
+    px = x;
+  }
+}
+
+
+//
+// Character cell as drawChar() draws it, each font pixel a size x size block.
+//
+static Image render_glyph(const std::vector<uint8_t> &font, int c, int size) {
+  Image image(CELL_WIDTH * size, CELL_HEIGHT * size);
+  for (int col = 0; col < FONT_COLUMNS; col++) {
+    uint8_t bits = font[c * FONT_COLUMNS + col];
+    for (int row = 0; row < CELL_HEIGHT; row++) {
+      if (bits & (1 << row)) {
+        image.fill_rect(col * size, row * size, size, size, SHADE_FOREGROUND);
+      }
+    }
+  }
+  return image;
+}
+
+
+//
+// Pipes and pump in the draw order of UIManager::draw_tank_schematic().
+//
+static Image render_pump(bool running) {
+  Image image(PUMP_WIDTH, PUMP_HEIGHT);
+  image.fill_rect(0, 0, 10, 4, INDEX_CYAN);    // Horizontal pipe out of the tank
+  image.fill_rect(10, 0, 4, 15, INDEX_CYAN);   // Vertical pipe down to the pump
+  image.fill_rect(10, 35, 4, 15, INDEX_CYAN);  // Pipe below the pump
+  if (running) {
+    fill_circle(image, PUMP_CENTER_X, PUMP_CENTER_Y, PUMP_RADIUS, INDEX_RED);
+  }
+  draw_circle(image, PUMP_CENTER_X, PUMP_CENTER_Y, PUMP_RADIUS, INDEX_GREEN);
+  return image;
+}
+
+
+//
+// Round pen strokes, a list of line segments each with the pen radius it is drawn with.
+//
+struct Strokes {
+  struct Segment {
+    double x0, y0, x1, y1, radius;
+  };
+  std::vector<Segment> segments;
+  double scale_x;
+  double scale_y;
+  double pen;
+
+  // Points are given in 0..1 of the glyph width and height
+  Strokes(int width, int height, double pen_radius) : scale_x(width), scale_y(height), pen(pen_radius) {}
+
+  void line(double x0, double y0, double x1, double y1) {
+    Segment segment = { x0 * scale_x, y0 * scale_y, x1 * scale_x, y1 * scale_y, pen };
+    segments.push_back(segment);
+  }
+
+  void dot(double x, double y, double radius) {
+    Segment segment = { x * scale_x, y * scale_y, x * scale_x, y * scale_y, radius };
+    segments.push_back(segment);
+  }
+
+  // Elliptical arc, degrees clockwise from the right since y grows downward
+  void arc(double cx, double cy, double rx, double ry, double from_deg, double to_deg) {
+    const int STEPS = 48;
+    double px = cx + rx * cos(from_deg * M_PI / 180.0);
+    double py = cy + ry * sin(from_deg * M_PI / 180.0);
+    for (int i = 1; i <= STEPS; i++) {
+      double a = (from_deg + (to_deg - from_deg) * i / STEPS) * M_PI / 180.0;
+      double x = cx + rx * cos(a);
+      double y = cy + ry * sin(a);
+      line(px, py, x, y);
+      px = x;
+      py = y;
+    }
+  }
+
+  // Quadratic Bezier curve
+  void curve(double x0, double y0, double cx, double cy, double x1, double y1) {
+    const int STEPS = 32;
+    double px = x0;
+    double py = y0;
+    for (int i = 1; i <= STEPS; i++) {
+      double t = (double)i / STEPS;
+      double x = (1 - t) * (1 - t) * x0 + 2 * (1 - t) * t * cx + t * t * x1;
+      double y = (1 - t) * (1 - t) * y0 + 2 * (1 - t) * t * cy + t * t * y1;
+      line(px, py, x, y);
+      px = x;
+      py = y;
+    }
+  }
+
+  bool covers(double x, double y) const {
+    for (size_t i = 0; i < segments.size(); i++) {
+      const Segment &s = segments[i];
+      double dx = s.x1 - s.x0;
+      double dy = s.y1 - s.y0;
+      double length2 = dx * dx + dy * dy;
+      double t = (length2 > 0) ? ((x - s.x0) * dx + (y - s.y0) * dy) / length2 : 0;
+      t = (t < 0) ? 0 : (t > 1) ? 1 : t;
+      double ex = x - (s.x0 + t * dx);
+      double ey = y - (s.y0 + t * dy);
+      if (ex * ex + ey * ey <= s.radius * s.radius) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Each pixel shaded by the share of its sub-samples the pen covers
+  Image render(int width, int height) const {
+    Image image(width, height);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        int covered = 0;
+        for (int j = 0; j < SUBSAMPLES; j++) {
+          for (int i = 0; i < SUBSAMPLES; i++) {
+            covered += covers(x + (i + 0.5) / SUBSAMPLES, y + (j + 0.5) / SUBSAMPLES);
+          }
+        }
+        int samples = SUBSAMPLES * SUBSAMPLES;
+        image.pixel(x, y, (uint8_t)((covered * SHADE_FOREGROUND + samples / 2) / samples));
+      }
+    }
+    return image;
+  }
+};
+
+
+//
+// Clock face digit '0' to '9' or ':'.
+//
+static Image render_numeral(char c) {
+  if (c == ':') {
+    Strokes colon(COLON_WIDTH, NUMERAL_HEIGHT, NUMERAL_PEN);
+    colon.dot(0.5, 0.36, NUMERAL_PEN + 0.4);
+    colon.dot(0.5, 0.68, NUMERAL_PEN + 0.4);
+    return colon.render(COLON_WIDTH, NUMERAL_HEIGHT);
+  }
+
+  Strokes s(NUMERAL_WIDTH, NUMERAL_HEIGHT, NUMERAL_PEN);
+  switch (c) {
+    case '0':
+      s.arc(0.5, 0.5, 0.32, 0.42, 0, 360);
+      break;
+    case '1':
+      s.line(0.30, 0.22, 0.55, 0.08);
+      s.line(0.55, 0.08, 0.55, 0.92);
+      s.line(0.30, 0.92, 0.80, 0.92);
+      break;
+    case '2':
+      s.arc(0.5, 0.30, 0.30, 0.22, 190, 390);
+      s.curve(0.76, 0.41, 0.62, 0.62, 0.19, 0.92);
+      s.line(0.19, 0.92, 0.82, 0.92);
+      break;
+    case '3':
+      s.arc(0.5, 0.29, 0.28, 0.21, 200, 450);
+      s.arc(0.5, 0.71, 0.31, 0.21, 270, 520);
+      break;
+    case '4':
+      s.line(0.66, 0.92, 0.66, 0.08);
+      s.line(0.66, 0.08, 0.17, 0.66);
+      s.line(0.17, 0.66, 0.84, 0.66);
+      break;
+    case '5':
+      s.line(0.80, 0.08, 0.27, 0.08);
+      s.line(0.27, 0.08, 0.23, 0.47);
+      s.arc(0.5, 0.66, 0.31, 0.26, 220, 515);
+      break;
+    case '6':
+      s.arc(0.5, 0.69, 0.30, 0.23, 0, 360);
+      s.curve(0.20, 0.69, 0.20, 0.10, 0.74, 0.09);
+      break;
+    case '7':
+      s.line(0.18, 0.08, 0.82, 0.08);
+      s.line(0.82, 0.08, 0.40, 0.92);
+      break;
+    case '8':
+      s.arc(0.5, 0.29, 0.26, 0.21, 0, 360);
+      s.arc(0.5, 0.71, 0.31, 0.21, 0, 360);
+      break;
+    case '9':
+      s.arc(0.5, 0.31, 0.30, 0.23, 0, 360);
+      s.curve(0.80, 0.31, 0.80, 0.90, 0.26, 0.91);
+      break;
+  }
+  return s.render(NUMERAL_WIDTH, NUMERAL_HEIGHT);
+}
+
+
+//
+// Column state icons in ClockFace::STATE_ICON_T order.
+//
+static Image render_state_icon(int icon) {
+  Strokes s(ICON_SIZE, ICON_SIZE, ICON_PEN);
+  switch (icon) {
+    case 0:  // Settled on its digit
+      s.dot(0.5, 0.5, 5.0);
+      break;
+    case 1:  // Filling
+      s.line(0.5, 0.84, 0.5, 0.19);
+      s.line(0.19, 0.50, 0.5, 0.16);
+      s.line(0.5, 0.16, 0.81, 0.50);
+      break;
+    case 2:  // Draining
+      s.line(0.5, 0.16, 0.5, 0.81);
+      s.line(0.19, 0.50, 0.5, 0.84);
+      s.line(0.5, 0.84, 0.81, 0.50);
+      break;
+    case 3:  // Settling after a move
+      s.arc(0.5, 0.5, 0.30, 0.30, 0, 360);
+      break;
+    case 4:  // Error
+      s.line(0.19, 0.19, 0.81, 0.81);
+      s.line(0.81, 0.19, 0.19, 0.81);
+      break;
+  }
+  return s.render(ICON_SIZE, ICON_SIZE);
+}
+
+
+//
+// The numbers of the font[] array of glcdfont.c, 5 column bytes per character.
+//
+static bool load_font(const char *path, std::vector<uint8_t> &font) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Can not open %s\n", path);
+    return false;
+  }
+  std::string text;
+  char buffer[4096];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text.append(buffer, count);
+  }
+  fclose(file);
+
+  size_t pos = text.find("font[]");
+  if (pos == std::string::npos) {
+    fprintf(stderr, "No font[] array in %s\n", path);
+    return false;
+  }
+  pos = text.find('{', pos);
+  size_t end = text.find("};", pos);
+  if ((pos == std::string::npos) || (end == std::string::npos)) {
+    fprintf(stderr, "Malformed font[] array in %s\n", path);
+    return false;
+  }
+
+  const char *p = text.c_str() + pos + 1;
+  const char *stop = text.c_str() + end;
+  while (p < stop) {
+    if ((p[0] == '/') && (p[1] == '/')) {
+      p = strchr(p, '\n');
+      if (p == NULL) {
+        break;
+      }
+    } else if ((p[0] == '/') && (p[1] == '*')) {
+      p = strstr(p, "*/");
+      if (p == NULL) {
+        break;
+      }
+      p += 2;
+    } else if (isdigit((unsigned char)*p)) {
+      char *next;
+      font.push_back((uint8_t)strtoul(p, &next, 0));
+      p = next;
+    } else {
+      p++;
+    }
+  }
+
+  if (font.size() < (size_t)(LAST_CHAR + 1) * FONT_COLUMNS) {
+    fprintf(stderr, "Only %u font bytes in %s\n", (unsigned)font.size(), path);
+    return false;
+  }
+  return true;
+}
+
+
+static void print_bytes(const std::vector<uint8_t> &bytes, const char *indent) {
+  for (size_t i = 0; i < bytes.size(); i++) {
+    printf("%s0x%02X,", ((i % 16) == 0) ? indent : " ", bytes[i]);
+    if (((i % 16) == 15) || (i + 1 == bytes.size())) {
+      printf("\n");
+    }
+  }
+}
+
+
+static void print_glyphs(const std::vector<uint8_t> &font, int size) {
+  Image first = render_glyph(font, FIRST_CHAR, size);
+  printf("const uint8_t ATLAS_TEXT_%dX[ATLAS_CHAR_COUNT][%d] = {\n", size, first.bytes_per_line() * first.height);
+  for (int c = FIRST_CHAR; c <= LAST_CHAR; c++) {
+    printf("  {  // '%c'\n", c);
+    print_bytes(render_glyph(font, c, size).pack(), "    ");
+    printf("  },\n");
+  }
+  printf("};\n\n");
+}
+
+
+static void print_sprite(const char *name, const Image &image) {
+  printf("const uint8_t %s[%d] = {\n", name, image.bytes_per_line() * image.height);
+  print_bytes(image.pack(), "  ");
+  printf("};\n\n");
+}
+
+
+static void print_numerals() {
+  Image first = render_numeral('0');
+  printf("const uint8_t ATLAS_NUMERALS[10][%d] = {\n", first.bytes_per_line() * first.height);
+  for (char c = '0'; c <= '9'; c++) {
+    printf("  {  // '%c'\n", c);
+    print_bytes(render_numeral(c).pack(), "    ");
+    printf("  },\n");
+  }
+  printf("};\n\n");
+  print_sprite("ATLAS_NUMERAL_COLON", render_numeral(':'));
+}
+
+
+static void print_state_icons() {
+  printf("const uint8_t ATLAS_STATE_ICONS[ATLAS_STATE_ICON_COUNT][%d] = {\n", render_state_icon(0).bytes_per_line() * ICON_SIZE);
+  for (int i = 0; i < ICON_COUNT; i++) {
+    printf("  {\n");
+    print_bytes(render_state_icon(i).pack(), "    ");
+    printf("  },\n");
+  }
+  printf("};\n\n");
+}
+
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <Adafruit GFX library>/glcdfont.c > GlyphAtlas.h\n", argv[0]);
+    return 1;
+  }
+  std::vector<uint8_t> font;
+  if (!load_font(argv[1], font)) {
+    return 1;
+  }
+
+  printf("/*\n");
+  printf(" * Glyph Atlas for the Aqua Clock\n");
+  printf(" *\n");
+  printf(" * Generated by tools/glyph_atlas/make_glyph_atlas from the Adafruit GFX classic font, do not edit.\n");
+  printf(" * Text glyphs, numerals and state icons are 4 bit shades, 0 = background and 15 = foreground.\n");
+  printf(" * The numerals and icons are anti-aliased, their shades in between are partly covered pixels.\n");
+  printf(" * Sprites are 4 bit indexes into the default PaletteCanvas palette.\n");
+  printf(" * Lines are packed two pixels per byte, high nibble first.  The const tables stay in flash.\n");
+  printf(" *\n");
+  printf(" * @author Joe Mohos\n");
+  printf(" * Contact: jmohos@yahoo.com\n");
+  printf(" */\n");
+  printf("#ifndef GLYPH_ATLAS_H\n");
+  printf("#define GLYPH_ATLAS_H\n\n");
+  printf("#include <Arduino.h>\n\n\n");
+  printf("static constexpr uint8_t ATLAS_FIRST_CHAR = %d;\n", FIRST_CHAR);
+  printf("static constexpr uint8_t ATLAS_LAST_CHAR = %d;\n", LAST_CHAR);
+  printf("static constexpr uint8_t ATLAS_CHAR_COUNT = %d;\n", LAST_CHAR - FIRST_CHAR + 1);
+  printf("static constexpr uint8_t ATLAS_CELL_WIDTH = %d;   // Per text size\n", CELL_WIDTH);
+  printf("static constexpr uint8_t ATLAS_CELL_HEIGHT = %d;\n", CELL_HEIGHT);
+  printf("static constexpr uint8_t ATLAS_MAX_TEXT_SIZE = 2;\n");
+  printf("static constexpr uint8_t ATLAS_SHADE_FOREGROUND = %d;\n\n", SHADE_FOREGROUND);
+  printf("// Pump schematic from the lower right corner of the tank, 5 pixels up\n");
+  printf("static constexpr uint8_t ATLAS_PUMP_WIDTH = %d;\n", PUMP_WIDTH);
+  printf("static constexpr uint8_t ATLAS_PUMP_HEIGHT = %d;\n", PUMP_HEIGHT);
+  printf("static constexpr int8_t ATLAS_PUMP_Y_OFFSET = -5;\n\n");
+  printf("// Clock face numerals and column state icons\n");
+  printf("static constexpr uint8_t ATLAS_NUMERAL_WIDTH = %d;\n", NUMERAL_WIDTH);
+  printf("static constexpr uint8_t ATLAS_NUMERAL_HEIGHT = %d;\n", NUMERAL_HEIGHT);
+  printf("static constexpr uint8_t ATLAS_COLON_WIDTH = %d;\n", COLON_WIDTH);
+  printf("static constexpr uint8_t ATLAS_STATE_ICON_SIZE = %d;\n", ICON_SIZE);
+  printf("static constexpr uint8_t ATLAS_STATE_ICON_COUNT = %d;\n\n", ICON_COUNT);
+
+  print_glyphs(font, 1);
+  print_glyphs(font, 2);
+  print_sprite("ATLAS_PUMP_IDLE", render_pump(false));
+  print_sprite("ATLAS_PUMP_RUNNING", render_pump(true));
+  print_numerals();
+  print_state_icons();
+
+  printf("#endif\n");
+  return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Aqua Clock host time sync client
+ *
+ * Sets the Aqua Clock RTC from the host clock over the USB serial console with millisecond accuracy.
+ * Works like an NTP exchange:
+ *   Host   -> "SYNC REQ t1"                 t1 = host msec when the request was sent
+ *   Device -> "SYNC RSP t1 t2 t3"           t2 = device millis() the request arrived, t3 = when the reply left
+ *                                           t4 = host msec when the reply arrived
+ *   Round trip = (t4 - t1) - (t3 - t2)      Offset device - host = ((t2 - t1) + (t3 - t4)) / 2
+ * The exchange is repeated and the sample with the shortest round trip is kept since it had the least
+ * queuing delay.  The host then sends the UTC time paired with the matching device millis():
+ *   Host   -> "SYNC SET sec msec device_ms"
+ *   Device -> "SYNC LATE msec"              the RTC was written this far into its second, so is behind
+ *             "SYNC DONE sec"               once the RTC was written on a whole second
+ *             "SYNC FAIL ..."               if the device millis is too far from the arrival of the line
+ * Other console output from the device, such as logging, is ignored.
+ *
+ * Build:  g++ -std=c++11 -O2 -o aqua_time_sync aqua_time_sync.cpp
+ * Usage:  aqua_time_sync /dev/ttyUSB0 [exchanges]
+ * Test against the stand-in:  ./pty_clock_standin &  then  ./aqua_time_sync <pty path it prints>
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+
+static const int DEFAULT_EXCHANGES = 8;
+static const int REPLY_TIMEOUT_MSEC = 1000;
+static const int SET_TIMEOUT_MSEC = 8000;  // The clock retries the write for up to 5 more seconds
+
+
+//
+// Host UTC time in msec since 1970.
+//
+static int64_t host_msec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+//
+// Open the console in raw mode at 115200 baud.  Settings that do not apply, such as the baud rate
+// of a pty, are ignored.
+//
+static int open_console(const char *path) {
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: Cannot open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tio.c_cflag |= (CLOCAL | CREAD);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  tcflush(fd, TCIOFLUSH);
+  return fd;
+}
+
+
+static bool send_line(int fd, const std::string &line) {
+  std::string framed = line + "\r";
+  return write(fd, framed.data(), framed.size()) == (ssize_t)framed.size();
+}
+
+
+//
+// Read the next line that starts with the prefix, along with the host time the data holding it was read.
+//
+static bool read_line(int fd, const char *prefix, int timeout_msec, std::string &line, int64_t &rx_msec) {
+  static std::string pending;
+  static int64_t pending_rx_msec = 0;
+  int64_t deadline = host_msec() + timeout_msec;
+
+  for (;;) {
+    size_t end;
+    while ((end = pending.find_first_of("\r\n")) != std::string::npos) {
+      std::string candidate = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (candidate.compare(0, strlen(prefix), prefix) == 0) {
+        line = candidate;
+        rx_msec = pending_rx_msec;
+        return true;
+      }
+    }
+
+    int64_t remaining = deadline - host_msec();
+    if (remaining <= 0) {
+      return false;
+    }
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    struct timeval tv;
+    tv.tv_sec = remaining / 1000;
+    tv.tv_usec = (remaining % 1000) * 1000;
+    if (select(fd + 1, &fds, NULL, NULL, &tv) <= 0) {
+      continue;
+    }
+
+    char buffer[256];
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    pending_rx_msec = host_msec();
+    if (n <= 0) {
+      return false;
+    }
+    pending.append(buffer, n);
+  }
+}
+
+
+//
+// One request/response exchange.  Returns the round trip and the device minus host offset in msec.
+//
+static bool exchange(int fd, uint32_t token, int64_t &rtt_msec, int64_t &offset_msec) {
+  int64_t t1 = host_msec();
+  if (!send_line(fd, "SYNC REQ " + std::to_string(token))) {
+    return false;
+  }
+
+  std::string line;
+  int64_t t4 = 0;
+  if (!read_line(fd, "SYNC RSP", REPLY_TIMEOUT_MSEC, line, t4)) {
+    return false;
+  }
+
+  unsigned long echoed = 0, t2 = 0, t3 = 0;
+  if ((sscanf(line.c_str(), "SYNC RSP %lu %lu %lu", &echoed, &t2, &t3) != 3) || (echoed != token)) {
+    return false;
+  }
+
+  // Device millis() are 32 bit, the offset is only used modulo 2^32 to map host time back to device millis()
+  int64_t device_rx = (int64_t)t2;
+  int64_t device_tx = device_rx + (int64_t)(uint32_t)(t3 - t2);
+  rtt_msec = (t4 - t1) - (device_tx - device_rx);
+  offset_msec = ((device_rx - t1) + (device_tx - t4)) / 2;
+  return true;
+}
+
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <serial device> [exchanges]\n", argv[0]);
+    return 2;
+  }
+  int exchanges = (argc > 2) ? atoi(argv[2]) : DEFAULT_EXCHANGES;
+  if (exchanges < 1) {
+    exchanges = 1;
+  }
+
+  int fd = open_console(argv[1]);
+  if (fd < 0) {
+    return 1;
+  }
+
+  bool have_best = false;
+  int64_t best_rtt = 0;
+  int64_t best_offset = 0;
+  for (int i = 0; i < exchanges; i++) {
+    int64_t rtt, offset;
+    if (!exchange(fd, (uint32_t)(i + 1), rtt, offset)) {
+      fprintf(stderr, "  exchange %d: no reply\n", i + 1);
+      continue;
+    }
+    printf("  exchange %d: rtt %" PRId64 " msec\n", i + 1, rtt);
+    if (!have_best || (rtt < best_rtt)) {
+      have_best = true;
+      best_rtt = rtt;
+      best_offset = offset;
+    }
+    usleep(50000);
+  }
+  if (!have_best) {
+    fprintf(stderr, "ERROR: The clock did not answer any sync request\n");
+    close(fd);
+    return 1;
+  }
+
+  // Pair the host time with the device millis() it maps to
+  int64_t now = host_msec();
+  uint32_t device_msec = (uint32_t)(now + best_offset);
+  std::string set = "SYNC SET " + std::to_string(now / 1000) + " " + std::to_string(now % 1000) + " " + std::to_string(device_msec);
+  if (!send_line(fd, set)) {
+    fprintf(stderr, "ERROR: Failed to send the time\n");
+    close(fd);
+    return 1;
+  }
+
+  // Skip late replies to the requests and take the lateness report, up to the outcome of the set
+  std::string line;
+  int64_t rx_msec;
+  unsigned long late_msec = 0;
+  do {
+    if (!read_line(fd, "SYNC ", SET_TIMEOUT_MSEC, line, rx_msec)) {
+      fprintf(stderr, "ERROR: The clock did not confirm the time\n");
+      close(fd);
+      return 1;
+    }
+    sscanf(line.c_str(), "SYNC LATE %lu", &late_msec);
+  } while ((line.compare(0, strlen("SYNC DONE"), "SYNC DONE") != 0) && (line.compare(0, strlen("SYNC FAIL"), "SYNC FAIL") != 0));
+  if (line.compare(0, strlen("SYNC FAIL"), "SYNC FAIL") == 0) {
+    fprintf(stderr, "ERROR: The clock refused the time: %s\n", line.c_str());
+    close(fd);
+    return 1;
+  }
+  printf("Clock set: %s, best rtt %" PRId64 " msec, behind %lu msec +/-%" PRId64 " msec\n",
+         line.c_str() + strlen("SYNC DONE "), best_rtt, late_msec, (best_rtt + 1) / 2);
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Aqua Clock time sync stand-in
+ *
+ * Emulates the SYNC console commands of the Aqua Clock on a Linux pty so aqua_time_sync can be
+ * exercised without the hardware.  The emulated device has its own millis() with an arbitrary start,
+ * an RTC that starts minutes off, a random loop delay before each line is read and some unrelated
+ * console chatter.  A SYNC SET is written from the loop on the next whole second the same way the sketch
+ * does it, so a late loop pass retries or reports SYNC LATE.  After each write it reports how far the
+ * emulated RTC is from the host clock.
+ *
+ * Build:  g++ -std=c++11 -O2 -o pty_clock_standin pty_clock_standin.cpp
+ * Usage:  pty_clock_standin      (prints the pty path to hand to aqua_time_sync, Ctrl-C to stop)
+ *
+ * @author Joe Mohos
+ * Contact: jmohos@yahoo.com
+ */
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+
+static const int MAX_LOOP_DELAY_MSEC = 15;  // The sketch loop polls the console between the other updates
+static const uint32_t MILLIS_START = 4294000000UL;  // Wraps soon after start to exercise the unwrapping
+static const uint32_t SYNC_LATE_MAX_MSEC = 3;
+static const uint8_t SYNC_RETRIES_MAX = 5;
+
+
+static int64_t host_msec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static int64_t boot_host_msec = 0;
+
+static uint32_t device_millis() {
+  return (uint32_t)(MILLIS_START + (host_msec() - boot_host_msec));
+}
+
+
+// Emulated RTC, the host time plus an error in msec
+static int64_t rtc_error_msec = 0;
+
+// Time sync waiting for its whole second, written from the loop like the sketch does
+static bool sync_pending = false;
+static uint32_t sync_target_sec = 0;
+static uint32_t sync_deadline_msec = 0;
+static uint8_t sync_retries = 0;
+
+
+static void reply(int fd, const std::string &line) {
+  std::string framed = line + "\r\n";
+  if (write(fd, framed.data(), framed.size()) < 0) {
+    perror("write");
+  }
+}
+
+
+static void handle_line(int fd, const std::string &line, uint32_t rx_msec) {
+  char param1[16] = { 0 };
+  char param2[48] = { 0 };
+  if (sscanf(line.c_str(), "SYNC %15s %47[^\r\n]", param1, param2) < 1) {
+    reply(fd, "ERROR: Unsupported command!");
+    return;
+  }
+
+  if (strcmp(param1, "REQ") == 0) {
+    reply(fd, std::string("SYNC RSP ") + param2 + " " + std::to_string(rx_msec) + " " + std::to_string(device_millis()));
+  } else if (strcmp(param1, "SET") == 0) {
+    unsigned long epoch_sec = 0, epoch_msec = 0, device_msec = 0;
+    if (sscanf(param2, "%lu %lu %lu", &epoch_sec, &epoch_msec, &device_msec) != 3) {
+      reply(fd, "ERROR: Unsupported command!");
+      return;
+    }
+
+    // Same steps as sync_time_set() in the sketch
+    int32_t age_msec = (int32_t)(rx_msec - (uint32_t)device_msec);
+    if ((age_msec > 2000) || (age_msec < -2000)) {
+      reply(fd, "SYNC FAIL stale by " + std::to_string(age_msec) + " msec");
+      return;
+    }
+    uint32_t now_msec = epoch_msec + (device_millis() - (uint32_t)device_msec);
+    sync_target_sec = epoch_sec + (now_msec / 1000) + 1;
+    sync_deadline_msec = device_millis() + 1000 - (now_msec % 1000);
+    sync_retries = 0;
+    sync_pending = true;
+  } else {
+    reply(fd, "ERROR: Unsupported command!");
+  }
+}
+
+
+//
+// Same steps as sync_time_update() in the sketch, called once per loop pass.
+//
+static void sync_update(int fd) {
+  if (!sync_pending) {
+    return;
+  }
+  uint32_t late_msec = device_millis() - sync_deadline_msec;
+  if ((int32_t)late_msec < 0) {
+    return;
+  }
+  uint32_t target_sec = sync_target_sec + late_msec / 1000;
+  uint32_t behind_msec = late_msec % 1000;
+  if ((behind_msec > SYNC_LATE_MAX_MSEC) && (sync_retries < SYNC_RETRIES_MAX)) {
+    sync_retries++;
+    sync_target_sec = target_sec + 1;
+    sync_deadline_msec += (late_msec / 1000 + 1) * 1000;
+    printf("SET: loop %u msec late, retry %u\n", behind_msec, sync_retries);
+    fflush(stdout);
+    return;
+  }
+  sync_pending = false;
+
+  int64_t before = rtc_error_msec;
+  rtc_error_msec = (int64_t)target_sec * 1000 - host_msec();
+  if (behind_msec > 0) {
+    reply(fd, "SYNC LATE " + std::to_string(behind_msec) + " msec");
+  }
+  reply(fd, "SYNC DONE " + std::to_string(target_sec));
+  printf("SET: RTC error %" PRId64 " msec before, %" PRId64 " msec after, %s drift\n", before, rtc_error_msec,
+         (behind_msec <= SYNC_LATE_MAX_MSEC) ? "measures" : "skips");
+  fflush(stdout);
+}
+
+
+int main() {
+  srand((unsigned)time(NULL));
+  boot_host_msec = host_msec();
+  rtc_error_msec = 150000 + rand() % 1000;
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+    perror("posix_openpt");
+    return 1;
+  }
+  struct termios tio;
+  if (tcgetattr(master, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+  }
+  printf("%s\n", ptsname(master));
+  fflush(stdout);
+
+  std::string pending;
+  int64_t next_chatter = host_msec() + 500;
+  for (;;) {
+    // Console is only serviced once per loop pass
+    usleep((rand() % (MAX_LOOP_DELAY_MSEC + 1)) * 1000);
+
+    char buffer[128];
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(master, &fds);
+    struct timeval tv = { 0, 0 };
+    while (select(master + 1, &fds, NULL, NULL, &tv) > 0) {
+      ssize_t n = read(master, buffer, sizeof(buffer));
+      if (n <= 0) {
+        break;
+      }
+      for (ssize_t i = 0; i < n; i++) {
+        if ((buffer[i] == '\r') || (buffer[i] == '\n')) {
+          if (!pending.empty()) {
+            handle_line(master, pending, device_millis());
+          }
+          pending.clear();
+        } else {
+          pending += buffer[i];
+        }
+      }
+      FD_ZERO(&fds);
+      FD_SET(master, &fds);
+    }
+
+    sync_update(master);
+
+    if (host_msec() >= next_chatter) {
+      next_chatter = host_msec() + 500;
+      reply(master, "TANK: FILL_SETTLE to TANK_IDLE");
+    }
+  }
+}